@@ -49,16 +49,40 @@ _renderengine_dll.resize.argtypes = [c_int32, c_int32]
 _renderengine_dll.set_resolution.argtypes = [c_int32, c_int32]
 _renderengine_dll.set_frame.argtypes = [c_int32]
 
+# Frame buffers
+_renderengine_dll.enable_huge_pages.argtypes = [c_int32]
+_renderengine_dll.enable_huge_pages.restype = c_int32
+_renderengine_dll.is_huge_pages.restype = c_int32
+_renderengine_dll.enable_locked_buffers.argtypes = [c_int32]
+_renderengine_dll.enable_locked_buffers.restype = c_int32
+_renderengine_dll.is_locked_buffers.restype = c_int32
+_renderengine_dll.get_buffer_allocations.restype = c_int32
+
 # Pixel operations
 _renderengine_dll.get_pixels.argtypes = [c_void_p]
 _renderengine_dll.set_pixels.argtypes = [c_void_p, c_bool]
+_renderengine_dll.set_pixels_float.argtypes = [c_void_p]
+_renderengine_dll.set_tonemap.argtypes = [c_int32]
+_renderengine_dll.get_tonemap.restype = c_int32
+_renderengine_dll.set_tonemap_exposure.argtypes = [c_float]
+_renderengine_dll.get_tonemap_exposure.restype = c_float
+_renderengine_dll.set_tonemap_gamma.argtypes = [c_float]
+_renderengine_dll.get_tonemap_gamma.restype = c_float
+_renderengine_dll.enable_tonemap_dither.argtypes = [c_int32]
+_renderengine_dll.enable_tonemap_dither.restype = c_int32
+_renderengine_dll.is_tonemap_dither.restype = c_int32
 
 # Network communication
 _renderengine_dll.recv_pixels_data.restype = c_int32
 _renderengine_dll.send_pixels_data.restype = c_int32
+_renderengine_dll.send_pixels_tile.argtypes = [c_int32, c_int32, c_int32, c_int32, c_void_p, c_int32, c_int32]
+_renderengine_dll.send_pixels_tile.restype = c_int32
+_renderengine_dll.recv_pixels_tile.argtypes = [POINTER(c_int32), POINTER(c_int32), POINTER(c_int32), POINTER(c_int32)]
+_renderengine_dll.recv_pixels_tile.restype = c_int32
 _renderengine_dll.send_cam_data.restype = c_int32
 _renderengine_dll.recv_cam_data.restype = c_int32
 _renderengine_dll.set_timestep.argtypes = [c_int32]
+_renderengine_dll.get_timestep.restype = c_int32
 
 # Pixel size operations
 _renderengine_dll.set_pixsize.argtypes = [c_int32]
@@ -69,9 +93,115 @@ _renderengine_dll.enable_gpujpeg.argtypes = [c_int32]
 _renderengine_dll.enable_gpujpeg.restype = c_int32
 _renderengine_dll.is_gpujpeg.restype = c_int32
 
+# CPU pixel codec
+_renderengine_dll.set_codec.argtypes = [c_int32]
+_renderengine_dll.set_codec.restype = c_int32
+_renderengine_dll.get_codec.restype = c_int32
+_renderengine_dll.set_codec_level.argtypes = [c_int32]
+_renderengine_dll.get_codec_level.restype = c_int32
+_renderengine_dll.enable_codec_shuffle.argtypes = [c_int32]
+_renderengine_dll.enable_codec_shuffle.restype = c_int32
+_renderengine_dll.is_codec_shuffle.restype = c_int32
+_renderengine_dll.enable_codec_delta.argtypes = [c_int32]
+_renderengine_dll.enable_codec_delta.restype = c_int32
+_renderengine_dll.is_codec_delta.restype = c_int32
+_renderengine_dll.enable_codec_pipeline.argtypes = [c_int32]
+_renderengine_dll.enable_codec_pipeline.restype = c_int32
+_renderengine_dll.is_codec_pipeline.restype = c_int32
+
+# Dirty tiles
+_renderengine_dll.enable_dirty_tiles.argtypes = [c_int32]
+_renderengine_dll.enable_dirty_tiles.restype = c_int32
+_renderengine_dll.is_dirty_tiles.restype = c_int32
+_renderengine_dll.set_tile_size.argtypes = [c_int32]
+_renderengine_dll.get_tile_size.restype = c_int32
+_renderengine_dll.get_sent_tiles.restype = c_int32
+_renderengine_dll.get_total_tiles.restype = c_int32
+
+# Adaptive quality
+_renderengine_dll.set_target_fps.argtypes = [c_float]
+_renderengine_dll.get_target_fps.restype = c_float
+_renderengine_dll.set_quality_range.argtypes = [c_int32, c_int32]
+_renderengine_dll.set_idle_frames.argtypes = [c_int32]
+_renderengine_dll.get_idle_frames.restype = c_int32
+_renderengine_dll.get_compressed_quality.restype = c_int32
+_renderengine_dll.get_throughput.restype = c_float
+
+# Dynamic resolution
+_renderengine_dll.enable_dynamic_resolution.argtypes = [c_int32]
+_renderengine_dll.enable_dynamic_resolution.restype = c_int32
+_renderengine_dll.is_dynamic_resolution.restype = c_int32
+_renderengine_dll.set_dynamic_resolution_scale.argtypes = [c_int32]
+_renderengine_dll.get_dynamic_resolution_scale.restype = c_int32
+
+# Half float
+_renderengine_dll.enable_half_float.argtypes = [c_int32]
+_renderengine_dll.enable_half_float.restype = c_int32
+_renderengine_dll.is_half_float.restype = c_int32
+_renderengine_dll.enable_packed_rgb.argtypes = [c_int32]
+_renderengine_dll.enable_packed_rgb.restype = c_int32
+_renderengine_dll.is_packed_rgb.restype = c_int32
+
+# Region of interest
+_renderengine_dll.enable_roi.argtypes = [c_int32]
+_renderengine_dll.enable_roi.restype = c_int32
+_renderengine_dll.is_roi.restype = c_int32
+_renderengine_dll.set_roi.argtypes = [c_int32, c_int32, c_int32, c_int32]
+_renderengine_dll.get_roi.argtypes = [POINTER(c_int32), POINTER(c_int32), POINTER(c_int32), POINTER(c_int32)]
+
+# Video
+_renderengine_dll.enable_video.argtypes = [c_int32]
+_renderengine_dll.enable_video.restype = c_int32
+_renderengine_dll.is_video.restype = c_int32
+_renderengine_dll.set_video_bitrate.argtypes = [c_int32]
+_renderengine_dll.get_video_bitrate.restype = c_int32
+
+# Framed protocol
+_renderengine_dll.enable_framed_protocol.argtypes = [c_int32]
+_renderengine_dll.enable_framed_protocol.restype = c_int32
+_renderengine_dll.is_framed_protocol.restype = c_int32
+_renderengine_dll.enable_timestep_channels.argtypes = [c_int32]
+_renderengine_dll.enable_timestep_channels.restype = c_int32
+_renderengine_dll.is_timestep_channels.restype = c_int32
+
+# Striped transfer
+_renderengine_dll.set_stripes.argtypes = [c_int32]
+_renderengine_dll.get_stripes.restype = c_int32
+
+# Event loop
+_renderengine_dll.enable_event_loop.argtypes = [c_int32]
+_renderengine_dll.enable_event_loop.restype = c_int32
+_renderengine_dll.is_event_loop.restype = c_int32
+_renderengine_dll.set_socket_timeout.argtypes = [c_int32]
+_renderengine_dll.get_socket_timeout.restype = c_int32
+
+# Connection setup
+_renderengine_dll.set_connect_timeout.argtypes = [c_int32]
+_renderengine_dll.get_connect_timeout.restype = c_int32
+_renderengine_dll.get_connect_latency.restype = c_float
+
+# Viewers
+_renderengine_dll.set_max_viewers.argtypes = [c_int32]
+_renderengine_dll.get_max_viewers.restype = c_int32
+_renderengine_dll.get_viewer_count.restype = c_int32
+_renderengine_dll.is_viewer.restype = c_int32
+
+# Asynchronous send
+_renderengine_dll.enable_async_send.argtypes = [c_int32]
+_renderengine_dll.enable_async_send.restype = c_int32
+_renderengine_dll.is_async_send.restype = c_int32
+_renderengine_dll.get_dropped_frames.restype = c_int32
+
+# Asynchronous receive
+_renderengine_dll.enable_async_recv.argtypes = [c_int32]
+_renderengine_dll.enable_async_recv.restype = c_int32
+_renderengine_dll.is_async_recv.restype = c_int32
+_renderengine_dll.recv_latest_pixels_data.restype = c_int32
+
 # Server/Client connection
 _renderengine_dll.client_init.argtypes = [c_char_p, c_int32, c_int32, c_int32]
 _renderengine_dll.server_init.argtypes = [c_char_p, c_int32, c_int32, c_int32]
+_renderengine_dll.viewer_init.argtypes = [c_char_p, c_int32, c_int32, c_int32]
 _renderengine_dll.client_close_connection.argtypes = []
 _renderengine_dll.server_close_connection.argtypes = []
 
@@ -117,6 +247,9 @@ _renderengine_dll.get_gpu_buffer.restype = c_ulong
 _renderengine_dll.get_width.restype = c_int32
 _renderengine_dll.get_height.restype = c_int32
 
+# Color conversions
+_renderengine_dll.get_color_isa.restype = c_char_p
+
 ####################################################################################################
 # Public API - Expose the DLL functions
 
@@ -125,16 +258,35 @@ resize = _renderengine_dll.resize
 set_resolution = _renderengine_dll.set_resolution
 set_frame = _renderengine_dll.set_frame
 
+# Frame buffers
+enable_huge_pages = _renderengine_dll.enable_huge_pages
+is_huge_pages = _renderengine_dll.is_huge_pages
+enable_locked_buffers = _renderengine_dll.enable_locked_buffers
+is_locked_buffers = _renderengine_dll.is_locked_buffers
+get_buffer_allocations = _renderengine_dll.get_buffer_allocations
+
 # Pixel operations
 get_pixels = _renderengine_dll.get_pixels
 set_pixels = _renderengine_dll.set_pixels
+set_pixels_float = _renderengine_dll.set_pixels_float
+set_tonemap = _renderengine_dll.set_tonemap
+get_tonemap = _renderengine_dll.get_tonemap
+set_tonemap_exposure = _renderengine_dll.set_tonemap_exposure
+get_tonemap_exposure = _renderengine_dll.get_tonemap_exposure
+set_tonemap_gamma = _renderengine_dll.set_tonemap_gamma
+get_tonemap_gamma = _renderengine_dll.get_tonemap_gamma
+enable_tonemap_dither = _renderengine_dll.enable_tonemap_dither
+is_tonemap_dither = _renderengine_dll.is_tonemap_dither
 
 # Network communication
 recv_pixels_data = _renderengine_dll.recv_pixels_data
 send_pixels_data = _renderengine_dll.send_pixels_data
+send_pixels_tile = _renderengine_dll.send_pixels_tile
+recv_pixels_tile = _renderengine_dll.recv_pixels_tile
 send_cam_data = _renderengine_dll.send_cam_data
 recv_cam_data = _renderengine_dll.recv_cam_data
 set_timestep = _renderengine_dll.set_timestep
+get_timestep = _renderengine_dll.get_timestep
 
 # Pixel size operations
 set_pixsize = _renderengine_dll.set_pixsize
@@ -143,10 +295,97 @@ get_pixsize = _renderengine_dll.get_pixsize
 # GPU JPEG operations
 enable_gpujpeg = _renderengine_dll.enable_gpujpeg
 is_gpujpeg = _renderengine_dll.is_gpujpeg
+set_codec = _renderengine_dll.set_codec
+get_codec = _renderengine_dll.get_codec
+set_codec_level = _renderengine_dll.set_codec_level
+get_codec_level = _renderengine_dll.get_codec_level
+enable_codec_shuffle = _renderengine_dll.enable_codec_shuffle
+is_codec_shuffle = _renderengine_dll.is_codec_shuffle
+enable_codec_delta = _renderengine_dll.enable_codec_delta
+is_codec_delta = _renderengine_dll.is_codec_delta
+enable_codec_pipeline = _renderengine_dll.enable_codec_pipeline
+is_codec_pipeline = _renderengine_dll.is_codec_pipeline
+enable_dirty_tiles = _renderengine_dll.enable_dirty_tiles
+is_dirty_tiles = _renderengine_dll.is_dirty_tiles
+set_tile_size = _renderengine_dll.set_tile_size
+get_tile_size = _renderengine_dll.get_tile_size
+get_sent_tiles = _renderengine_dll.get_sent_tiles
+get_total_tiles = _renderengine_dll.get_total_tiles
+
+# Adaptive quality
+set_target_fps = _renderengine_dll.set_target_fps
+get_target_fps = _renderengine_dll.get_target_fps
+set_quality_range = _renderengine_dll.set_quality_range
+set_idle_frames = _renderengine_dll.set_idle_frames
+get_idle_frames = _renderengine_dll.get_idle_frames
+get_compressed_quality = _renderengine_dll.get_compressed_quality
+get_throughput = _renderengine_dll.get_throughput
+
+# Dynamic resolution
+enable_dynamic_resolution = _renderengine_dll.enable_dynamic_resolution
+is_dynamic_resolution = _renderengine_dll.is_dynamic_resolution
+set_dynamic_resolution_scale = _renderengine_dll.set_dynamic_resolution_scale
+get_dynamic_resolution_scale = _renderengine_dll.get_dynamic_resolution_scale
+
+# Half float
+enable_half_float = _renderengine_dll.enable_half_float
+is_half_float = _renderengine_dll.is_half_float
+enable_packed_rgb = _renderengine_dll.enable_packed_rgb
+is_packed_rgb = _renderengine_dll.is_packed_rgb
+
+# Region of interest
+enable_roi = _renderengine_dll.enable_roi
+is_roi = _renderengine_dll.is_roi
+set_roi = _renderengine_dll.set_roi
+get_roi = _renderengine_dll.get_roi
+
+# Video
+enable_video = _renderengine_dll.enable_video
+is_video = _renderengine_dll.is_video
+set_video_bitrate = _renderengine_dll.set_video_bitrate
+get_video_bitrate = _renderengine_dll.get_video_bitrate
+
+# Framed protocol
+enable_framed_protocol = _renderengine_dll.enable_framed_protocol
+is_framed_protocol = _renderengine_dll.is_framed_protocol
+enable_timestep_channels = _renderengine_dll.enable_timestep_channels
+is_timestep_channels = _renderengine_dll.is_timestep_channels
+
+# Striped transfer
+set_stripes = _renderengine_dll.set_stripes
+get_stripes = _renderengine_dll.get_stripes
+
+# Event loop
+enable_event_loop = _renderengine_dll.enable_event_loop
+is_event_loop = _renderengine_dll.is_event_loop
+set_socket_timeout = _renderengine_dll.set_socket_timeout
+get_socket_timeout = _renderengine_dll.get_socket_timeout
+
+# Connection setup
+set_connect_timeout = _renderengine_dll.set_connect_timeout
+get_connect_timeout = _renderengine_dll.get_connect_timeout
+get_connect_latency = _renderengine_dll.get_connect_latency
+
+# Viewers
+set_max_viewers = _renderengine_dll.set_max_viewers
+get_max_viewers = _renderengine_dll.get_max_viewers
+get_viewer_count = _renderengine_dll.get_viewer_count
+is_viewer = _renderengine_dll.is_viewer
+
+# Asynchronous send
+enable_async_send = _renderengine_dll.enable_async_send
+is_async_send = _renderengine_dll.is_async_send
+get_dropped_frames = _renderengine_dll.get_dropped_frames
+
+# Asynchronous receive
+enable_async_recv = _renderengine_dll.enable_async_recv
+is_async_recv = _renderengine_dll.is_async_recv
+recv_latest_pixels_data = _renderengine_dll.recv_latest_pixels_data
 
 # Server/Client connection
 client_init = _renderengine_dll.client_init
 server_init = _renderengine_dll.server_init
+viewer_init = _renderengine_dll.viewer_init
 client_close_connection = _renderengine_dll.client_close_connection
 server_close_connection = _renderengine_dll.server_close_connection
 
@@ -186,6 +425,9 @@ get_gpu_buffer = _renderengine_dll.get_gpu_buffer
 get_width = _renderengine_dll.get_width
 get_height = _renderengine_dll.get_height
 
+# Color conversions
+get_color_isa = _renderengine_dll.get_color_isa
+
 ####################################################################################################
 # Module exports
 __all__ = [
@@ -193,24 +435,117 @@ __all__ = [
     'resize',
     'set_resolution',
     'set_frame',
+    # Frame buffers
+    'enable_huge_pages',
+    'is_huge_pages',
+    'enable_locked_buffers',
+    'is_locked_buffers',
+    'get_buffer_allocations',
     # Pixel operations
     'get_pixels',
     'set_pixels',
+    'set_pixels_float',
+    'set_tonemap',
+    'get_tonemap',
+    'set_tonemap_exposure',
+    'get_tonemap_exposure',
+    'set_tonemap_gamma',
+    'get_tonemap_gamma',
+    'enable_tonemap_dither',
+    'is_tonemap_dither',
     # Network communication
     'recv_pixels_data',
     'send_pixels_data',
+    'send_pixels_tile',
+    'recv_pixels_tile',
     'send_cam_data',
     'recv_cam_data',
     'set_timestep',
+    'get_timestep',
     # Pixel size operations
     'set_pixsize',
     'get_pixsize',
     # GPU JPEG operations
     'enable_gpujpeg',
     'is_gpujpeg',
+    'set_codec',
+    'get_codec',
+    'set_codec_level',
+    'get_codec_level',
+    'enable_codec_shuffle',
+    'is_codec_shuffle',
+    'enable_codec_delta',
+    'is_codec_delta',
+    'enable_codec_pipeline',
+    'is_codec_pipeline',
+    'enable_dirty_tiles',
+    'is_dirty_tiles',
+    'set_tile_size',
+    'get_tile_size',
+    'get_sent_tiles',
+    'get_total_tiles',
+    # Adaptive quality
+    'set_target_fps',
+    'get_target_fps',
+    'set_quality_range',
+    'set_idle_frames',
+    'get_idle_frames',
+    'get_compressed_quality',
+    'get_throughput',
+    # Dynamic resolution
+    'enable_dynamic_resolution',
+    'is_dynamic_resolution',
+    'set_dynamic_resolution_scale',
+    'get_dynamic_resolution_scale',
+    # Half float
+    'enable_half_float',
+    'is_half_float',
+    'enable_packed_rgb',
+    'is_packed_rgb',
+    # Region of interest
+    'enable_roi',
+    'is_roi',
+    'set_roi',
+    'get_roi',
+    # Video
+    'enable_video',
+    'is_video',
+    'set_video_bitrate',
+    'get_video_bitrate',
+    # Framed protocol
+    'enable_framed_protocol',
+    'is_framed_protocol',
+    'enable_timestep_channels',
+    'is_timestep_channels',
+    # Striped transfer
+    'set_stripes',
+    'get_stripes',
+    # Event loop
+    'enable_event_loop',
+    'is_event_loop',
+    'set_socket_timeout',
+    'get_socket_timeout',
+    # Connection setup
+    'set_connect_timeout',
+    'get_connect_timeout',
+    'get_connect_latency',
+    # Viewers
+    'set_max_viewers',
+    'get_max_viewers',
+    'get_viewer_count',
+    'is_viewer',
+    # Asynchronous send
+    'enable_async_send',
+    'is_async_send',
+    'get_dropped_frames',
+    # Asynchronous receive
+    'enable_async_recv',
+    'is_async_recv',
+    'recv_latest_pixels_data',
     # Server/Client connection
     'client_init',
     'server_init',
+    'viewer_init',
     'client_close_connection',
     'server_close_connection',
     # Camera operations
@@ -239,5 +574,7 @@ __all__ = [
     # Resolution operations
     'get_width',
     'get_height',
+    # Color conversions
+    'get_color_isa',
 ]
 
@@ -31,6 +31,15 @@
 #endif
 
 #include "renderengine_tcp.h"
+#include "renderengine_shm.h"
+#include "renderengine_async.h"
+#include "renderengine_codec.h"
+#include "renderengine_tiles.h"
+#include "renderengine_color.h"
+#include "renderengine_quality.h"
+#include "renderengine_tonemap.h"
+#include "renderengine_video.h"
+#include "renderengine_pool.h"
 
 #include <iostream>
 #include <string.h>
@@ -76,6 +85,52 @@ int setenv(const char* name, const char* value, int overwrite)
 #endif
 
 TcpConnection tcpConnection;
+#ifndef _WIN32
+ShmConnection shmConnection;
+#endif
+TcpConnection* g_connection = &tcpConnection;
+
+bool g_async_send = false;
+FrameSender g_frame_sender;
+WireFramePool g_frame_pool;
+
+bool g_async_recv = false;
+FrameReceiver g_frame_receiver;
+
+PixelCodec g_codec;
+
+// the strips of the codec are sent while the next ones are compressed and decompressed
+// while the next ones are received
+bool g_pipelined = false;
+StripPipeline g_strip_pipeline;
+
+bool g_dirty_tiles_enabled = false;
+DirtyTiles g_dirty_tiles;
+
+QualityController g_quality;
+int g_camera_idle_frames = 0; // frames sent since the camera changed
+
+// while the camera moves the server renders at 1/scale of the resolution of the client
+bool g_dynamic_resolution = false;
+int g_dynamic_resolution_scale = 2;
+std::vector<char> g_pixels_scaled; // client: a frame rendered at a lower resolution
+
+// F32 pixels cross the network as halfs
+bool g_half_float = false;
+std::vector<unsigned short> g_pixels_half;
+
+// the pixels cross the network without alpha, the client sets it opaque
+bool g_packed_rgb = false;
+std::vector<char> g_pixels_rgb;
+
+ToneMapper g_tonemap;
+
+bool g_video_enabled = false;
+VideoCodec g_video;
+
+int g_max_viewers = 0;
+bool g_viewer = false;
+FrameBroadcaster g_frame_broadcaster;
 
 //unsigned int g_renderengine_data.width = 2;
 //unsigned int g_renderengine_data.height = 1;
@@ -84,6 +139,23 @@ unsigned char* g_pixels_buf = NULL;
 void* g_pixels_buf_d = NULL;
 void* g_pixels_buf_recv_d = NULL;
 
+// the frame buffers keep their capacity, a resize within it allocates nothing
+PooledBuffer g_pixels_pool;
+BufferCapacity g_pixels_capacity; // pinned by CUDA instead of the pool
+BufferCapacity g_pixels_recv_d_capacity;
+BufferCapacity g_pbo_capacity;
+
+// rows of g_pixels_buf written by tiles since the texture was drawn, none: all rows are drawn
+int g_tile_row_begin = 0;
+int g_tile_row_end = 0;
+std::vector<char> g_pixels_tile; // a tile narrower than the frame or with a stride
+std::vector<char> g_pixels_tile_wire;
+
+// the server sends only the region of interest of the client, which places it in its frame
+bool g_roi = false;
+renderengine_tile g_roi_rect = { 0, 0, 0, 0, 1, 0 }; // the region of the last frame
+std::vector<char> g_pixels_roi; // the region without the rest of its rows, kept for dirty tiles
+
 #ifdef WITH_CLIENT_EPOXY
 GLuint g_bufferId;   // ID of PBO
 GLuint g_textureId;  // ID of texture
@@ -91,6 +163,7 @@ GLuint g_textureId;  // ID of texture
 
 renderengine_data g_renderengine_data;
 renderengine_data g_renderengine_data_recv;
+renderengine_data g_renderengine_data_cam; // server: the camera as received
 BRaaSHPCDataState g_hs_data_state;
 
 double g_previousTime[3] = { 0, 0, 0 };
@@ -233,22 +306,25 @@ void setup_texture(bool use_gl)
 
 #ifdef WITH_CLIENT_EPOXY
 	if (use_gl) {
-		GLuint pboIds[1];      // IDs of PBO
-		GLuint textureIds[1];  // ID of texture
-
-		glGenTextures(1, textureIds);
-		g_textureId = textureIds[0];
+		size_t size = (size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE;
+
+		// the texture is created once and gets the new size, the PBO keeps its capacity
+		if (g_textureId == 0) {
+			glGenTextures(1, &g_textureId);
+
+			glBindTexture(GL_TEXTURE_2D, g_textureId);
+			//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+			//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		}
 
 		glBindTexture(GL_TEXTURE_2D, g_textureId);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 		//glTexImage2D(GL_TEXTURE_2D,
 		//	0,
@@ -319,54 +395,41 @@ void setup_texture(bool use_gl)
 
 		glBindTexture(GL_TEXTURE_2D, 0);
 
-		glGenBuffers(1, pboIds);
-		g_bufferId = pboIds[0];
-
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_bufferId);
-
-		glBufferData(GL_PIXEL_UNPACK_BUFFER,
-			(size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE,
-			0,
-			GL_DYNAMIC_COPY);
-
-		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-
+		if (g_pbo_capacity.request(size, PooledBuffer::get_page_size())) {
+			if (g_bufferId == 0) {
+				glGenBuffers(1, &g_bufferId);
+			}
 #if defined(WITH_CLIENT_GPUJPEG)
-		cuda_assert(cudaGLRegisterBufferObject(g_bufferId));
-#endif
-		//cuda_assert(cudaGLMapBufferObject((void**)&g_pixels_buf_d, g_bufferId));
-	}
+			else {
+				cuda_assert(cudaGLUnregisterBufferObject(g_bufferId));
+			}
 #endif
 
-#if defined(WITH_CLIENT_GPUJPEG)
-	cuda_assert(cudaMalloc(&g_pixels_buf_recv_d, (size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE));	
-	printf("Setup texture %d x %d, Pointer: %lld (Size: %lld)\n", g_renderengine_data.width, g_renderengine_data.height, (size_t)g_pixels_buf_recv_d, (size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE);
-#endif
-}
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_bufferId);
 
-void free_texture(bool use_gl)
-{
-	cuda_set_device();
+			glBufferData(GL_PIXEL_UNPACK_BUFFER,
+				g_pbo_capacity.get_capacity(),
+				0,
+				GL_DYNAMIC_COPY);
 
-#ifdef WITH_CLIENT_EPOXY
-	//cuda_assert(cudaGLUnmapBufferObject(g_bufferId));
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-	if (use_gl) {
 #if defined(WITH_CLIENT_GPUJPEG)
-		cuda_assert(cudaGLUnregisterBufferObject(g_bufferId));
+			cuda_assert(cudaGLRegisterBufferObject(g_bufferId));
 #endif
+		}
+		//cuda_assert(cudaGLMapBufferObject((void**)&g_pixels_buf_d, g_bufferId));
 	}
 #endif
 
 #if defined(WITH_CLIENT_GPUJPEG)
-	printf("Free texture Pointer: %lld\n", (size_t)g_pixels_buf_recv_d);
-	cuda_assert(cudaFree(g_pixels_buf_recv_d));
-#endif	
+	size_t size = (size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE;
+	if (g_pixels_recv_d_capacity.request(size, PooledBuffer::get_page_size())) {
+		if (g_pixels_buf_recv_d != NULL)
+			cuda_assert(cudaFree(g_pixels_buf_recv_d));
 
-#ifdef WITH_CLIENT_EPOXY
-	if (use_gl) {
-		glDeleteFramebuffers(1, &g_bufferId);
-		glDeleteTextures(1, &g_textureId);
+		cuda_assert(cudaMalloc(&g_pixels_buf_recv_d, g_pixels_recv_d_capacity.get_capacity()));
+		printf("Setup texture %d x %d, Pointer: %lld (Size: %lld)\n", g_renderengine_data.width, g_renderengine_data.height, (size_t)g_pixels_buf_recv_d, (size_t)g_pixels_recv_d_capacity.get_capacity());
 	}
 #endif
 }
@@ -399,18 +462,30 @@ void draw_texture_internal(bool use_gl)
 	cuda_set_device();
 #ifdef WITH_CLIENT_EPOXY
 	if (use_gl) {
+		// only the rows of the tiles received since the last draw are uploaded
+		int row_begin = 0;
+		int rows = g_renderengine_data.height;
+		if (g_tile_row_end > g_tile_row_begin) {
+			row_begin = g_tile_row_begin;
+			rows = g_tile_row_end - g_tile_row_begin;
+		}
+		g_tile_row_begin = g_tile_row_end = 0;
+
+		size_t row_size = (size_t)g_renderengine_data.width * 4 * PIX_SIZE;
+		size_t offset = (size_t)row_begin * row_size;
+
 #if defined(WITH_CLIENT_GPUJPEG)
 		cuda_assert(cudaGLMapBufferObject((void**)&g_pixels_buf_d, g_bufferId));
-		cuda_assert(cudaMemcpy(g_pixels_buf_d, g_pixels_buf_recv_d, (size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE,
+		cuda_assert(cudaMemcpy((char*)g_pixels_buf_d + offset, (char*)g_pixels_buf_recv_d + offset, (size_t)rows * row_size,
 			cudaMemcpyDeviceToDevice));
 		cuda_assert(cudaGLUnmapBufferObject(g_bufferId));
 #else
 		// Without CUDA, copy from CPU buffer to PBO using OpenGL
 		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_bufferId);
 		glBufferSubData(GL_PIXEL_UNPACK_BUFFER,
-			0,
-			(size_t)g_renderengine_data.width * g_renderengine_data.height * 4 * PIX_SIZE,
-			g_pixels_buf);
+			offset,
+			(size_t)rows * row_size,
+			g_pixels_buf + offset);
 		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 #endif
 
@@ -433,34 +508,34 @@ void draw_texture_internal(bool use_gl)
 			glTexSubImage2D(GL_TEXTURE_2D,
 				0,
 				0,
-				0,
+				row_begin,
 				g_renderengine_data.width,
-				g_renderengine_data.height,
+				rows,
 				GL_RGBA,
 				GL_FLOAT,
-				NULL);
+				(const void*)offset);
 		}
 		else if (PIX_SIZE == TCP_PIX_SIZE_U16) {
 			glTexSubImage2D(GL_TEXTURE_2D,
 				0,
 				0,
-				0,
+				row_begin,
 				g_renderengine_data.width,
-				g_renderengine_data.height,
+				rows,
 				GL_RGBA,
 				GL_HALF_FLOAT,
-				NULL);
+				(const void*)offset);
 		}
 		else { // TCP_PIX_SIZE_U8
 			glTexSubImage2D(GL_TEXTURE_2D,
 				0,
 				0,
-				0,
+				row_begin,
 				g_renderengine_data.width,
-				g_renderengine_data.height,
+				rows,
 				GL_RGBA,
 				GL_UNSIGNED_BYTE,
-				NULL);
+				(const void*)offset);
 		}
 
 		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
@@ -512,6 +587,113 @@ void set_resolution(int width, int height)
 	g_renderengine_data.height = height;
 }
 
+bool is_half_wire()
+{
+	return g_half_float && PIX_SIZE == TCP_PIX_SIZE_F32;
+}
+
+// the video stream carries RGBA8 frames only
+bool is_video_wire()
+{
+	return g_video_enabled && PIX_SIZE == TCP_PIX_SIZE_U8;
+}
+
+// bytes of a channel and of a pixel on the wire
+size_t wire_channel_size()
+{
+	return is_half_wire() ? sizeof(unsigned short) : PIX_SIZE;
+}
+
+size_t wire_pixel_size()
+{
+	return wire_channel_size() * (g_packed_rgb ? 3 : 4);
+}
+
+// the bits of an opaque alpha channel on the wire
+unsigned int wire_alpha()
+{
+	if (is_half_wire())
+		return 0x3c00;
+	if (PIX_SIZE == TCP_PIX_SIZE_F32)
+		return 0x3f800000;
+	return PIX_SIZE == TCP_PIX_SIZE_U16 ? 0xffff : 0xff;
+}
+
+// count pixels received from the wire to pixels of PIX_SIZE
+void wire_to_pixels(char* pixels, const char* wire, size_t count)
+{
+	if (g_packed_rgb) {
+		char* rgba = pixels;
+		if (is_half_wire()) {
+			g_pixels_half.resize(count * 4);
+			rgba = (char*)g_pixels_half.data();
+		}
+		color_rgb_to_rgba(rgba, wire, count, (int)wire_channel_size(), wire_alpha());
+		wire = rgba;
+	}
+
+	if (is_half_wire())
+		color_half_to_float((float*)pixels, (const unsigned short*)wire, count * 4);
+	else if (wire != pixels)
+		memcpy(pixels, wire, count * PIX_SIZE * 4);
+}
+
+// server: the region of interest of the client at the resolution of the frame, the whole
+// frame without a region or with video
+renderengine_tile roi_rect()
+{
+	int width = g_renderengine_data.width;
+	int height = g_renderengine_data.height;
+	renderengine_tile rect = { 0, 0, width, height, 1, 0 };
+
+	const int* roi = g_renderengine_data.roi;
+	int client_width = g_renderengine_data_cam.width;
+	int client_height = g_renderengine_data_cam.height;
+	if (!g_roi || is_video_wire() || roi[2] <= 0 || roi[3] <= 0 || client_width <= 0 || client_height <= 0)
+		return rect;
+
+	int x0 = roi[0] < 0 ? 0 : roi[0];
+	int y0 = roi[1] < 0 ? 0 : roi[1];
+	int x1 = roi[0] + roi[2] > client_width ? client_width : roi[0] + roi[2];
+	int y1 = roi[1] + roi[3] > client_height ? client_height : roi[1] + roi[3];
+	if (x1 <= x0 || y1 <= y0)
+		return rect;
+
+	// a frame of dynamic resolution covers the pixels the region touches
+	rect.x = (int)((long long)x0 * width / client_width);
+	rect.y = (int)((long long)y0 * height / client_height);
+	rect.width = (int)(((long long)x1 * width + client_width - 1) / client_width) - rect.x;
+	rect.height = (int)(((long long)y1 * height + client_height - 1) / client_height) - rect.y;
+	return rect;
+}
+
+// server: the pixels of rect in g_pixels_buf, rows narrower than the frame are joined first
+char* roi_pixels(const renderengine_tile& rect)
+{
+	size_t frame_row_size = (size_t)g_renderengine_data.width * PIX_SIZE * 4;
+	char* rows = (char*)g_pixels_buf + rect.y * frame_row_size;
+	if (rect.width == g_renderengine_data.width)
+		return rows;
+
+	size_t row_size = (size_t)rect.width * PIX_SIZE * 4;
+	g_pixels_roi.resize(row_size * rect.height);
+	for (int r = 0; r < rect.height; r++) {
+		memcpy(g_pixels_roi.data() + r * row_size, rows + r * frame_row_size + rect.x * PIX_SIZE * 4, row_size);
+	}
+	return g_pixels_roi.data();
+}
+
+// the messages of the async receiver, the region of interest is always the whole frame
+std::vector<size_t> pixels_message_sizes()
+{
+	std::vector<size_t> sizes;
+	if (g_roi)
+		sizes.push_back(sizeof(renderengine_tile));
+	sizes.push_back((size_t)g_renderengine_data.width * g_renderengine_data.height * wire_pixel_size());
+	sizes.push_back(sizeof(BRaaSHPCDataState));
+	return sizes;
+}
+
 void resize_internal(int width, int height, bool use_gl)
 {
 	if (width == g_renderengine_data.width && height == g_renderengine_data.height && g_pixels_buf)
@@ -519,29 +701,35 @@ void resize_internal(int width, int height, bool use_gl)
 
 	cuda_set_device();
 
-	if (g_pixels_buf)
-	{		
-		free_texture(use_gl);
-#if defined(WITH_CLIENT_GPUJPEG)
-		cuda_assert(cudaFreeHost(g_pixels_buf));
-#else
-		free(g_pixels_buf);
-#endif
-	}
-
 	g_renderengine_data.width = width;
 	g_renderengine_data.height = height;
+	g_tile_row_begin = g_tile_row_end = 0;
 
+	// a resize within the capacity of the buffers costs nothing
+	size_t size = (size_t)width * height * PIX_SIZE * 4;
 #if defined(WITH_CLIENT_GPUJPEG)
-	cuda_assert(cudaHostAlloc((void**)&g_pixels_buf, (size_t)width * height * PIX_SIZE * 4, cudaHostAllocMapped));
+	if (g_pixels_capacity.request(size, PooledBuffer::get_page_size())) {
+		if (g_pixels_buf)
+			cuda_assert(cudaFreeHost(g_pixels_buf));
+		cuda_assert(cudaHostAlloc((void**)&g_pixels_buf, g_pixels_capacity.get_capacity(), cudaHostAllocMapped));
+	}
 #else
-	g_pixels_buf = (unsigned char*)malloc((size_t)width * height * PIX_SIZE * 4);
+	g_pixels_buf = (unsigned char*)g_pixels_pool.reserve(size);
 #endif
 
 	//int* size = (int*)&g_renderengine_data.width;
 	//g_renderengine_data.width = width;
 	//g_renderengine_data.height = height;
 	setup_texture(use_gl);
+
+	// a frame of the largest resolution so far with room for the headers and an incompressible codec
+	size_t max_message_size = 2 * size + 1024 * 1024;
+	if (max_message_size > g_connection->get_max_message_size())
+		g_connection->set_max_message_size(max_message_size);
+
+	if (g_frame_receiver.is_running()) {
+		g_frame_receiver.set_message_sizes(pixels_message_sizes());
+	}
 }
 
 void resize(int width, int height)
@@ -549,11 +737,377 @@ void resize(int width, int height)
 	resize_internal(width, height, true);
 }
 
+int enable_huge_pages(int enabled)
+{
+	// the frame buffer of GPUJPEG builds is pinned by CUDA
+	g_pixels_pool.set_huge_pages(enabled != 0);
+	return 0;
+}
+
+int is_huge_pages() {
+	return g_pixels_pool.is_huge_pages() ? 1 : 0;
+}
+
+int enable_locked_buffers(int enabled)
+{
+	// fails if the memlock limit is too small, the buffer then stays pageable
+	g_pixels_pool.set_lock(enabled != 0);
+	return g_pixels_pool.is_locked() == (enabled != 0) || g_pixels_pool.get_data() == NULL ? 0 : -1;
+}
+
+int is_locked_buffers() {
+	return g_pixels_pool.is_lock() ? 1 : 0;
+}
+
+int get_buffer_allocations() {
+	return g_pixels_pool.get_allocations();
+}
+
+int recv_latest_pixels_data_internal(bool wait)
+{
+	bool error = false;
+	WireFrame* frame = g_frame_receiver.acquire_latest(wait, &error);
+	if (frame == NULL)
+		return error ? -1 : 0;
+
+	// a frame received before resize does not fit the buffers anymore
+	size_t count = (size_t)g_renderengine_data.width * g_renderengine_data.height;
+	int first = g_roi ? 1 : 0;
+	if (frame->messages[first].size() != count * wire_pixel_size())
+		return 0;
+
+	wire_to_pixels((char*)g_pixels_buf, frame->messages[first].data(), count);
+	g_tile_row_begin = g_tile_row_end = 0;
+	memcpy(&g_hs_data_state, frame->messages[first + 1].data(), sizeof(BRaaSHPCDataState));
+	if (g_roi)
+		memcpy(&g_roi_rect, frame->messages[0].data(), sizeof(renderengine_tile));
+
+#if defined(WITH_CLIENT_GPUJPEG)
+	size_t pixels_size = count * PIX_SIZE * 4;
+	cuda_set_device();
+	cuda_assert(cudaMemcpy(g_pixels_buf_recv_d,
+		g_pixels_buf,
+		pixels_size,
+		cudaMemcpyHostToDevice));
+#endif
+
+	displayFPS(1, get_current_samples());
+
+	return 1;
+}
+
+int recv_latest_pixels_data()
+{
+	if (!g_frame_receiver.is_running())
+		return -1;
+
+	return recv_latest_pixels_data_internal(false);
+}
+
+// The messages carrying the pixels of a frame: the raw pixels, or only the changed tiles,
+// each optionally compressed by the codec. A tile of a frame (frame = false) is never video
+// or dirty tiles. With pipelined the messages end with the codec header and send_codec_strips
+// follows. Returns their count or -1.
+int pixels_messages(TcpBuffer* buffers, char* pixels, int width, int height, bool frame, bool pipelined)
+{
+	char* data = pixels;
+	size_t size = (size_t)width * height * wire_pixel_size();
+	int count = 0;
+
+	// the video frame replaces tiles and codec
+	if (frame && is_video_wire()) {
+		if (!g_video.encode((unsigned char*)pixels, width, height))
+			return -1;
+
+		buffers[count++] = { (char*)&g_video.get_header(), sizeof(VideoHeader) };
+		buffers[count++] = { g_video.get_data(), g_video.get_size() };
+		return count;
+	}
+
+	if (is_half_wire()) {
+		size_t values = (size_t)width * height * 4;
+		g_pixels_half.resize(values);
+		color_float_to_half(g_pixels_half.data(), (const float*)pixels, values);
+		data = (char*)g_pixels_half.data();
+	}
+
+	if (g_packed_rgb) {
+		g_pixels_rgb.resize(size);
+		color_rgba_to_rgb(g_pixels_rgb.data(), data, (size_t)width * height, (int)wire_channel_size());
+		data = g_pixels_rgb.data();
+	}
+
+	if (frame && g_dirty_tiles_enabled) {
+		if (!g_dirty_tiles.encode(data, width, height, (int)wire_pixel_size()))
+			return -1;
+
+		buffers[count++] = { (char*)&g_dirty_tiles.get_header(), sizeof(DirtyTilesHeader) };
+		data = g_dirty_tiles.get_data();
+		size = g_dirty_tiles.get_size();
+	}
+
+	if (g_codec.get_codec() != CODEC_NONE) {
+		size_t row_size = (size_t)width * wire_pixel_size();
+		int rows = (int)(size / row_size);
+		if (pipelined) {
+			if (!g_codec.begin_encode(data, size, rows > 0 ? rows : 1, (int)wire_channel_size(), frame, true))
+				return -1;
+
+			buffers[count++] = { (char*)&g_codec.get_header(), sizeof(PixelCodecHeader) };
+			return count;
+		}
+
+		if (!g_codec.encode(data, size, rows > 0 ? rows : 1, (int)wire_channel_size(), frame))
+			return -1;
+
+		buffers[count++] = { (char*)&g_codec.get_header(), sizeof(PixelCodecHeader) };
+		buffers[count++] = { g_codec.get_data(), g_codec.get_size() };
+	}
+	else {
+		buffers[count++] = { data, size };
+	}
+
+	return count;
+}
+
+// compresses the strips of the codec on the pipeline and sends each as soon as it and the
+// ones before it are done
+int send_codec_strips()
+{
+	int strips = g_codec.get_header().strips;
+	g_strip_pipeline.start(strips, [strips]() {
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int s = 0; s < strips; s++) {
+			g_strip_pipeline.set_ready(s, g_codec.encode_strip(s));
+		}
+	});
+
+	bool error = false;
+	for (int s = 0; s < strips && !error; s++) {
+		if (!g_strip_pipeline.wait_ready(s)) {
+			error = true;
+			break;
+		}
+
+		unsigned int size = g_codec.get_header().strip_sizes[s];
+		TcpBuffer buffers[2] = {
+			{ (char*)&size, sizeof(unsigned int) },
+			{ g_codec.get_strip_data(s), size } };
+		g_connection->send_data_gather(buffers, 2);
+		error = g_connection->is_error();
+	}
+
+	g_strip_pipeline.wait();
+	return error ? -1 : 0;
+}
+
+// receives the strips of send_codec_strips, each is decompressed into pixels while the
+// next ones are received
+int recv_codec_strips(char* pixels)
+{
+	int strips = g_codec.get_header().strips;
+	int decode_error = 0;
+	g_strip_pipeline.start(strips, [pixels, strips, &decode_error]() {
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int s = 0; s < strips; s++) {
+			if (g_strip_pipeline.wait_ready(s) && !g_codec.decode_strip(pixels, s)) {
+#pragma omp atomic write
+				decode_error = 1;
+			}
+		}
+	});
+
+	bool error = false;
+	for (int s = 0; s < strips; s++) {
+		unsigned int size = 0;
+		g_connection->recv_data_data((char*)&size, sizeof(unsigned int));
+		char* strip = g_connection->is_error() ? NULL : g_codec.prepare_decode_strip(s, size);
+		if (strip != NULL) {
+			g_connection->recv_data_data(strip, size);
+		}
+		if (strip == NULL || g_connection->is_error()) {
+			error = true;
+			break;
+		}
+
+		g_strip_pipeline.set_ready(s, true);
+	}
+
+	if (error) {
+		g_strip_pipeline.cancel();
+	}
+	g_strip_pipeline.wait();
+
+	if (error || decode_error) {
+		g_codec.reset();
+		return -1;
+	}
+
+	return 0;
+}
+
+// receives the messages of pixels_messages and the data state into pixels of width x height
+int recv_pixels_messages(char* pixels, int width, int height, bool frame)
+{
+	char* data = pixels;
+	size_t size = (size_t)width * height * wire_pixel_size();
+
+	if (frame && is_video_wire()) {
+		VideoHeader header;
+		g_connection->recv_data_data((char*)&header, sizeof(VideoHeader));
+		if (g_connection->is_error())
+			return -1;
+
+		char* video = g_video.prepare_decode(header);
+		if (video == NULL || header.width != width || header.height != height) {
+			printf("recv_pixels_data: invalid video header\n");
+			return -1;
+		}
+
+		TcpBuffer buffers[2] = {
+			{ video, (size_t)header.size },
+			{ (char*)&g_hs_data_state, sizeof(BRaaSHPCDataState) } };
+		g_connection->recv_data_scatter(buffers, 2);
+
+		if (g_connection->is_error() || !g_video.decode((unsigned char*)pixels, width, height))
+			return -1;
+
+		return 0;
+	}
+
+	// the wire pixels of a frame are kept for the dirty tiles of the next frame
+	char* wire = pixels;
+	if (!frame) {
+		if (g_packed_rgb || is_half_wire()) {
+			g_pixels_tile_wire.resize(size);
+			wire = g_pixels_tile_wire.data();
+		}
+	}
+	else if (g_packed_rgb) {
+		g_pixels_rgb.resize(size);
+		wire = g_pixels_rgb.data();
+	}
+	else if (is_half_wire()) {
+		g_pixels_half.resize((size_t)width * height * 4);
+		wire = (char*)g_pixels_half.data();
+	}
+	data = wire;
+
+	if (frame && g_dirty_tiles_enabled) {
+		DirtyTilesHeader header;
+		g_connection->recv_data_data((char*)&header, sizeof(DirtyTilesHeader));
+		if (g_connection->is_error())
+			return -1;
+
+		data = g_dirty_tiles.prepare_decode(header, width, height, (int)wire_pixel_size());
+		if (data == NULL)
+			return -1;
+		size = (size_t)header.size;
+	}
+
+	if (g_codec.get_codec() != CODEC_NONE) {
+		// the header tells the size of the compressed strips
+		PixelCodecHeader header;
+		g_connection->recv_data_data((char*)&header, sizeof(PixelCodecHeader));
+		if (g_connection->is_error())
+			return -1;
+
+		char* compressed = g_codec.prepare_decode(header);
+		if (compressed == NULL || header.raw_size != size) {
+			printf("recv_pixels_data: invalid codec header\n");
+			return -1;
+		}
+
+		if (header.flags & CODEC_PIPELINED) {
+			if (recv_codec_strips(data) < 0)
+				return -1;
+
+			g_connection->recv_data_data((char*)&g_hs_data_state, sizeof(BRaaSHPCDataState));
+			if (g_connection->is_error())
+				return -1;
+		}
+		else {
+			TcpBuffer buffers[2] = {
+				{ compressed, (size_t)header.size },
+				{ (char*)&g_hs_data_state, sizeof(BRaaSHPCDataState) } };
+			g_connection->recv_data_scatter(buffers, 2);
+
+			if (g_connection->is_error() || !g_codec.decode(data, size))
+				return -1;
+		}
+	}
+	else {
+		// pixels and data state in one go
+		TcpBuffer buffers[2] = {
+			{ data, size },
+			{ (char*)&g_hs_data_state, sizeof(BRaaSHPCDataState) } };
+		g_connection->recv_data_scatter(buffers, 2);
+
+		if (g_connection->is_error())
+			return -1;
+	}
+
+	if (frame && g_dirty_tiles_enabled && !g_dirty_tiles.decode(wire))
+		return -1;
+
+	wire_to_pixels(pixels, wire, (size_t)width * height);
+
+	return 0;
+}
+
+// scales a frame rendered at a lower resolution up to the resolution of the client
+void scale_pixels(const char* pixels, int width, int height)
+{
+	color_scale_rgba(g_pixels_buf, g_renderengine_data.height, g_renderengine_data.width, pixels, height, width, (int)PIX_SIZE);
+}
+
 int recv_pixels_data()
 {  
+	if (g_frame_receiver.is_running()) {
+		return recv_latest_pixels_data_internal(true) < 0 ? -1 : 0;
+	}
+
 	cuda_set_device();
 
+	if (g_viewer) {
+		g_connection->recv_data_data((char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+		if (g_connection->is_error())
+			return -1;
+
+		resize_internal(g_renderengine_data_recv.width, g_renderengine_data_recv.height, true);
+		g_renderengine_data.cam = g_renderengine_data_recv.cam;
+		g_renderengine_data.frame = g_renderengine_data_recv.frame;
+	}
+
+	// the frame is received at the resolution it was rendered at
+	char* pixels = (char*)g_pixels_buf;
+	int width = g_renderengine_data.width;
+	int height = g_renderengine_data.height;
+
+	if (g_dynamic_resolution && !g_viewer) {
+		g_connection->recv_data_data((char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+		if (g_connection->is_error())
+			return -1;
+
+		// a frame of dynamic resolution is never larger than the view of the client
+		if (g_renderengine_data_recv.width <= 0 || g_renderengine_data_recv.height <= 0 ||
+			g_renderengine_data_recv.width > width || g_renderengine_data_recv.height > height) {
+			printf("recv_pixels_data: invalid frame size %d x %d\n", g_renderengine_data_recv.width, g_renderengine_data_recv.height);
+			return -1;
+		}
+
+		if (g_renderengine_data_recv.width != width || g_renderengine_data_recv.height != height) {
+			width = g_renderengine_data_recv.width;
+			height = g_renderengine_data_recv.height;
+			g_pixels_scaled.resize((size_t)width * height * PIX_SIZE * 4);
+			pixels = g_pixels_scaled.data();
+		}
+	}
+
 	if (USE_GPUJPEG) {
+		// a whole frame is drawn
+		g_tile_row_begin = g_tile_row_end = 0;
+
 		//#ifdef TCP_PIX_SIZE_F32
 		//	int format = 2;
 		//#elif defined(TCP_PIX_SIZE_U16)
@@ -571,12 +1125,78 @@ int recv_pixels_data()
 			format = 8;
 		}
 
-		tcpConnection.recv_gpujpeg(
-			(char*)g_pixels_buf_recv_d, (char*)g_pixels_buf, g_renderengine_data.width, g_renderengine_data.height, format);
+#if defined(WITH_CLIENT_GPUJPEG)
+		// decoded into the device buffer, the host buffer holds the stream
+		g_connection->recv_gpujpeg(
+			(char*)g_pixels_buf_recv_d, (char*)g_pixels_buf, width, height, format);
+		if (g_connection->is_error())
+			return -1;
+
+		if (pixels != (char*)g_pixels_buf) {
+			cuda_assert(cudaMemcpy(pixels, g_pixels_buf_recv_d, (size_t)width * height * PIX_SIZE * 4, cudaMemcpyDeviceToHost));
+			scale_pixels(pixels, width, height);
+			cuda_assert(cudaMemcpy(g_pixels_buf_recv_d,
+				g_pixels_buf,
+				(size_t)g_renderengine_data.width * g_renderengine_data.height * PIX_SIZE * 4,
+				cudaMemcpyHostToDevice));
+		}
+#else
+		g_connection->recv_gpujpeg(
+			(char*)g_pixels_buf_recv_d, pixels, width, height, format);
+		if (g_connection->is_error())
+			return -1;
+
+		if (pixels != (char*)g_pixels_buf)
+			scale_pixels(pixels, width, height);
+#endif
+
+		g_connection->recv_data_data((char*)&g_hs_data_state, sizeof(BRaaSHPCDataState));
 	}
 	else {
-		tcpConnection.recv_data_data((char*)g_pixels_buf,
-			g_renderengine_data.width * g_renderengine_data.height * PIX_SIZE * 4 /*, false*/);
+		// the region of interest is received into its own buffer and placed in the frame
+		renderengine_tile rect = { 0, 0, width, height, 1, 0 };
+		if (g_roi) {
+			g_connection->recv_data_data((char*)&rect, sizeof(renderengine_tile));
+			if (g_connection->is_error())
+				return -1;
+
+			if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 ||
+				rect.x + rect.width > width || rect.y + rect.height > height) {
+				printf("recv_pixels_data: invalid region %d %d %d %d\n", rect.x, rect.y, rect.width, rect.height);
+				return -1;
+			}
+		}
+
+		bool region = rect.width != width || rect.height != height;
+		size_t row_size = (size_t)rect.width * PIX_SIZE * 4;
+		if (region)
+			g_pixels_roi.resize(row_size * rect.height);
+
+		if (recv_pixels_messages(region ? g_pixels_roi.data() : pixels, rect.width, rect.height, true) < 0)
+			return -1;
+
+		if (region) {
+			size_t frame_row_size = (size_t)width * PIX_SIZE * 4;
+			char* rows = pixels + rect.y * frame_row_size + rect.x * PIX_SIZE * 4;
+			for (int r = 0; r < rect.height; r++) {
+				memcpy(rows + r * frame_row_size, g_pixels_roi.data() + r * row_size, row_size);
+			}
+		}
+		g_roi_rect = rect;
+
+		// only the rows of the region are drawn, a scaled frame is drawn whole
+		if (!region || pixels != (char*)g_pixels_buf) {
+			g_tile_row_begin = g_tile_row_end = 0;
+		}
+		else {
+			if (g_tile_row_end <= g_tile_row_begin || rect.y < g_tile_row_begin)
+				g_tile_row_begin = rect.y;
+			if (rect.y + rect.height > g_tile_row_end)
+				g_tile_row_end = rect.y + rect.height;
+		}
+
+		if (pixels != (char*)g_pixels_buf)
+			scale_pixels(pixels, width, height);
 
 #if defined(WITH_CLIENT_GPUJPEG)
 		cuda_assert(cudaMemcpy(g_pixels_buf_recv_d, //g_pixels_buf_d,
@@ -588,8 +1208,6 @@ int recv_pixels_data()
 		//current_samples = ((int*)g_pixels_buf)[0];
 	}
 
-	tcpConnection.recv_data_data((char*)&g_hs_data_state, sizeof(BRaaSHPCDataState));
-
 //#ifdef _WIN32
 	displayFPS(1, get_current_samples());
 //#endif	
@@ -601,6 +1219,8 @@ int send_pixels_data()
 {  
 	cuda_set_device();
 
+	g_camera_idle_frames++;
+
 	if (USE_GPUJPEG) {
 
 		//#ifdef TCP_PIX_SIZE_F32
@@ -611,17 +1231,79 @@ int send_pixels_data()
 		int format = 8;
 		//#endif
 		if (PIX_SIZE == TCP_PIX_SIZE_F32) {
-			int format = 32;
+			format = 32;
 		}
 		else if (PIX_SIZE == TCP_PIX_SIZE_U16) {
-			int format = 16;
+			format = 16;
 		}
 		else { //TCP_PIX_SIZE_U8
-			int format = 8;
+			format = 8;
 		}
 
-		tcpConnection.send_gpujpeg(
+		if (g_quality.is_enabled())
+			g_connection->set_compressed_quality(g_quality.get_quality(g_connection->get_compressed_quality()));
+
+		if (g_dynamic_resolution)
+			g_connection->send_data_data((char*)&g_renderengine_data, sizeof(renderengine_data));
+
+		double start = get_current_time();
+		g_connection->send_gpujpeg(
 			(char*)g_pixels_buf_recv_d, (char*)g_pixels_buf, g_renderengine_data.width, g_renderengine_data.height, format);
+		g_quality.update(start, get_current_time(), g_connection->get_compressed_size(), g_camera_idle_frames);
+
+		g_connection->send_data_data((char*)&g_hs_data_state, sizeof(BRaaSHPCDataState));
+	}
+	else if ((g_async_send && g_connection->is_full_duplex()) || g_frame_broadcaster.get_viewer_count() > 0) {
+		// the frame is copied once and shared by the senders of the client and of all viewers,
+		// viewers get the camera first as they do not know the resolution
+		std::shared_ptr<WireFrame> frame = g_frame_pool.acquire();
+		frame->channel = g_connection->get_channel();
+		frame->add_message(&g_renderengine_data, sizeof(renderengine_data));
+
+		// the frame is shared, so the region of interest is the whole frame
+		if (g_roi) {
+			g_roi_rect = { 0, 0, g_renderengine_data.width, g_renderengine_data.height, 1, 0 };
+			frame->add_message(&g_roi_rect, sizeof(renderengine_tile));
+		}
+
+		// a sender that still has a frame drops it for this one and a viewer that just
+		// connected has no frame before, then this frame has all tiles, is not a codec
+		// delta and is a video key frame
+		frame->key = g_frame_sender.has_pending() || g_frame_broadcaster.needs_key();
+		if (frame->key) {
+			g_dirty_tiles.reset();
+			g_codec.reset();
+			g_video.force_key();
+		}
+
+		TcpBuffer buffers[TCP_GATHER_MAX];
+		int count = pixels_messages(buffers, (char*)g_pixels_buf, g_renderengine_data.width, g_renderengine_data.height, true, false);
+		if (count < 0)
+			return -1;
+
+		for (int i = 0; i < count; i++) {
+			frame->add_message(buffers[i].data, buffers[i].size);
+		}
+		frame->add_message(&g_hs_data_state, sizeof(BRaaSHPCDataState));
+
+		g_frame_broadcaster.submit(frame);
+
+		if (g_async_send && g_connection->is_full_duplex()) {
+			// the renderer can continue while the sender thread sends the frame
+			if (!g_frame_sender.is_running()) {
+				g_frame_sender.start(g_connection, g_dynamic_resolution ? 0 : 1);
+			}
+			g_frame_sender.submit(frame);
+		}
+		else {
+			TcpBuffer buffers[TCP_GATHER_MAX];
+			int count = frame->get_buffers(g_dynamic_resolution ? 0 : 1, buffers);
+			g_connection->send_data_gather(buffers, count, frame->channel);
+		}
+
+		displayFPS(1, get_current_samples());
+
+		return 0;
 	}
 	else {
 		//cuda_assert(cudaMemcpy(g_pixels_buf_recv_d, //g_pixels_buf_d,
@@ -629,14 +1311,41 @@ int send_pixels_data()
 		//	g_renderengine_data.width * g_renderengine_data.height * PIX_SIZE * 4,
 		//	cudaMemcpyHostToDevice));  // cudaMemcpyDefault gpuMemcpyHostToDevice
 
-		tcpConnection.send_data_data((char*)g_pixels_buf,
-			g_renderengine_data.width * g_renderengine_data.height * PIX_SIZE * 4 /*, false*/);
+		// pixels and data state in one go, with the resolution of the frame in front
+		TcpBuffer buffers[TCP_GATHER_MAX];
+		int count = 0;
+		if (g_dynamic_resolution)
+			buffers[count++] = { (char*)&g_renderengine_data, sizeof(renderengine_data) };
+
+		// only the region of interest of the client, behind its rectangle
+		char* pixels = (char*)g_pixels_buf;
+		g_roi_rect = roi_rect();
+		if (g_roi) {
+			pixels = roi_pixels(g_roi_rect);
+			buffers[count++] = { (char*)&g_roi_rect, sizeof(renderengine_tile) };
+		}
+
+		bool pipelined = g_pipelined && g_codec.get_codec() != CODEC_NONE && !is_video_wire();
+		int pixels_count = pixels_messages(buffers + count, pixels, g_roi_rect.width, g_roi_rect.height, true, pipelined);
+		if (pixels_count < 0)
+			return -1;
+		count += pixels_count;
+
+		if (pipelined) {
+			g_connection->send_data_gather(buffers, count);
+			if (g_connection->is_error() || send_codec_strips() < 0)
+				return -1;
+
+			g_connection->send_data_data((char*)&g_hs_data_state, sizeof(BRaaSHPCDataState));
+		}
+		else {
+			buffers[count++] = { (char*)&g_hs_data_state, sizeof(BRaaSHPCDataState) };
+			g_connection->send_data_gather(buffers, count);
+		}
 
 		//current_samples = ((int*)g_pixels_buf)[0];
 	}
 
-	tcpConnection.send_data_data((char*)&g_hs_data_state, sizeof(BRaaSHPCDataState));
-
 //#ifdef _WIN32
 	displayFPS(1, get_current_samples());
 //#endif	
@@ -644,11 +1353,143 @@ int send_pixels_data()
 	return 0;
 }
 
-int send_cam_data()
+int send_pixels_tile(int x, int y, int width, int height, void* pixels, int stride, int last)
 {
-	tcpConnection.send_data_data((char*)&g_renderengine_data, sizeof(renderengine_data));
+	// the tiles share the connection with the frames of the sender thread
+	if (g_frame_sender.is_running()) {
+		printf("send_pixels_tile: Not with async send\n");
+		return -1;
+	}
 
-	return 0;
+	if (x < 0 || y < 0 || width <= 0 || height <= 0 ||
+		x + width > g_renderengine_data.width || y + height > g_renderengine_data.height) {
+		printf("send_pixels_tile: Tile %d %d %d %d out of the frame\n", x, y, width, height);
+		return -1;
+	}
+
+	char* data = (char*)pixels;
+	size_t row_size = (size_t)width * PIX_SIZE * 4;
+	if (stride < 0 || (stride > 0 && (size_t)stride < row_size)) {
+		printf("send_pixels_tile: Stride %d is negative or less than a row of %d bytes\n", stride, (int)row_size);
+		return -1;
+	}
+
+	// rows with a stride are joined first
+	if (stride > 0 && (size_t)stride != row_size) {
+		g_pixels_tile.resize(row_size * height);
+		for (int r = 0; r < height; r++) {
+			memcpy(g_pixels_tile.data() + r * row_size, (const char*)pixels + (size_t)r * stride, row_size);
+		}
+		data = g_pixels_tile.data();
+	}
+
+	// the tiles change the frame behind the hashes of the dirty tiles, the next frame is whole
+	g_dirty_tiles.reset();
+
+	renderengine_tile tile = { x, y, width, height, last ? 1 : 0, 0 };
+
+	TcpBuffer buffers[TCP_GATHER_MAX];
+	int count = 0;
+	buffers[count++] = { (char*)&tile, sizeof(renderengine_tile) };
+
+	int pixels_count = pixels_messages(buffers + count, data, width, height, false, false);
+	if (pixels_count < 0)
+		return -1;
+	count += pixels_count;
+
+	buffers[count++] = { (char*)&g_hs_data_state, sizeof(BRaaSHPCDataState) };
+	g_connection->send_data_gather(buffers, count);
+	if (g_connection->is_error())
+		return -1;
+
+	if (last)
+		displayFPS(1, get_current_samples());
+
+	return 0;
+}
+
+int recv_pixels_tile(int* x, int* y, int* width, int* height)
+{
+	if (g_frame_receiver.is_running()) {
+		printf("recv_pixels_tile: Not with async recv\n");
+		return -1;
+	}
+
+	cuda_set_device();
+
+	renderengine_tile tile;
+	g_connection->recv_data_data((char*)&tile, sizeof(renderengine_tile));
+	if (g_connection->is_error())
+		return -1;
+
+	if (tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0 ||
+		tile.x + tile.width > g_renderengine_data.width || tile.y + tile.height > g_renderengine_data.height) {
+		printf("recv_pixels_tile: invalid tile %d %d %d %d\n", tile.x, tile.y, tile.width, tile.height);
+		return -1;
+	}
+
+	// a tile of whole rows goes straight into the frame
+	size_t frame_row_size = (size_t)g_renderengine_data.width * PIX_SIZE * 4;
+	size_t row_size = (size_t)tile.width * PIX_SIZE * 4;
+	char* rows = (char*)g_pixels_buf + tile.y * frame_row_size;
+	char* pixels = rows;
+	if (tile.width != g_renderengine_data.width) {
+		g_pixels_tile.resize(row_size * tile.height);
+		pixels = g_pixels_tile.data();
+	}
+
+	if (recv_pixels_messages(pixels, tile.width, tile.height, false) < 0)
+		return -1;
+
+	// g_pixels_buf is the base of the next dirty tiles frame, which the server sends whole now
+	g_dirty_tiles.reset();
+
+	if (pixels != rows) {
+		for (int r = 0; r < tile.height; r++) {
+			memcpy(rows + r * frame_row_size + tile.x * PIX_SIZE * 4, pixels + r * row_size, row_size);
+		}
+	}
+
+#if defined(WITH_CLIENT_GPUJPEG)
+	cuda_assert(cudaMemcpy((char*)g_pixels_buf_recv_d + tile.y * frame_row_size,
+		rows,
+		tile.height * frame_row_size,
+		cudaMemcpyHostToDevice));
+#endif
+
+	if (g_tile_row_end <= g_tile_row_begin || tile.y < g_tile_row_begin)
+		g_tile_row_begin = tile.y;
+	if (tile.y + tile.height > g_tile_row_end)
+		g_tile_row_end = tile.y + tile.height;
+
+	if (x) *x = tile.x;
+	if (y) *y = tile.y;
+	if (width) *width = tile.width;
+	if (height) *height = tile.height;
+
+	if (tile.last)
+		displayFPS(1, get_current_samples());
+
+	return tile.last ? 1 : 0;
+}
+
+int send_cam_data()
+{
+	// viewers only watch, the camera is set by the client
+	if (g_viewer)
+		return 0;
+
+	// the async receiver takes whole frames only
+	if (g_frame_receiver.is_running()) {
+		renderengine_data data = g_renderengine_data;
+		memset(data.roi, 0, sizeof(data.roi));
+		g_connection->send_data_data((char*)&data, sizeof(renderengine_data));
+		return 0;
+	}
+
+	g_connection->send_data_data((char*)&g_renderengine_data, sizeof(renderengine_data));
+
+	return 0;
 }
 
 int recv_cam_data()
@@ -656,8 +1497,20 @@ int recv_cam_data()
 	//int width_old = g_renderengine_data.width;
 	//int height_old = g_renderengine_data.height;
 
-	//tcpConnection.recv_data_data((char*)&g_renderengine_data, sizeof(renderengine_data));
-	tcpConnection.recv_data_data((char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+	//g_connection->recv_data_data((char*)&g_renderengine_data, sizeof(renderengine_data));
+	g_connection->recv_data_data((char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+
+	// a new region of interest only changes what is sent
+	memcpy(g_renderengine_data_cam.roi, g_renderengine_data_recv.roi, sizeof(g_renderengine_data_recv.roi));
+
+	int compare = memcmp((char*)&g_renderengine_data_cam, (char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+	memcpy((char*)&g_renderengine_data_cam, (char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+
+	if (compare != 0)
+		g_camera_idle_frames = 0;
+
+	if (g_renderengine_data_recv.reset)
+		g_video.force_key();
 
 	int width = g_renderengine_data_recv.width;
 	int height = g_renderengine_data_recv.height;
@@ -665,10 +1518,22 @@ int recv_cam_data()
 	//g_renderengine_data.width = width_old;
 	//g_renderengine_data.height = height_old;
 
+	// the full resolution returns once the view is still
+	if (g_dynamic_resolution && g_camera_idle_frames < g_quality.get_idle_frames()) {
+		width = (width + g_dynamic_resolution_scale - 1) / g_dynamic_resolution_scale;
+		height = (height + g_dynamic_resolution_scale - 1) / g_dynamic_resolution_scale;
+	}
+
+	// a change of the resolution restarts the render like a change of the camera
+	if (compare == 0 && (width != g_renderengine_data.width || height != g_renderengine_data.height))
+		compare = 1;
+
 	resize_internal(width, height, false);
 
-	int compare = memcmp((char*)&g_renderengine_data, (char*)&g_renderengine_data_recv, sizeof(renderengine_data));
 	memcpy((char*)&g_renderengine_data, (char*)&g_renderengine_data_recv, sizeof(renderengine_data));
+	g_renderengine_data.width = width;
+	g_renderengine_data.height = height;
+	g_roi_rect = roi_rect();
 
 	return compare;
 }
@@ -678,19 +1543,19 @@ void reset()
 	renderengine_data rd;
 	rd.reset = 1;
 
-	tcpConnection.send_data_data((char*)&rd, sizeof(renderengine_data));
+	g_connection->send_data_data((char*)&rd, sizeof(renderengine_data));
 }
 
 void send_braas_hpc_renderengine_data_render(const char* data, int size)
 {
-	tcpConnection.send_data_data((char*)&size, sizeof(int));
+	g_connection->send_data_data((char*)&size, sizeof(int));
 	if(size > 0)
-		tcpConnection.send_data_data((char*)data, size);
+		g_connection->send_data_data((char*)data, size);
 }
 
 void recv_braas_hpc_renderengine_data(const char* data, int size)
 {
-	tcpConnection.recv_data_data((char*)data, size);
+	g_connection->recv_data_data((char*)data, size);
 }
 
 //void braas_hpc_renderengine_init(const char* server,
@@ -727,7 +1592,13 @@ void set_braas_hpc_renderengine_range(
 
 void set_timestep(int timestep)
 {
-	tcpConnection.set_port_offset(timestep);
+	g_connection->set_port_offset(timestep);
+}
+
+int get_timestep()
+{
+	// with timestep channels the server follows the timestep of the client
+	return g_connection->get_port_offset();
 }
 
 int get_pixsize()
@@ -766,15 +1637,350 @@ int is_gpujpeg() {
 
 int enable_gpujpeg(int enabled)
 {
-#ifdef WITH_CLIENT_GPUJPEG
+#if defined(WITH_CLIENT_GPUJPEG) || defined(WITH_CLIENT_JPEG)
+	// without GPUJPEG the same JPEG stream is encoded/decoded on the CPU
 	USE_GPUJPEG = (enabled != 0);
 	return 0;
 #else
-	printf("enable_gpujpeg: Not compiled with GPUJPEG support\n");
+	printf("enable_gpujpeg: Not compiled with GPUJPEG or JPEG support\n");
 	return -1;
 #endif
 }
 
+int get_codec() {
+	return g_codec.get_codec();
+}
+
+int set_codec(int codec)
+{
+	// both sides have to use it, GPUJPEG takes precedence when enabled
+	if (!g_codec.set_codec(codec)) {
+		printf("set_codec: Not compiled with support for codec %d\n", codec);
+		return -1;
+	}
+	return 0;
+}
+
+int get_codec_level() {
+	return g_codec.get_level();
+}
+
+void set_codec_level(int level)
+{
+	g_codec.set_level(level);
+}
+
+int enable_codec_shuffle(int enabled)
+{
+	// the header tells the client, only the server has to set it
+	g_codec.set_shuffle(enabled != 0);
+	return 0;
+}
+
+int is_codec_shuffle() {
+	return g_codec.is_shuffle() ? 1 : 0;
+}
+
+int enable_codec_delta(int enabled)
+{
+	g_codec.set_delta(enabled != 0);
+	return 0;
+}
+
+int is_codec_delta() {
+	return g_codec.is_delta() ? 1 : 0;
+}
+
+int enable_codec_pipeline(int enabled)
+{
+	// the header tells the client, only the server has to set it
+	g_pipelined = (enabled != 0);
+	return 0;
+}
+
+int is_codec_pipeline() {
+	return g_pipelined ? 1 : 0;
+}
+
+int is_dirty_tiles() {
+	return g_dirty_tiles_enabled ? 1 : 0;
+}
+
+int enable_dirty_tiles(int enabled)
+{
+	// both sides have to use it, the first frame has all tiles
+	g_dirty_tiles_enabled = (enabled != 0);
+	g_dirty_tiles.reset();
+	return 0;
+}
+
+int get_tile_size() {
+	return g_dirty_tiles.get_tile_size();
+}
+
+void set_tile_size(int tile_size)
+{
+	g_dirty_tiles.set_tile_size(tile_size);
+}
+
+int get_sent_tiles() {
+	return g_dirty_tiles.get_sent_tiles();
+}
+
+int get_total_tiles() {
+	return g_dirty_tiles.get_total_tiles();
+}
+
+void set_target_fps(float fps) {
+	g_quality.set_target_fps(fps);
+}
+
+float get_target_fps() {
+	return g_quality.get_target_fps();
+}
+
+void set_quality_range(int min_quality, int max_quality) {
+	g_quality.set_range(min_quality, max_quality);
+}
+
+void set_idle_frames(int frames) {
+	g_quality.set_idle_frames(frames);
+}
+
+int get_idle_frames() {
+	return g_quality.get_idle_frames();
+}
+
+int get_compressed_quality() {
+	return g_connection->get_compressed_quality();
+}
+
+float get_throughput() {
+	return (float)(g_quality.get_throughput() / (1024.0 * 1024.0));
+}
+
+int enable_dynamic_resolution(int enabled)
+{
+	// both sides have to use it, every frame carries its resolution
+	g_dynamic_resolution = (enabled != 0);
+	return 0;
+}
+
+int is_dynamic_resolution() {
+	return g_dynamic_resolution ? 1 : 0;
+}
+
+void set_dynamic_resolution_scale(int scale) {
+	g_dynamic_resolution_scale = scale > 1 ? scale : 1;
+}
+
+int get_dynamic_resolution_scale() {
+	return g_dynamic_resolution_scale;
+}
+
+int enable_half_float(int enabled)
+{
+	// both sides have to use it, only F32 pixels are converted
+	g_half_float = (enabled != 0);
+	g_dirty_tiles.reset();
+	return 0;
+}
+
+int is_half_float() {
+	return g_half_float ? 1 : 0;
+}
+
+int enable_packed_rgb(int enabled)
+{
+	// both sides have to use it, not used with JPEG and video that have no alpha anyway
+	g_packed_rgb = (enabled != 0);
+	g_dirty_tiles.reset();
+	return 0;
+}
+
+int is_packed_rgb() {
+	return g_packed_rgb ? 1 : 0;
+}
+
+int enable_roi(int enabled)
+{
+	// both sides have to use it, every frame carries its rectangle
+	g_roi = (enabled != 0);
+	g_dirty_tiles.reset();
+	return 0;
+}
+
+int is_roi() {
+	return g_roi ? 1 : 0;
+}
+
+void set_roi(int x, int y, int width, int height)
+{
+	// sent with the camera, an empty region is the whole frame
+	bool whole = width <= 0 || height <= 0;
+	g_renderengine_data.roi[0] = whole ? 0 : x;
+	g_renderengine_data.roi[1] = whole ? 0 : y;
+	g_renderengine_data.roi[2] = whole ? 0 : width;
+	g_renderengine_data.roi[3] = whole ? 0 : height;
+}
+
+void get_roi(int* x, int* y, int* width, int* height)
+{
+	if (x) *x = g_roi_rect.x;
+	if (y) *y = g_roi_rect.y;
+	if (width) *width = g_roi_rect.width;
+	if (height) *height = g_roi_rect.height;
+}
+
+int enable_video(int enabled)
+{
+	// both sides have to use it, GPUJPEG takes precedence when enabled
+	if (enabled && !VideoCodec::is_supported()) {
+		printf("enable_video: Not compiled with OpenH264\n");
+		return -1;
+	}
+
+	g_video_enabled = (enabled != 0);
+	g_video.reset();
+	return 0;
+}
+
+int is_video() {
+	return g_video_enabled ? 1 : 0;
+}
+
+void set_video_bitrate(int bitrate) {
+	g_video.set_bitrate(bitrate);
+}
+
+int get_video_bitrate() {
+	return g_video.get_bitrate();
+}
+
+int is_framed_protocol() {
+	return g_connection->is_framed() ? 1 : 0;
+}
+
+int enable_framed_protocol(int enabled)
+{
+	// both sides have to use the same protocol, call it before client_init/server_init
+	g_connection->set_framed(enabled != 0);
+	return 0;
+}
+
+int is_timestep_channels() {
+	return g_connection->is_multiplexed() ? 1 : 0;
+}
+
+int enable_timestep_channels(int enabled)
+{
+	// needs the framed protocol, both sides have to enable it before client_init/server_init
+	g_connection->set_multiplexed(enabled != 0);
+	return 0;
+}
+
+int get_stripes() {
+	return g_connection->get_stripes();
+}
+
+void set_stripes(int stripes)
+{
+	// the stripe connections are opened by client_init/server_init
+	g_connection->set_stripes(stripes);
+}
+
+int is_event_loop() {
+	return g_connection->is_event_loop() ? 1 : 0;
+}
+
+int enable_event_loop(int enabled)
+{
+	g_connection->set_event_loop(enabled != 0);
+	return g_connection->is_event_loop() == (enabled != 0) ? 0 : -1;
+}
+
+int get_socket_timeout() {
+	return g_connection->get_timeout();
+}
+
+void set_socket_timeout(int sec)
+{
+	g_connection->set_timeout(sec < 0 ? 0 : sec);
+}
+
+int get_connect_timeout() {
+	return g_connection->get_connect_timeout();
+}
+
+void set_connect_timeout(int sec)
+{
+	g_connection->set_connect_timeout(sec < 0 ? 0 : sec);
+}
+
+float get_connect_latency() {
+	return (float)g_connection->get_connect_latency();
+}
+
+int get_max_viewers() {
+	return g_max_viewers;
+}
+
+void set_max_viewers(int max_viewers)
+{
+	// the server accepts viewers from server_init on
+	g_max_viewers = max_viewers < 0 ? 0 : max_viewers;
+}
+
+int get_viewer_count() {
+	return g_frame_broadcaster.get_viewer_count();
+}
+
+int is_viewer() {
+	return g_viewer ? 1 : 0;
+}
+
+int is_async_send() {
+	return g_async_send ? 1 : 0;
+}
+
+int enable_async_send(int enabled)
+{
+	g_async_send = (enabled != 0);
+	return 0;
+}
+
+int get_dropped_frames() {
+	return g_frame_sender.get_dropped() + g_frame_receiver.get_dropped() + g_frame_broadcaster.get_dropped();
+}
+
+int is_async_recv() {
+	return g_async_recv ? 1 : 0;
+}
+
+int enable_async_recv(int enabled)
+{
+	g_async_recv = (enabled != 0);
+	return 0;
+}
+
+void select_connection(const char* server)
+{
+#ifndef _WIN32
+	if (ShmConnection::is_shm_name(server)) {
+		// the timeouts are set before the transport is known
+		shmConnection.set_timeout(tcpConnection.get_timeout());
+		shmConnection.set_connect_timeout(tcpConnection.get_connect_timeout());
+		g_connection = &shmConnection;
+		return;
+	}
+#else
+	if (server != NULL && strncmp(server, "shm://", 6) == 0) {
+		printf("select_connection: shared memory is not supported on Windows, using TCP\n");
+	}
+#endif
+	g_connection = &tcpConnection;
+}
+
 void client_init(const char* server,
 	int port,
 	//int port_data,
@@ -794,13 +2000,39 @@ void client_init(const char* server,
 	//g_renderengine_data.step_samples = step_samples;
 	//strcpy(g_renderengine_data.filename, filename);
 
-	tcpConnection.init_sockets_data(server, port, false);
+	select_connection(server);
+	g_connection->init_sockets_data(server, port, false);
 	//gladLoadGL();
 	
 	memset(&g_renderengine_data, 0, sizeof(renderengine_data));
 	memset(&g_hs_data_state, 0, sizeof(BRaaSHPCDataState));
 
 	resize_internal(w, h, true);
+
+	if (g_async_recv) {
+		if (USE_GPUJPEG || g_codec.get_codec() != CODEC_NONE || g_dirty_tiles_enabled || g_dynamic_resolution || is_video_wire() || !g_connection->is_full_duplex()) {
+			printf("client_init: asynchronous receive needs the framed protocol or shared memory and no GPUJPEG/codec/dirty tiles/dynamic resolution/video, receiving synchronously\n");
+		}
+		else {
+			g_frame_receiver.start(g_connection, pixels_message_sizes());
+		}
+	}
+}
+
+void viewer_init(const char* server,
+	int port,
+	int w,
+	int h)
+{
+	// viewers are served over TCP only, see FrameBroadcaster
+	g_connection = &tcpConnection;
+	g_connection->init_sockets_viewer(server, port);
+	g_viewer = true;
+
+	memset(&g_renderengine_data, 0, sizeof(renderengine_data));
+	memset(&g_hs_data_state, 0, sizeof(BRaaSHPCDataState));
+
+	resize_internal(w, h, true);
 }
 
 void server_init(const char* server,
@@ -808,9 +2040,29 @@ void server_init(const char* server,
 	int w,
 	int h)
 {
-	tcpConnection.init_sockets_data(server, port, true);
+	select_connection(server);
+	g_connection->init_sockets_data(server, port, true);
+
+	// a new client has no previous frame to patch
+	g_dirty_tiles.reset();
+	g_codec.reset();
+	g_video.reset();
+
+	if (g_async_send && !g_connection->is_full_duplex()) {
+		printf("server_init: asynchronous send needs the framed protocol or shared memory, sending synchronously\n");
+	}
+
+	if (g_max_viewers > 0) {
+		if (USE_GPUJPEG) {
+			printf("server_init: viewers are not supported with GPUJPEG\n");
+		}
+		else {
+			g_frame_broadcaster.start(g_connection, g_max_viewers);
+		}
+	}
 
 	memset(&g_renderengine_data, 0, sizeof(renderengine_data));
+	memset(&g_renderengine_data_cam, 0, sizeof(renderengine_data));
 	memset(&g_hs_data_state, 0, sizeof(BRaaSHPCDataState));
 
 	resize_internal(w, h, false);
@@ -818,14 +2070,22 @@ void server_init(const char* server,
 
 void client_close_connection()
 {
-	tcpConnection.client_close();
-	tcpConnection.server_close();
+	g_frame_receiver.stop();
+	g_viewer = false;
+
+	g_connection->client_close();
+	g_connection->server_close();
 }
 
 void server_close_connection()
 {
-	tcpConnection.client_close();
-	tcpConnection.server_close();
+	// the pending frame is sent before closing
+	g_frame_broadcaster.stop();
+	g_frame_sender.stop();
+	g_frame_pool.clear();
+
+	g_connection->client_close();
+	g_connection->server_close();
 }
 
 void set_camera(void* view_martix,
@@ -941,21 +2201,83 @@ void set_pixels(void* pixels, bool device)
 #endif
 	}
 	else {
-		if (USE_GPUJPEG) {
 #if defined(WITH_CLIENT_GPUJPEG)
+		if (USE_GPUJPEG) {
 			cuda_assert(cudaMemcpy(
 				g_pixels_buf_recv_d,
 				pixels,
 				(size_t)g_renderengine_data.width * g_renderengine_data.height * pix_type_size,
 				cudaMemcpyHostToDevice));  // cudaMemcpyDefault gpuMemcpyHostToDevice
-#endif
 		}
-		else {
+		else
+#endif
+		{
 			memcpy((char*)g_pixels_buf, pixels, g_renderengine_data.width * g_renderengine_data.height * pix_type_size);
 		}
 	}
 }
 
+void set_pixels_float(void* pixels)
+{
+	cuda_set_device();
+
+	size_t count = (size_t)g_renderengine_data.width * g_renderengine_data.height;
+
+	if (PIX_SIZE == TCP_PIX_SIZE_F32) {
+		memcpy((char*)g_pixels_buf, pixels, count * sizeof(float) * 4);
+	}
+	else if (PIX_SIZE == TCP_PIX_SIZE_U16) {
+		// the texture of U16 pixels is half float
+		color_float_to_half((unsigned short*)g_pixels_buf, (const float*)pixels, count * 4);
+	}
+	else { //TCP_PIX_SIZE_U8
+		g_tonemap.apply(g_pixels_buf, (const float*)pixels, g_renderengine_data.height, g_renderengine_data.width);
+	}
+
+#if defined(WITH_CLIENT_GPUJPEG)
+	if (USE_GPUJPEG) {
+		cuda_assert(cudaMemcpy(
+			g_pixels_buf_recv_d,
+			g_pixels_buf,
+			count * PIX_SIZE * 4,
+			cudaMemcpyHostToDevice));
+	}
+#endif
+}
+
+void set_tonemap(int curve) {
+	g_tonemap.set_curve(curve);
+}
+
+int get_tonemap() {
+	return g_tonemap.get_curve();
+}
+
+void set_tonemap_exposure(float exposure) {
+	g_tonemap.set_exposure(exposure);
+}
+
+float get_tonemap_exposure() {
+	return g_tonemap.get_exposure();
+}
+
+void set_tonemap_gamma(float gamma) {
+	g_tonemap.set_gamma(gamma);
+}
+
+float get_tonemap_gamma() {
+	return g_tonemap.get_gamma();
+}
+
+int enable_tonemap_dither(int enabled) {
+	g_tonemap.set_dither(enabled != 0);
+	return 0;
+}
+
+int is_tonemap_dither() {
+	return g_tonemap.get_dither() ? 1 : 0;
+}
+
 unsigned long long int get_gpu_buffer() {
 	return (unsigned long long int)g_pixels_buf_recv_d;
 }
@@ -970,7 +2292,7 @@ int get_texture_id()
 }
 
 int com_error() {
-	return tcpConnection.is_error();
+	return g_connection->is_error();
 }
 
 int get_width() {
@@ -981,3 +2303,7 @@ int get_height() {
 	return g_renderengine_data.height;
 }
 
+const char* get_color_isa() {
+	return color_get_isa_name();
+}
+
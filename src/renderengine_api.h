@@ -40,28 +40,108 @@ extern "C"
 #endif
 
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD resize(int width, int height);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_huge_pages(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_huge_pages();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_locked_buffers(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_locked_buffers();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_buffer_allocations();
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_resolution(int width, int height);
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_frame(int frame);
 
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD get_pixels(void* pixels);
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_pixels(void* pixels, bool device);
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_pixels_float(void* pixels);
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_tonemap(int curve);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_tonemap();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_tonemap_exposure(float exposure);
+	BRAAS_HPC_EXPORT_DLL float BRAAS_HPC_EXPORT_STD get_tonemap_exposure();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_tonemap_gamma(float gamma);
+	BRAAS_HPC_EXPORT_DLL float BRAAS_HPC_EXPORT_STD get_tonemap_gamma();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_tonemap_dither(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_tonemap_dither();
 	BRAAS_HPC_EXPORT_DLL unsigned long long int BRAAS_HPC_EXPORT_STD get_gpu_buffer();
 
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD recv_pixels_data();
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD send_pixels_data();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD send_pixels_tile(int x, int y, int width, int height, void* pixels, int stride, int last);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD recv_pixels_tile(int* x, int* y, int* width, int* height);
 	
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD send_cam_data();
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD recv_cam_data();
 
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_timestep(int timestep);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_timestep();
 
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_pixsize(int ps);
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_pixsize();
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_gpujpeg(int enabled);
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_gpujpeg();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD set_codec(int codec);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_codec();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_codec_level(int level);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_codec_level();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_codec_shuffle(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_codec_shuffle();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_codec_delta(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_codec_delta();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_codec_pipeline(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_codec_pipeline();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_dirty_tiles(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_dirty_tiles();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_tile_size(int tile_size);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_tile_size();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_sent_tiles();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_total_tiles();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_target_fps(float fps);
+	BRAAS_HPC_EXPORT_DLL float BRAAS_HPC_EXPORT_STD get_target_fps();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_quality_range(int min_quality, int max_quality);
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_idle_frames(int frames);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_idle_frames();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_compressed_quality();
+	BRAAS_HPC_EXPORT_DLL float BRAAS_HPC_EXPORT_STD get_throughput();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_dynamic_resolution(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_dynamic_resolution();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_dynamic_resolution_scale(int scale);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_dynamic_resolution_scale();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_half_float(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_half_float();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_packed_rgb(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_packed_rgb();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_roi(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_roi();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_roi(int x, int y, int width, int height);
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD get_roi(int* x, int* y, int* width, int* height);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_video(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_video();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_video_bitrate(int bitrate);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_video_bitrate();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_framed_protocol(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_framed_protocol();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_timestep_channels(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_timestep_channels();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_stripes(int stripes);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_stripes();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_event_loop(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_event_loop();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_socket_timeout(int sec);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_socket_timeout();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_connect_timeout(int sec);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_connect_timeout();
+	BRAAS_HPC_EXPORT_DLL float BRAAS_HPC_EXPORT_STD get_connect_latency();
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD set_max_viewers(int max_viewers);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_max_viewers();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_viewer_count();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_viewer();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_async_send(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_async_send();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_dropped_frames();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD enable_async_recv(int enabled);
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD is_async_recv();
+	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD recv_latest_pixels_data();
 
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD client_init(const char *server, int port, int w, int h);
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD server_init(const char* server, int port, int w, int h);
+	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD viewer_init(const char* server, int port, int w, int h);
 
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD client_close_connection();
 	BRAAS_HPC_EXPORT_DLL void BRAAS_HPC_EXPORT_STD server_close_connection();
@@ -126,6 +206,8 @@ extern "C"
 
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_width();
 	BRAAS_HPC_EXPORT_DLL int BRAAS_HPC_EXPORT_STD get_height();
+
+	BRAAS_HPC_EXPORT_DLL const char* BRAAS_HPC_EXPORT_STD get_color_isa();
 	
 
 #ifdef __cplusplus
@@ -0,0 +1,467 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_async.h"
+
+#include <stdio.h>
+#include <utility>
+
+char* WireFrame::add_message(const void* data, size_t size)
+{
+	if ((int)messages.size() <= message_count) {
+		messages.resize(message_count + 1);
+	}
+
+	std::vector<char>& message = messages[message_count++];
+	if (data != NULL) {
+		message.assign((const char*)data, (const char*)data + size);
+	}
+	else {
+		message.resize(size);
+	}
+
+	return message.data();
+}
+
+int WireFrame::get_buffers(int first, TcpBuffer* buffers)
+{
+	int count = 0;
+	for (int i = first; i < message_count && count < TCP_GATHER_MAX; i++) {
+		buffers[count].data = messages[i].data();
+		buffers[count].size = messages[i].size();
+		count++;
+	}
+	return count;
+}
+
+std::shared_ptr<WireFrame> WireFramePool::acquire()
+{
+	for (size_t i = 0; i < m_frames.size(); i++) {
+		if (m_frames[i].use_count() == 1) {
+			m_frames[i]->clear();
+			return m_frames[i];
+		}
+	}
+
+	m_frames.push_back(std::make_shared<WireFrame>());
+	return m_frames.back();
+}
+
+FrameSender::~FrameSender()
+{
+	stop();
+}
+
+void FrameSender::start(TcpConnection* connection, int first_message)
+{
+	if (m_running)
+		return;
+
+	m_connection = connection;
+	m_first_message = first_message;
+	m_stop = false;
+	m_sent = 0;
+	m_dropped = 0;
+	m_running = true;
+	m_thread = std::thread(&FrameSender::run, this);
+}
+
+void FrameSender::stop()
+{
+	if (!m_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+
+	m_thread.join();
+	m_running = false;
+}
+
+void FrameSender::submit(const std::shared_ptr<WireFrame>& frame)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pending) {
+			m_dropped++;
+		}
+		m_pending = frame;
+	}
+	m_cv.notify_all();
+}
+
+bool FrameSender::has_pending()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pending != NULL;
+}
+
+void FrameSender::run()
+{
+	while (true) {
+		std::shared_ptr<WireFrame> frame;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this] { return m_stop || m_pending; });
+
+			// the last submitted frame is still sent on stop
+			if (!m_pending)
+				break;
+
+			frame.swap(m_pending);
+		}
+
+		TcpBuffer buffers[TCP_GATHER_MAX];
+		int count = frame->get_buffers(m_first_message, buffers);
+		m_connection->send_data_gather(buffers, count, frame->channel);
+
+		m_sent++;
+	}
+}
+
+FrameBroadcaster::~FrameBroadcaster()
+{
+	stop();
+}
+
+void FrameBroadcaster::start(TcpConnection* connection, int max_viewers)
+{
+	if (m_running || max_viewers < 1 || !connection->listen_viewers())
+		return;
+
+	m_connection = connection;
+	m_max_viewers = max_viewers;
+	m_stop = false;
+	m_dropped = 0;
+	m_running = true;
+	m_thread = std::thread(&FrameBroadcaster::run, this);
+}
+
+void FrameBroadcaster::stop()
+{
+	if (!m_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_thread.join();
+
+	for (size_t i = 0; i < m_viewers.size(); i++) {
+		m_viewers[i]->sender.stop();
+		m_viewers[i]->connection.client_close();
+	}
+	m_viewers.clear();
+	m_running = false;
+}
+
+void FrameBroadcaster::submit(const std::shared_ptr<WireFrame>& frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_viewers.size();) {
+		FrameViewer* viewer = m_viewers[i].get();
+		if (viewer->connection.is_error()) {
+			printf("viewer disconnected\n");
+			viewer->sender.stop();
+			viewer->connection.client_close();
+			m_dropped += viewer->sender.get_dropped();
+			m_viewers.erase(m_viewers.begin() + i);
+			continue;
+		}
+
+		// a viewer that just connected cannot decode a delta
+		if (viewer->wait_key && !frame->key) {
+			i++;
+			continue;
+		}
+
+		viewer->wait_key = false;
+		viewer->sender.submit(frame);
+		i++;
+	}
+}
+
+bool FrameBroadcaster::needs_key()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_viewers.size(); i++) {
+		if (m_viewers[i]->wait_key || m_viewers[i]->sender.has_pending())
+			return true;
+	}
+	return false;
+}
+
+int FrameBroadcaster::get_viewer_count()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (int)m_viewers.size();
+}
+
+int FrameBroadcaster::get_dropped()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	int dropped = m_dropped;
+	for (size_t i = 0; i < m_viewers.size(); i++) {
+		dropped += m_viewers[i]->sender.get_dropped();
+	}
+	return dropped;
+}
+
+void FrameBroadcaster::run()
+{
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stop)
+				break;
+		}
+
+		int client_id = m_connection->accept_viewer(TCP_VIEWER_ACCEPT_MS);
+		if (client_id == -1)
+			continue;
+
+		std::unique_ptr<FrameViewer> viewer(new FrameViewer());
+		viewer->connection.attach_viewer(client_id, m_connection);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if ((int)m_viewers.size() >= m_max_viewers) {
+			printf("viewer rejected, max. %d viewers\n", m_max_viewers);
+			viewer->connection.client_close();
+			continue;
+		}
+
+		viewer->sender.start(&viewer->connection);
+		m_viewers.push_back(std::move(viewer));
+		printf("viewer connected (%d)\n", (int)m_viewers.size());
+	}
+}
+
+FrameReceiver::~FrameReceiver()
+{
+	stop();
+}
+
+void FrameReceiver::start(TcpConnection* connection, const std::vector<size_t>& sizes)
+{
+	if (m_running)
+		return;
+
+	m_connection = connection;
+	m_sizes = sizes;
+	m_fresh = false;
+	m_stop = false;
+	m_error = false;
+	m_received = 0;
+	m_dropped = 0;
+	m_running = true;
+	m_thread = std::thread(&FrameReceiver::run, this);
+}
+
+void FrameReceiver::stop()
+{
+	if (!m_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+
+	m_connection->interrupt_recv();
+	m_thread.join();
+	m_running = false;
+}
+
+void FrameReceiver::set_message_sizes(const std::vector<size_t>& sizes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_sizes = sizes;
+}
+
+bool FrameReceiver::has_message_sizes(const WireFrame& frame)
+{
+	if (frame.message_count != (int)m_sizes.size())
+		return false;
+
+	for (size_t i = 0; i < m_sizes.size(); i++) {
+		if (frame.messages[i].size() != m_sizes[i])
+			return false;
+	}
+	return true;
+}
+
+WireFrame* FrameReceiver::acquire_latest(bool wait, bool* error)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (wait) {
+		m_cv.wait(lock, [this] { return m_fresh || m_error || m_stop; });
+	}
+
+	if (!m_fresh) {
+		if (error != NULL) {
+			*error = m_error;
+		}
+		return NULL;
+	}
+
+	std::swap(m_front, m_ready);
+	m_fresh = false;
+
+	return &m_frames[m_front];
+}
+
+void FrameReceiver::run()
+{
+	while (true) {
+		WireFrame* frame;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stop)
+				break;
+
+			frame = &m_frames[m_back];
+			frame->clear();
+			for (size_t i = 0; i < m_sizes.size(); i++) {
+				frame->add_message(NULL, m_sizes[i]);
+			}
+		}
+
+		// the messages are resized to the sizes on the wire
+		m_connection->recv_data_scatter_sized(frame->messages.data(), frame->message_count);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_connection->is_error()) {
+			m_error = true;
+			m_cv.notify_all();
+			break;
+		}
+
+		// a frame sent before a resize is dropped, the connection stays in sync
+		if (!has_message_sizes(*frame)) {
+			m_dropped++;
+			continue;
+		}
+
+		// the previous frame was not taken by the caller
+		if (m_fresh) {
+			m_dropped++;
+		}
+
+		std::swap(m_back, m_ready);
+		m_fresh = true;
+		m_received++;
+		m_cv.notify_all();
+	}
+}
+
+StripPipeline::~StripPipeline()
+{
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+
+	m_thread.join();
+}
+
+void StripPipeline::start(int strips, const std::function<void()>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_states.assign(strips, 0);
+		m_job = job;
+		m_busy = true;
+	}
+	m_cv.notify_all();
+
+	if (!m_thread.joinable()) {
+		m_thread = std::thread(&StripPipeline::run, this);
+	}
+}
+
+void StripPipeline::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this] { return !m_busy; });
+}
+
+void StripPipeline::set_ready(int strip, bool ok)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_states[strip] == 0) {
+			m_states[strip] = ok ? 1 : -1;
+		}
+	}
+	m_cv.notify_all();
+}
+
+bool StripPipeline::wait_ready(int strip)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this, strip] { return m_states[strip] != 0; });
+	return m_states[strip] > 0;
+}
+
+void StripPipeline::cancel()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < m_states.size(); i++) {
+			if (m_states[i] == 0) {
+				m_states[i] = -1;
+			}
+		}
+	}
+	m_cv.notify_all();
+}
+
+void StripPipeline::run()
+{
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this] { return m_stop || m_job; });
+			if (m_stop)
+				return;
+
+			job.swap(m_job);
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busy = false;
+		}
+		m_cv.notify_all();
+	}
+}
@@ -0,0 +1,223 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_ASYNC_H__
+#define __RENDERENGINE_ASYNC_H__
+
+#include "renderengine_tcp.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One frame as it goes on the wire, the messages are sent in order.
+// The message buffers keep their capacity, so a reused frame does not allocate.
+class BRAAS_HPC_EXPORT_DLL WireFrame {
+public:
+	std::vector<std::vector<char> > messages;
+	int message_count = 0;
+	int channel = -1; // timestep channel the frame is sent on, -1 = the current one
+	bool key = true; // does not depend on the frames before it
+
+	void clear() { message_count = 0; }
+	char* add_message(const void* data, size_t size);
+
+	// the messages from first on for send_data_gather/recv_data_scatter, returns their count
+	int get_buffers(int first, TcpBuffer* buffers);
+};
+
+// Pool of frames, a frame is free again when only the pool references it.
+class BRAAS_HPC_EXPORT_DLL WireFramePool {
+protected:
+	std::vector<std::shared_ptr<WireFrame> > m_frames;
+
+public:
+	std::shared_ptr<WireFrame> acquire();
+	void clear() { m_frames.clear(); }
+};
+
+// Sends frames on a background thread. While a frame is being sent, only the latest
+// submitted frame is kept, older ones are dropped.
+class BRAAS_HPC_EXPORT_DLL FrameSender {
+protected:
+	TcpConnection* m_connection = NULL;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	std::shared_ptr<WireFrame> m_pending;
+	bool m_stop = false;
+	bool m_running = false;
+
+	int m_first_message = 0;
+	// read without the mutex by get_sent and get_dropped
+	std::atomic<int> m_sent{ 0 };
+	std::atomic<int> m_dropped{ 0 };
+
+public:
+	~FrameSender();
+
+	// messages before first_message are not sent by this sender
+	void start(TcpConnection* connection, int first_message = 0);
+	void stop();
+	bool is_running() { return m_running; }
+
+	void submit(const std::shared_ptr<WireFrame>& frame);
+
+	// a frame submitted now would drop the pending one
+	bool has_pending();
+
+	int get_sent() { return m_sent; }
+	int get_dropped() { return m_dropped; }
+
+protected:
+	void run();
+};
+
+// A watch-only client, it gets the frames of the main connection.
+class BRAAS_HPC_EXPORT_DLL FrameViewer {
+public:
+	TcpConnection connection;
+	FrameSender sender;
+	bool wait_key = true; // frames are skipped until a key frame
+};
+
+// Accepts viewers on the viewer port of the main connection and sends every frame
+// to all of them. Each viewer has its own sender, so a slow viewer drops frames
+// without holding back the others.
+class BRAAS_HPC_EXPORT_DLL FrameBroadcaster {
+protected:
+	TcpConnection* m_connection = NULL;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+
+	std::vector<std::unique_ptr<FrameViewer> > m_viewers;
+	int m_max_viewers = 0;
+	bool m_stop = false;
+	bool m_running = false;
+
+	int m_dropped = 0; // dropped by viewers that are gone already
+
+public:
+	~FrameBroadcaster();
+
+	void start(TcpConnection* connection, int max_viewers);
+	void stop();
+	bool is_running() { return m_running; }
+
+	// also removes the viewers with a connection error
+	void submit(const std::shared_ptr<WireFrame>& frame);
+
+	// the next frame has to be a key frame, a viewer waits for one or would drop a frame
+	bool needs_key();
+
+	int get_viewer_count();
+	int get_dropped();
+
+protected:
+	void run();
+};
+
+// Receives frames on a background thread into a triple buffer: one frame is being
+// received, one is the latest complete frame and one is held by the caller.
+class BRAAS_HPC_EXPORT_DLL FrameReceiver {
+protected:
+	TcpConnection* m_connection = NULL;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	WireFrame m_frames[3];
+	int m_back = 0;
+	int m_ready = 1;
+	int m_front = 2;
+	bool m_fresh = false;
+
+	std::vector<size_t> m_sizes;
+	bool m_stop = false;
+	bool m_running = false;
+	bool m_error = false;
+
+	// read without the mutex by get_received and get_dropped
+	std::atomic<int> m_received{ 0 };
+	std::atomic<int> m_dropped{ 0 };
+
+public:
+	~FrameReceiver();
+
+	void start(TcpConnection* connection, const std::vector<size_t>& sizes);
+	void stop();
+	bool is_running() { return m_running; }
+
+	// message sizes of the frames received from now on
+	void set_message_sizes(const std::vector<size_t>& sizes);
+
+	// returns the newest complete frame or NULL if there is none since the last call,
+	// with wait it blocks until one arrives or the connection fails (error is set then).
+	// The frame stays valid until the next call.
+	WireFrame* acquire_latest(bool wait, bool* error = NULL);
+
+	int get_received() { return m_received; }
+	int get_dropped() { return m_dropped; }
+
+protected:
+	void run();
+	bool has_message_sizes(const WireFrame& frame);
+};
+
+// Overlaps two stages of a frame split into strips: a job on a worker thread and the
+// calling thread work on the strips at the same time, one stage marks a strip ready and
+// the other waits for it, e.g. the job compresses the strips while the caller sends the
+// compressed ones in order. The worker thread is kept for the next frames.
+class BRAAS_HPC_EXPORT_DLL StripPipeline {
+protected:
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+
+	std::function<void()> m_job;
+	std::vector<int> m_states; // of the strips: 0 = pending, 1 = ready, -1 = failed
+	bool m_busy = false;
+	bool m_stop = false;
+
+public:
+	~StripPipeline();
+
+	// runs job on the worker thread, all strips are pending
+	void start(int strips, const std::function<void()>& job);
+	// waits until the job is done
+	void wait();
+
+	void set_ready(int strip, bool ok);
+	// false if the strip failed
+	bool wait_ready(int strip);
+	// the strips that are not ready fail, e.g. after a connection error
+	void cancel();
+
+protected:
+	void run();
+};
+
+#endif
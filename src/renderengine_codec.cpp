@@ -0,0 +1,416 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_codec.h"
+#include "renderengine_color.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WITH_CLIENT_LZ4
+#  include <lz4.h>
+#endif
+
+#ifdef WITH_CLIENT_ZSTD
+#  include <zstd.h>
+#endif
+
+PixelCodec::PixelCodec()
+{
+	memset(&m_header, 0, sizeof(PixelCodecHeader));
+}
+
+PixelCodec::~PixelCodec()
+{
+	free_contexts();
+}
+
+bool PixelCodec::is_supported(int codec)
+{
+	switch (codec) {
+	case CODEC_NONE:
+		return true;
+#ifdef WITH_CLIENT_LZ4
+	case CODEC_LZ4:
+		return true;
+#endif
+#ifdef WITH_CLIENT_ZSTD
+	case CODEC_ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+bool PixelCodec::set_codec(int codec)
+{
+	if (!is_supported(codec))
+		return false;
+
+	m_codec = codec;
+	return true;
+}
+
+void PixelCodec::get_strip(const PixelCodecHeader& header, int strip, size_t& offset, size_t& size)
+{
+	// strips start at row boundaries, the last one takes the rest
+	size_t row_size = (size_t)(header.raw_size / header.rows);
+	size_t row_begin = (size_t)header.rows * strip / header.strips;
+	size_t row_end = (size_t)header.rows * (strip + 1) / header.strips;
+
+	offset = row_begin * row_size;
+	size = (strip == header.strips - 1) ? (size_t)header.raw_size - offset : (row_end - row_begin) * row_size;
+}
+
+size_t PixelCodec::compress_bound(size_t size)
+{
+	switch (m_codec) {
+#ifdef WITH_CLIENT_LZ4
+	case CODEC_LZ4:
+		return (size_t)LZ4_compressBound((int)size);
+#endif
+#ifdef WITH_CLIENT_ZSTD
+	case CODEC_ZSTD:
+		return ZSTD_compressBound(size);
+#endif
+	default:
+		return size;
+	}
+}
+
+size_t PixelCodec::compress_strip(int strip, char* destination, size_t capacity, const char* source, size_t size)
+{
+	switch (m_codec) {
+#ifdef WITH_CLIENT_LZ4
+	case CODEC_LZ4:
+		return (size_t)LZ4_compress_default(source, destination, (int)size, (int)capacity);
+#endif
+#ifdef WITH_CLIENT_ZSTD
+	case CODEC_ZSTD: {
+		size_t compressed = ZSTD_compressCCtx(
+			(ZSTD_CCtx*)m_compress_contexts[strip], destination, capacity, source, size, m_level);
+		return ZSTD_isError(compressed) ? 0 : compressed;
+	}
+#endif
+	default:
+		return 0;
+	}
+}
+
+bool PixelCodec::decompress_strip(int strip, char* destination, size_t size, const char* source, size_t compressed_size)
+{
+	switch (m_header.codec) {
+#ifdef WITH_CLIENT_LZ4
+	case CODEC_LZ4:
+		return LZ4_decompress_safe(source, destination, (int)compressed_size, (int)size) == (int)size;
+#endif
+#ifdef WITH_CLIENT_ZSTD
+	case CODEC_ZSTD:
+		return ZSTD_decompressDCtx(
+			(ZSTD_DCtx*)m_decompress_contexts[strip], destination, size, source, compressed_size) == size;
+#endif
+	default:
+		return false;
+	}
+}
+
+int PixelCodec::get_element_size(const PixelCodecHeader& header)
+{
+	int element_size = header.flags & CODEC_FILTER_SHUFFLE;
+	return element_size > 0 ? element_size : 1;
+}
+
+bool PixelCodec::is_valid_flags(const PixelCodecHeader& header)
+{
+	int element_size = header.flags & CODEC_FILTER_SHUFFLE;
+	if ((header.flags & ~(CODEC_FILTER_SHUFFLE | CODEC_FILTER_DELTA | CODEC_FILTER_REFERENCE | CODEC_PIPELINED)) != 0 ||
+		element_size > 16)
+		return false;
+
+	// the strips hold whole elements
+	return element_size == 0 || (header.raw_size % element_size == 0 && (header.raw_size / header.rows) % element_size == 0);
+}
+
+bool PixelCodec::encode(const char* pixels, size_t size, int rows, int channel_size, bool frame)
+{
+	if (!begin_encode(pixels, size, rows, channel_size, frame, false))
+		return false;
+
+	int error = 0;
+
+#pragma omp parallel for
+	for (int s = 0; s < m_header.strips; s++) {
+		if (!encode_strip(s)) {
+#pragma omp atomic write
+			error = 1;
+		}
+	}
+
+	if (error)
+		return false;
+
+	size_t packed = 0;
+	for (int s = 0; s < m_header.strips; s++) {
+		if (packed != m_slots[s]) {
+			memmove(m_data.data() + packed, m_data.data() + m_slots[s], m_header.strip_sizes[s]);
+		}
+		packed += m_header.strip_sizes[s];
+	}
+	m_header.size = packed;
+
+	return true;
+}
+
+bool PixelCodec::begin_encode(const char* pixels, size_t size, int rows, int channel_size, bool frame, bool pipelined)
+{
+	if (m_codec == CODEC_NONE || rows < 1)
+		return false;
+
+	int strips = rows / CODEC_STRIP_MIN_ROWS;
+	if (strips > CODEC_MAX_STRIPS) {
+		strips = CODEC_MAX_STRIPS;
+	}
+	if (strips < 1) {
+		strips = 1;
+	}
+
+	memset(&m_header, 0, sizeof(PixelCodecHeader));
+	m_header.codec = m_codec;
+	m_header.strips = strips;
+	m_header.rows = rows;
+	m_header.raw_size = size;
+	m_pixels = pixels;
+
+	if (m_shuffle && channel_size > 1 && size % channel_size == 0 && (size / rows) % channel_size == 0) {
+		m_header.flags |= channel_size;
+	}
+	if (m_delta && frame) {
+		if (m_reference.size() == size) {
+			m_header.flags |= CODEC_FILTER_DELTA;
+		}
+		m_header.flags |= CODEC_FILTER_REFERENCE;
+		m_reference.resize(size);
+	}
+	if (pipelined) {
+		m_header.flags |= CODEC_PIPELINED;
+	}
+
+	if ((m_header.flags & (CODEC_FILTER_SHUFFLE | CODEC_FILTER_DELTA)) && m_filtered.size() < size) {
+		m_filtered.resize(size);
+	}
+
+#ifdef WITH_CLIENT_ZSTD
+	while ((int)m_compress_contexts.size() < strips) {
+		m_compress_contexts.push_back(ZSTD_createCCtx());
+	}
+#endif
+
+	// every strip gets a slot of its max. compressed size, the slots are packed afterwards
+	m_slots[0] = 0;
+	for (int s = 0; s < strips; s++) {
+		size_t offset, strip_size;
+		get_strip(m_header, s, offset, strip_size);
+		m_slots[s + 1] = m_slots[s] + compress_bound(strip_size);
+	}
+
+	if (m_data.size() < m_slots[strips]) {
+		m_data.resize(m_slots[strips]);
+	}
+
+	return true;
+}
+
+bool PixelCodec::encode_strip(int strip)
+{
+	size_t offset, strip_size;
+	get_strip(m_header, strip, offset, strip_size);
+
+	const char* source = m_pixels + offset;
+	if (m_header.flags & (CODEC_FILTER_SHUFFLE | CODEC_FILTER_DELTA)) {
+		char* filtered = m_filtered.data() + offset;
+		color_shuffle((unsigned char*)filtered, (const unsigned char*)source,
+			(m_header.flags & CODEC_FILTER_DELTA) ? (const unsigned char*)m_reference.data() + offset : NULL,
+			strip_size / get_element_size(m_header), get_element_size(m_header));
+		source = filtered;
+	}
+	if (m_header.flags & CODEC_FILTER_REFERENCE) {
+		memcpy(m_reference.data() + offset, m_pixels + offset, strip_size);
+	}
+
+	char* slot = m_data.data() + m_slots[strip];
+	size_t compressed = compress_strip(strip, slot, m_slots[strip + 1] - m_slots[strip], source, strip_size);
+	if (compressed == 0) {
+		printf("PixelCodec::encode: compression failed\n");
+		return false;
+	}
+	else if (compressed >= strip_size) {
+		// incompressible, e.g. noise in the float pixels
+		memcpy(slot, source, strip_size);
+		compressed = strip_size;
+	}
+
+	m_header.strip_sizes[strip] = (unsigned int)compressed;
+	return true;
+}
+
+char* PixelCodec::get_strip_data(int strip)
+{
+	return m_data.data() + m_slots[strip];
+}
+
+char* PixelCodec::prepare_decode(const PixelCodecHeader& header)
+{
+	if (!is_supported(header.codec) || header.codec == CODEC_NONE || header.strips < 1 ||
+		header.strips > CODEC_MAX_STRIPS || header.rows < header.strips) {
+		printf("PixelCodec::prepare_decode: invalid header (codec %d, %d strips)\n", header.codec, header.strips);
+		return NULL;
+	}
+
+	if (!is_valid_flags(header) ||
+		((header.flags & CODEC_FILTER_DELTA) && m_reference.size() != header.raw_size)) {
+		printf("PixelCodec::prepare_decode: invalid flags %x\n", header.flags);
+		return NULL;
+	}
+
+	// pipelined strips are received one by one to the place of their raw pixels
+	size_t data_size = (size_t)header.raw_size;
+	if (!(header.flags & CODEC_PIPELINED)) {
+		unsigned long long size = 0;
+		for (int s = 0; s < header.strips; s++) {
+			size += header.strip_sizes[s];
+		}
+		if (size != header.size) {
+			printf("PixelCodec::prepare_decode: invalid strip sizes\n");
+			return NULL;
+		}
+		data_size = (size_t)header.size;
+	}
+
+	m_header = header;
+	if (m_data.size() < data_size) {
+		m_data.resize(data_size);
+	}
+
+	size_t raw_size = (size_t)header.raw_size;
+	if ((header.flags & (CODEC_FILTER_SHUFFLE | CODEC_FILTER_DELTA)) && m_filtered.size() < raw_size) {
+		m_filtered.resize(raw_size);
+	}
+	if (header.flags & CODEC_FILTER_REFERENCE) {
+		m_reference.resize(raw_size);
+	}
+
+#ifdef WITH_CLIENT_ZSTD
+	while ((int)m_decompress_contexts.size() < header.strips) {
+		m_decompress_contexts.push_back(ZSTD_createDCtx());
+	}
+#endif
+
+	return m_data.data();
+}
+
+char* PixelCodec::prepare_decode_strip(int strip, size_t size)
+{
+	size_t offset, strip_size;
+	get_strip(m_header, strip, offset, strip_size);
+	if (size == 0 || size > strip_size) {
+		printf("PixelCodec::prepare_decode_strip: invalid size of strip %d\n", strip);
+		return NULL;
+	}
+
+	m_header.strip_sizes[strip] = (unsigned int)size;
+	return m_data.data() + offset;
+}
+
+bool PixelCodec::decode(char* pixels, size_t size)
+{
+	if (size != m_header.raw_size)
+		return false;
+
+	size_t offsets[CODEC_MAX_STRIPS + 1];
+	offsets[0] = 0;
+	for (int s = 0; s < m_header.strips; s++) {
+		offsets[s + 1] = offsets[s] + m_header.strip_sizes[s];
+	}
+
+	int error = 0;
+
+#pragma omp parallel for
+	for (int s = 0; s < m_header.strips; s++) {
+		if (!decode_strip(pixels, s, m_data.data() + offsets[s])) {
+#pragma omp atomic write
+			error = 1;
+		}
+	}
+
+	if (error) {
+		reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool PixelCodec::decode_strip(char* pixels, int strip)
+{
+	size_t offset, strip_size;
+	get_strip(m_header, strip, offset, strip_size);
+
+	return decode_strip(pixels, strip, m_data.data() + offset);
+}
+
+bool PixelCodec::decode_strip(char* pixels, int strip, const char* source)
+{
+	size_t offset, strip_size;
+	get_strip(m_header, strip, offset, strip_size);
+
+	bool filtered = (m_header.flags & (CODEC_FILTER_SHUFFLE | CODEC_FILTER_DELTA)) != 0;
+	char* destination = filtered ? m_filtered.data() + offset : pixels + offset;
+	if (m_header.strip_sizes[strip] == strip_size) {
+		memcpy(destination, source, strip_size);
+	}
+	else if (!decompress_strip(strip, destination, strip_size, source, m_header.strip_sizes[strip])) {
+		printf("PixelCodec::decode: decompression failed\n");
+		return false;
+	}
+
+	if (filtered) {
+		color_unshuffle((unsigned char*)pixels + offset, (const unsigned char*)destination,
+			(m_header.flags & CODEC_FILTER_DELTA) ? (const unsigned char*)m_reference.data() + offset : NULL,
+			strip_size / get_element_size(m_header), get_element_size(m_header));
+	}
+	if (m_header.flags & CODEC_FILTER_REFERENCE) {
+		memcpy(m_reference.data() + offset, pixels + offset, strip_size);
+	}
+
+	return true;
+}
+
+void PixelCodec::free_contexts()
+{
+#ifdef WITH_CLIENT_ZSTD
+	for (size_t i = 0; i < m_compress_contexts.size(); i++) {
+		ZSTD_freeCCtx((ZSTD_CCtx*)m_compress_contexts[i]);
+	}
+	for (size_t i = 0; i < m_decompress_contexts.size(); i++) {
+		ZSTD_freeDCtx((ZSTD_DCtx*)m_decompress_contexts[i]);
+	}
+#endif
+	m_compress_contexts.clear();
+	m_decompress_contexts.clear();
+}
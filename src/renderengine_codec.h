@@ -0,0 +1,133 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_CODEC_H__
+#define __RENDERENGINE_CODEC_H__
+
+#include <stdlib.h>
+#include <vector>
+#include "renderengine_api.h"
+
+#define CODEC_NONE 0
+#define CODEC_LZ4 1
+#define CODEC_ZSTD 2
+
+#define CODEC_MAX_STRIPS 32
+#define CODEC_STRIP_MIN_ROWS 32
+
+// bits of PixelCodecHeader::flags, the filters are applied before the compression
+#define CODEC_FILTER_SHUFFLE 0xff     // element size of the byte shuffle, 0: none
+#define CODEC_FILTER_DELTA 0x100      // XOR with the previous frame
+#define CODEC_FILTER_REFERENCE 0x200  // the frame is the reference of the next one
+#define CODEC_PIPELINED 0x400         // the strips follow the header one by one, each after its size
+
+// Sent in front of the compressed pixels. The strips are compressed independently,
+// a strip with strip_sizes equal to its raw size is stored uncompressed.
+typedef struct PixelCodecHeader {
+	int codec;
+	int strips;
+	int rows;
+	int flags;
+	unsigned long long raw_size; // size of the pixels
+	unsigned long long size;     // size of the compressed strips
+	unsigned int strip_sizes[CODEC_MAX_STRIPS];
+} PixelCodecHeader;
+
+// Lossless CPU compression of the pixels for builds without GPUJPEG, the frame is split
+// into horizontal strips that are compressed on parallel threads. The strips can be
+// filtered first: the bytes of the channels are shuffled into planes (the exponents of
+// floats end up next to each other) and XORed with the previous frame, which gives the
+// entropy coder of zstd long runs of equal bytes. The header tells the decoder the filter.
+class BRAAS_HPC_EXPORT_DLL PixelCodec {
+protected:
+	int m_codec = CODEC_NONE;
+	int m_level = 1;
+	bool m_shuffle = false;
+	bool m_delta = false;
+
+	PixelCodecHeader m_header;
+	std::vector<char> m_data; // compressed strips, packed
+	size_t m_slots[CODEC_MAX_STRIPS + 1]; // encoder: offsets of the strips in m_data before packing
+	const char* m_pixels = NULL; // encoder: the pixels of begin_encode
+
+	std::vector<char> m_filtered; // the filtered pixels of all strips
+	std::vector<char> m_reference; // the previous frame for the XOR
+
+	// zstd contexts, one per strip
+	std::vector<void*> m_compress_contexts;
+	std::vector<void*> m_decompress_contexts;
+
+public:
+	PixelCodec();
+	~PixelCodec();
+
+	static bool is_supported(int codec);
+
+	// false if the codec is not compiled in
+	bool set_codec(int codec);
+	int get_codec() { return m_codec; }
+
+	// zstd compression level, LZ4 has no levels
+	void set_level(int level) { m_level = level; }
+	int get_level() { return m_level; }
+
+	void set_shuffle(bool shuffle) { m_shuffle = shuffle; }
+	bool is_shuffle() { return m_shuffle; }
+	void set_delta(bool delta) { m_delta = delta; reset(); }
+	bool is_delta() { return m_delta; }
+
+	// the next frame is not XORed, e.g. for a decoder that did not get the previous one
+	void reset() { m_reference.clear(); }
+
+	// compresses size bytes of pixels with rows lines of channels of channel_size bytes, the
+	// result is get_header() and get_data(); only frames (not tiles of them) use the delta
+	bool encode(const char* pixels, size_t size, int rows, int channel_size, bool frame);
+
+	// encode in stages: the header of begin_encode (without the strip sizes when pipelined)
+	// can be sent before the strips, encode_strip can run in parallel, get_strip_data and
+	// get_header().strip_sizes give a strip that is encoded; the pixels must stay valid
+	bool begin_encode(const char* pixels, size_t size, int rows, int channel_size, bool frame, bool pipelined);
+	bool encode_strip(int strip);
+	char* get_strip_data(int strip);
+
+	PixelCodecHeader& get_header() { return m_header; }
+	char* get_data() { return m_data.data(); }
+	size_t get_size() { return (size_t)m_header.size; }
+
+	// buffer for the compressed strips announced by header, NULL if the header is invalid
+	char* prepare_decode(const PixelCodecHeader& header);
+	bool decode(char* pixels, size_t size);
+
+	// pipelined: the buffer for strip of size bytes (NULL if invalid), decode_strip can run
+	// in parallel once its strip is received, reset() after a failed one
+	char* prepare_decode_strip(int strip, size_t size);
+	bool decode_strip(char* pixels, int strip);
+
+	static bool is_valid_flags(const PixelCodecHeader& header);
+	static int get_element_size(const PixelCodecHeader& header);
+
+protected:
+	void get_strip(const PixelCodecHeader& header, int strip, size_t& offset, size_t& size);
+	size_t compress_bound(size_t size);
+	size_t compress_strip(int strip, char* destination, size_t capacity, const char* source, size_t size);
+	bool decompress_strip(int strip, char* destination, size_t size, const char* source, size_t compressed_size);
+	bool decode_strip(char* pixels, int strip, const char* source);
+	void free_contexts();
+};
+
+#endif
@@ -0,0 +1,1800 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_color.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define COLOR_X86
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  define COLOR_NEON
+#  include <arm_neon.h>
+#endif
+
+// the SIMD kernels are compiled for their instruction set only, the rest of the
+// library keeps the baseline flags
+#if defined(COLOR_X86) && (defined(__GNUC__) || defined(__clang__))
+#  define COLOR_TARGET_SSE41 __attribute__((target("sse4.1")))
+#  define COLOR_TARGET_SSE41_F16C __attribute__((target("sse4.1,avx,f16c")))
+#  define COLOR_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#  define COLOR_TARGET_AVX512 __attribute__((target("avx512f,avx2,f16c")))
+#else
+#  define COLOR_TARGET_SSE41
+#  define COLOR_TARGET_SSE41_F16C
+#  define COLOR_TARGET_AVX2
+#  define COLOR_TARGET_AVX512
+#endif
+
+typedef unsigned char uchar;
+
+// Every kernel converts whole blocks of pixels and returns the number of pixels (values
+// for the half conversion) done, the scalar code converts the rest.
+typedef struct ColorKernels {
+	int isa;
+	int (*rgba_to_yuv_rows)(const uchar* s0, const uchar* s1, uchar* y0, uchar* y1, uchar* u, uchar* v, int width);
+	int (*yuv_to_rgba_row)(const uchar* y, const uchar* u, const uchar* v, uchar* dst, int width);
+	int (*rgba_to_half)(unsigned short* dst, const uchar* src, int count);
+	int (*float_to_half)(unsigned short* dst, const float* src, int count);
+	int (*half_to_float)(float* dst, const unsigned short* src, int count);
+	int (*rgba_to_rgb)(uchar* dst, const uchar* src, int count, int channel_size);
+	int (*rgb_to_rgba)(uchar* dst, const uchar* src, int count, int channel_size, unsigned int alpha);
+	size_t (*shuffle)(uchar* dst, const uchar* src, const uchar* reference, size_t count, int element_size);
+	size_t (*unshuffle)(uchar* dst, const uchar* src, const uchar* reference, size_t count, int element_size);
+} ColorKernels;
+
+// scale of the half conversion, the table and the kernels multiply by the same float
+static const float g_color_half_scale = 1.0f / 255.0f;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// scalar reference
+
+static inline uchar color_clip(int value)
+{
+	return (uchar)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+static inline uchar color_luma(const uchar* p)
+{
+	return (uchar)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+}
+
+// two rows from pixel begin, the chroma of a 2x2 block is taken from its rounded mean
+static void rgba_to_yuv_rows_scalar(
+	const uchar* s0, const uchar* s1, uchar* y0, uchar* y1, uchar* u, uchar* v, int begin, int width)
+{
+	int x = begin;
+	for (; x + 1 < width; x += 2) {
+		const uchar* a = s0 + x * 4;
+		const uchar* b = s1 + x * 4;
+
+		y0[x] = color_luma(a);
+		y0[x + 1] = color_luma(a + 4);
+		y1[x] = color_luma(b);
+		y1[x + 1] = color_luma(b + 4);
+
+		int r = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+		int g = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+		int bl = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+
+		u[x / 2] = (uchar)(((-38 * r - 74 * g + 112 * bl + 128) >> 8) + 128);
+		v[x / 2] = (uchar)(((112 * r - 94 * g - 18 * bl + 128) >> 8) + 128);
+	}
+
+	// odd width, the last column has no chroma
+	if (x < width) {
+		y0[x] = color_luma(s0 + x * 4);
+		y1[x] = color_luma(s1 + x * 4);
+	}
+}
+
+static void rgba_to_luma_row_scalar(const uchar* source, uchar* y, int width)
+{
+	for (int x = 0; x < width; x++) {
+		y[x] = color_luma(source + x * 4);
+	}
+}
+
+static inline void color_yuv_to_rgba(uchar* dst, int Y, int U, int V)
+{
+	int C = Y - 16;
+	int D = U - 128;
+	int E = V - 128;
+
+	dst[0] = color_clip((298 * C + 409 * E + 128) >> 8);
+	dst[1] = color_clip((298 * C - 100 * D - 208 * E + 128) >> 8);
+	dst[2] = color_clip((298 * C + 516 * D + 128) >> 8);
+	dst[3] = 255;
+}
+
+// one row from pixel begin, an odd last column reuses the last chroma column
+static void yuv_to_rgba_row_scalar(
+	const uchar* y, const uchar* u, const uchar* v, uchar* dst, int begin, int width, int chroma_width)
+{
+	int end = (width < chroma_width * 2) ? width : chroma_width * 2;
+	int x = begin;
+	for (; x < end; x++) {
+		color_yuv_to_rgba(dst + x * 4, y[x], u[x / 2], v[x / 2]);
+	}
+	for (; x < width; x++) {
+		color_yuv_to_rgba(dst + x * 4, y[x], u[chroma_width - 1], v[chroma_width - 1]);
+	}
+}
+
+// float to half with round to nearest even like F16C: overflow to inf, denormal halfs,
+// nan stays nan (quiet)
+static inline unsigned short color_float_to_half_value(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int abs = bits & 0x7FFFFFFF;
+
+	if (abs >= 0x7F800000)
+		return (unsigned short)(sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 | ((abs >> 13) & 0x3FF) : 0));
+
+	// 65520 and above round to inf
+	if (abs >= 0x477FF000)
+		return (unsigned short)(sign | 0x7C00);
+
+	unsigned int half, rest, halfway;
+	if (abs < 0x38800000) {
+		// below the smallest normal half, half of the smallest denormal rounds to 0
+		if (abs <= 0x33000000)
+			return (unsigned short)sign;
+
+		unsigned int mantissa = (abs & 0x7FFFFF) | 0x800000;
+		int shift = 126 - (int)(abs >> 23);
+		half = mantissa >> shift;
+		rest = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else {
+		half = (abs >> 13) - ((127 - 15) << 10);
+		rest = abs & 0x1FFF;
+		halfway = 0x1000;
+	}
+
+	if (rest > halfway || (rest == halfway && (half & 1))) {
+		half++;
+	}
+
+	return (unsigned short)(sign | half);
+}
+
+static inline float color_half_to_float_value(unsigned short value)
+{
+	unsigned int sign = (unsigned int)(value & 0x8000) << 16;
+	unsigned int exponent = (value >> 10) & 0x1F;
+	unsigned int mantissa = value & 0x3FF;
+	unsigned int bits;
+
+	if (exponent == 0x1F) {
+		bits = sign | 0x7F800000 | (mantissa ? 0x400000 | (mantissa << 13) : 0);
+	}
+	else if (exponent == 0) {
+		if (mantissa == 0) {
+			bits = sign;
+		}
+		else {
+			// denormal half, a normal float
+			exponent = 127 - 14;
+			while (!(mantissa & 0x400)) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else {
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static const unsigned short* color_half_table()
+{
+	static unsigned short table[256];
+	static bool initialized = [] {
+		for (int i = 0; i < 256; i++) {
+			table[i] = color_float_to_half_value((float)i * g_color_half_scale);
+		}
+		return true;
+	}();
+	(void)initialized;
+
+	return table;
+}
+
+static void rgba_to_half_scalar(unsigned short* dst, const uchar* src, int begin, int count)
+{
+	const unsigned short* table = color_half_table();
+	for (int i = begin; i < count; i++) {
+		dst[i] = table[src[i]];
+	}
+}
+
+static void float_to_half_scalar(unsigned short* dst, const float* src, int begin, int count)
+{
+	for (int i = begin; i < count; i++) {
+		dst[i] = color_float_to_half_value(src[i]);
+	}
+}
+
+static void half_to_float_scalar(float* dst, const unsigned short* src, int begin, int count)
+{
+	for (int i = begin; i < count; i++) {
+		dst[i] = color_half_to_float_value(src[i]);
+	}
+}
+
+template<typename T>
+static void rgba_to_rgb_type(T* dst, const T* src, int begin, int count)
+{
+	for (int i = begin; i < count; i++) {
+		dst[i * 3 + 0] = src[i * 4 + 0];
+		dst[i * 3 + 1] = src[i * 4 + 1];
+		dst[i * 3 + 2] = src[i * 4 + 2];
+	}
+}
+
+template<typename T>
+static void rgb_to_rgba_type(T* dst, const T* src, int begin, int count, T alpha)
+{
+	for (int i = begin; i < count; i++) {
+		dst[i * 4 + 0] = src[i * 3 + 0];
+		dst[i * 4 + 1] = src[i * 3 + 1];
+		dst[i * 4 + 2] = src[i * 3 + 2];
+		dst[i * 4 + 3] = alpha;
+	}
+}
+
+// the channels are moved as integers of their size, float alpha comes as its bits
+static void rgba_to_rgb_scalar(uchar* dst, const uchar* src, int begin, int count, int channel_size)
+{
+	if (channel_size == 4)
+		rgba_to_rgb_type((unsigned int*)dst, (const unsigned int*)src, begin, count);
+	else if (channel_size == 2)
+		rgba_to_rgb_type((unsigned short*)dst, (const unsigned short*)src, begin, count);
+	else
+		rgba_to_rgb_type(dst, src, begin, count);
+}
+
+static void rgb_to_rgba_scalar(uchar* dst, const uchar* src, int begin, int count, int channel_size, unsigned int alpha)
+{
+	if (channel_size == 4)
+		rgb_to_rgba_type((unsigned int*)dst, (const unsigned int*)src, begin, count, alpha);
+	else if (channel_size == 2)
+		rgb_to_rgba_type((unsigned short*)dst, (const unsigned short*)src, begin, count, (unsigned short)alpha);
+	else
+		rgb_to_rgba_type(dst, src, begin, count, (uchar)alpha);
+}
+
+// byte b of element i is byte i of plane b, planes of count bytes
+static void shuffle_scalar(uchar* dst, const uchar* src, const uchar* reference, size_t begin, size_t count, int element_size)
+{
+	for (size_t i = begin; i < count; i++) {
+		for (int b = 0; b < element_size; b++) {
+			uchar value = src[i * element_size + b];
+			if (reference)
+				value ^= reference[i * element_size + b];
+			dst[b * count + i] = value;
+		}
+	}
+}
+
+static void unshuffle_scalar(uchar* dst, const uchar* src, const uchar* reference, size_t begin, size_t count, int element_size)
+{
+	for (size_t i = begin; i < count; i++) {
+		for (int b = 0; b < element_size; b++) {
+			uchar value = src[b * count + i];
+			if (reference)
+				value ^= reference[i * element_size + b];
+			dst[i * element_size + b] = value;
+		}
+	}
+}
+
+static int rgba_to_yuv_rows_none(const uchar*, const uchar*, uchar*, uchar*, uchar*, uchar*, int)
+{
+	return 0;
+}
+
+static int yuv_to_rgba_row_none(const uchar*, const uchar*, const uchar*, uchar*, int)
+{
+	return 0;
+}
+
+static int rgba_to_half_none(unsigned short*, const uchar*, int)
+{
+	return 0;
+}
+
+static int float_to_half_none(unsigned short*, const float*, int)
+{
+	return 0;
+}
+
+static int half_to_float_none(float*, const unsigned short*, int)
+{
+	return 0;
+}
+
+static int rgba_to_rgb_none(uchar*, const uchar*, int, int)
+{
+	return 0;
+}
+
+static int rgb_to_rgba_none(uchar*, const uchar*, int, int, unsigned int)
+{
+	return 0;
+}
+
+static size_t shuffle_none(uchar*, const uchar*, const uchar*, size_t, int)
+{
+	return 0;
+}
+
+// byte shuffles of 16 bytes of RGBA to 12 bytes of RGB and back, -1 (0x80) gives a zero
+static void color_rgb_pack_mask(uchar mask[16], int channel_size)
+{
+	int rgb = 3 * channel_size;
+	for (int j = 0; j < 16; j++) {
+		mask[j] = j < 12 ? (uchar)(j / rgb * 4 * channel_size + j % rgb) : 0x80;
+	}
+}
+
+static void color_rgb_unpack_mask(uchar mask[16], uchar alpha[16], int channel_size, unsigned int alpha_bits)
+{
+	int rgba = 4 * channel_size;
+	for (int j = 0; j < 16; j++) {
+		int k = j % rgba;
+		mask[j] = k < 3 * channel_size ? (uchar)(j / rgba * 3 * channel_size + k) : 0x80;
+	}
+
+	// the alpha channels of black pixels, in the byte order of the machine
+	const uchar black[12] = { 0 };
+	rgb_to_rgba_scalar(alpha, black, 0, 4 / channel_size, channel_size, alpha_bits);
+}
+
+#ifdef COLOR_X86
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// SSE4.1, 4 pixels per register
+
+COLOR_TARGET_SSE41
+static inline __m128i color_luma_sse41(__m128i p)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	__m128i r = _mm_and_si128(p, mask);
+	__m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+	__m128i b = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+
+	// + 16 << 8 adds the offset of 16 before the shift
+	__m128i s = _mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(66)), _mm_mullo_epi32(g, _mm_set1_epi32(129)));
+	s = _mm_add_epi32(s, _mm_mullo_epi32(b, _mm_set1_epi32(25)));
+	return _mm_srli_epi32(_mm_add_epi32(s, _mm_set1_epi32(128 + (16 << 8))), 8);
+}
+
+// sum of a channel over the 2x2 blocks of pixels 0-3 (a0, a1) and 4-7 (b0, b1), rounded mean
+COLOR_TARGET_SSE41
+static inline __m128i color_block_mean_sse41(__m128i a0, __m128i a1, __m128i b0, __m128i b1, int shift)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	__m128i a = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(a0, shift), mask), _mm_and_si128(_mm_srli_epi32(a1, shift), mask));
+	__m128i b = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(b0, shift), mask), _mm_and_si128(_mm_srli_epi32(b1, shift), mask));
+	return _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(a, b), _mm_set1_epi32(2)), 2);
+}
+
+COLOR_TARGET_SSE41
+static inline __m128i color_chroma_sse41(__m128i r, __m128i g, __m128i b, int kr, int kg, int kb)
+{
+	__m128i s = _mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(kr)), _mm_mullo_epi32(g, _mm_set1_epi32(kg)));
+	s = _mm_add_epi32(s, _mm_mullo_epi32(b, _mm_set1_epi32(kb)));
+	return _mm_srli_epi32(_mm_add_epi32(s, _mm_set1_epi32(128 + (128 << 8))), 8);
+}
+
+COLOR_TARGET_SSE41
+static int rgba_to_yuv_rows_sse41(const uchar* s0, const uchar* s1, uchar* y0, uchar* y1, uchar* u, uchar* v, int width)
+{
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m128i p00 = _mm_loadu_si128((const __m128i*)(s0 + x * 4));
+		__m128i p01 = _mm_loadu_si128((const __m128i*)(s0 + x * 4 + 16));
+		__m128i p10 = _mm_loadu_si128((const __m128i*)(s1 + x * 4));
+		__m128i p11 = _mm_loadu_si128((const __m128i*)(s1 + x * 4 + 16));
+
+		__m128i luma = _mm_packus_epi16(_mm_packus_epi32(color_luma_sse41(p00), color_luma_sse41(p01)),
+			_mm_packus_epi32(color_luma_sse41(p10), color_luma_sse41(p11)));
+		_mm_storel_epi64((__m128i*)(y0 + x), luma);
+		_mm_storel_epi64((__m128i*)(y1 + x), _mm_srli_si128(luma, 8));
+
+		__m128i r = color_block_mean_sse41(p00, p10, p01, p11, 0);
+		__m128i g = color_block_mean_sse41(p00, p10, p01, p11, 8);
+		__m128i b = color_block_mean_sse41(p00, p10, p01, p11, 16);
+
+		__m128i chroma = _mm_packus_epi16(
+			_mm_packus_epi32(color_chroma_sse41(r, g, b, -38, -74, 112), color_chroma_sse41(r, g, b, 112, -94, -18)),
+			_mm_setzero_si128());
+		int uu = _mm_cvtsi128_si32(chroma);
+		int vv = _mm_cvtsi128_si32(_mm_srli_si128(chroma, 4));
+		memcpy(u + x / 2, &uu, 4);
+		memcpy(v + x / 2, &vv, 4);
+	}
+
+	return x;
+}
+
+// RGBA of 4 pixels from C = Y - 16, D = U - 128 and E = V - 128
+COLOR_TARGET_SSE41
+static inline __m128i color_rgba_sse41(__m128i C, __m128i D, __m128i E)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max = _mm_set1_epi32(255);
+	__m128i c = _mm_add_epi32(_mm_mullo_epi32(C, _mm_set1_epi32(298)), _mm_set1_epi32(128));
+
+	__m128i r = _mm_srai_epi32(_mm_add_epi32(c, _mm_mullo_epi32(E, _mm_set1_epi32(409))), 8);
+	__m128i g = _mm_srai_epi32(_mm_sub_epi32(c, _mm_add_epi32(_mm_mullo_epi32(D, _mm_set1_epi32(100)),
+		_mm_mullo_epi32(E, _mm_set1_epi32(208)))), 8);
+	__m128i b = _mm_srai_epi32(_mm_add_epi32(c, _mm_mullo_epi32(D, _mm_set1_epi32(516))), 8);
+
+	r = _mm_min_epi32(_mm_max_epi32(r, zero), max);
+	g = _mm_min_epi32(_mm_max_epi32(g, zero), max);
+	b = _mm_min_epi32(_mm_max_epi32(b, zero), max);
+
+	__m128i rgba = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+	rgba = _mm_or_si128(rgba, _mm_slli_epi32(b, 16));
+	return _mm_or_si128(rgba, _mm_set1_epi32((int)0xFF000000));
+}
+
+COLOR_TARGET_SSE41
+static int yuv_to_rgba_row_sse41(const uchar* y, const uchar* u, const uchar* v, uchar* dst, int width)
+{
+	const __m128i k16 = _mm_set1_epi32(16);
+	const __m128i k128 = _mm_set1_epi32(128);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		int uu, vv;
+		memcpy(&uu, u + x / 2, 4);
+		memcpy(&vv, v + x / 2, 4);
+
+		__m128i yv = _mm_loadl_epi64((const __m128i*)(y + x));
+		__m128i uv = _mm_cvtsi32_si128(uu);
+		__m128i vv8 = _mm_cvtsi32_si128(vv);
+		uv = _mm_unpacklo_epi8(uv, uv);
+		vv8 = _mm_unpacklo_epi8(vv8, vv8);
+
+		for (int i = 0; i < 2; i++) {
+			__m128i C = _mm_sub_epi32(_mm_cvtepu8_epi32(yv), k16);
+			__m128i D = _mm_sub_epi32(_mm_cvtepu8_epi32(uv), k128);
+			__m128i E = _mm_sub_epi32(_mm_cvtepu8_epi32(vv8), k128);
+			_mm_storeu_si128((__m128i*)(dst + (x + i * 4) * 4), color_rgba_sse41(C, D, E));
+
+			yv = _mm_srli_si128(yv, 4);
+			uv = _mm_srli_si128(uv, 4);
+			vv8 = _mm_srli_si128(vv8, 4);
+		}
+	}
+
+	return x;
+}
+
+COLOR_TARGET_SSE41_F16C
+static int rgba_to_half_f16c(unsigned short* dst, const uchar* src, int count)
+{
+	const __m128 scale = _mm_set1_ps(g_color_half_scale);
+
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+		for (int j = 0; j < 4; j++) {
+			__m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(p)), scale);
+			_mm_storel_epi64((__m128i*)(dst + i + j * 4), _mm_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+			p = _mm_srli_si128(p, 4);
+		}
+	}
+
+	return i;
+}
+
+COLOR_TARGET_SSE41_F16C
+static int float_to_half_f16c(unsigned short* dst, const float* src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i h0 = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		__m128i h1 = _mm_cvtps_ph(_mm_loadu_ps(src + i + 4), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi64(h0, h1));
+	}
+
+	return i;
+}
+
+COLOR_TARGET_SSE41_F16C
+static int half_to_float_f16c(float* dst, const unsigned short* src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_ps(dst + i, _mm_cvtph_ps(h));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtph_ps(_mm_srli_si128(h, 8)));
+	}
+
+	return i;
+}
+
+COLOR_TARGET_SSE41
+static int rgba_to_rgb_sse41(uchar* dst, const uchar* src, int count, int channel_size)
+{
+	uchar m[16];
+	color_rgb_pack_mask(m, channel_size);
+	const __m128i mask = _mm_loadu_si128((const __m128i*)m);
+
+	// 16 bytes to 12, the 4 bytes stored behind them are overwritten by the next store
+	size_t size = (size_t)count * 3 * channel_size;
+	int r = 0;
+	for (; (size_t)r * 12 + 16 <= size; r++) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + (size_t)r * 16));
+		_mm_storeu_si128((__m128i*)(dst + (size_t)r * 12), _mm_shuffle_epi8(p, mask));
+	}
+
+	return r * 4 / channel_size;
+}
+
+COLOR_TARGET_SSE41
+static int rgb_to_rgba_sse41(uchar* dst, const uchar* src, int count, int channel_size, unsigned int alpha)
+{
+	uchar m[16], a[16];
+	color_rgb_unpack_mask(m, a, channel_size, alpha);
+	const __m128i mask = _mm_loadu_si128((const __m128i*)m);
+	const __m128i alphas = _mm_loadu_si128((const __m128i*)a);
+
+	size_t size = (size_t)count * 3 * channel_size;
+	int r = 0;
+	for (; (size_t)r * 12 + 16 <= size; r++) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + (size_t)r * 12));
+		_mm_storeu_si128((__m128i*)(dst + (size_t)r * 16), _mm_or_si128(_mm_shuffle_epi8(p, mask), alphas));
+	}
+
+	return r * 4 / channel_size;
+}
+
+// 16 elements of 2 or 4 bytes per iteration, the planes are transposed by unpacks
+COLOR_TARGET_SSE41
+static size_t shuffle_sse41(uchar* dst, const uchar* src, const uchar* reference, size_t count, int element_size)
+{
+	size_t i = 0;
+	if (element_size == 4) {
+		const __m128i mask = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+		for (; i + 16 <= count; i += 16) {
+			__m128i p[4];
+			for (int j = 0; j < 4; j++) {
+				p[j] = _mm_loadu_si128((const __m128i*)(src + (i + j * 4) * 4));
+				if (reference)
+					p[j] = _mm_xor_si128(p[j], _mm_loadu_si128((const __m128i*)(reference + (i + j * 4) * 4)));
+				p[j] = _mm_shuffle_epi8(p[j], mask);
+			}
+			__m128i t0 = _mm_unpacklo_epi32(p[0], p[1]);
+			__m128i t1 = _mm_unpacklo_epi32(p[2], p[3]);
+			__m128i t2 = _mm_unpackhi_epi32(p[0], p[1]);
+			__m128i t3 = _mm_unpackhi_epi32(p[2], p[3]);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)(dst + count + i), _mm_unpackhi_epi64(t0, t1));
+			_mm_storeu_si128((__m128i*)(dst + 2 * count + i), _mm_unpacklo_epi64(t2, t3));
+			_mm_storeu_si128((__m128i*)(dst + 3 * count + i), _mm_unpackhi_epi64(t2, t3));
+		}
+	}
+	else if (element_size == 2) {
+		const __m128i mask = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+		for (; i + 16 <= count; i += 16) {
+			__m128i p[2];
+			for (int j = 0; j < 2; j++) {
+				p[j] = _mm_loadu_si128((const __m128i*)(src + (i + j * 8) * 2));
+				if (reference)
+					p[j] = _mm_xor_si128(p[j], _mm_loadu_si128((const __m128i*)(reference + (i + j * 8) * 2)));
+				p[j] = _mm_shuffle_epi8(p[j], mask);
+			}
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi64(p[0], p[1]));
+			_mm_storeu_si128((__m128i*)(dst + count + i), _mm_unpackhi_epi64(p[0], p[1]));
+		}
+	}
+
+	return i;
+}
+
+COLOR_TARGET_SSE41
+static size_t unshuffle_sse41(uchar* dst, const uchar* src, const uchar* reference, size_t count, int element_size)
+{
+	size_t i = 0;
+	if (element_size == 4) {
+		for (; i + 16 <= count; i += 16) {
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(src + count + i));
+			__m128i p2 = _mm_loadu_si128((const __m128i*)(src + 2 * count + i));
+			__m128i p3 = _mm_loadu_si128((const __m128i*)(src + 3 * count + i));
+			__m128i t0 = _mm_unpacklo_epi8(p0, p1);
+			__m128i t1 = _mm_unpackhi_epi8(p0, p1);
+			__m128i t2 = _mm_unpacklo_epi8(p2, p3);
+			__m128i t3 = _mm_unpackhi_epi8(p2, p3);
+			__m128i e[4] = { _mm_unpacklo_epi16(t0, t2), _mm_unpackhi_epi16(t0, t2),
+				_mm_unpacklo_epi16(t1, t3), _mm_unpackhi_epi16(t1, t3) };
+			for (int j = 0; j < 4; j++) {
+				if (reference)
+					e[j] = _mm_xor_si128(e[j], _mm_loadu_si128((const __m128i*)(reference + (i + j * 4) * 4)));
+				_mm_storeu_si128((__m128i*)(dst + (i + j * 4) * 4), e[j]);
+			}
+		}
+	}
+	else if (element_size == 2) {
+		for (; i + 16 <= count; i += 16) {
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(src + count + i));
+			__m128i e[2] = { _mm_unpacklo_epi8(p0, p1), _mm_unpackhi_epi8(p0, p1) };
+			for (int j = 0; j < 2; j++) {
+				if (reference)
+					e[j] = _mm_xor_si128(e[j], _mm_loadu_si128((const __m128i*)(reference + (i + j * 8) * 2)));
+				_mm_storeu_si128((__m128i*)(dst + (i + j * 8) * 2), e[j]);
+			}
+		}
+	}
+
+	return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// AVX2, 8 pixels per register
+
+COLOR_TARGET_AVX2
+static inline __m256i color_luma_avx2(__m256i p)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	__m256i r = _mm256_and_si256(p, mask);
+	__m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask);
+	__m256i b = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask);
+
+	__m256i s = _mm256_add_epi32(
+		_mm256_mullo_epi32(r, _mm256_set1_epi32(66)), _mm256_mullo_epi32(g, _mm256_set1_epi32(129)));
+	s = _mm256_add_epi32(s, _mm256_mullo_epi32(b, _mm256_set1_epi32(25)));
+	return _mm256_srli_epi32(_mm256_add_epi32(s, _mm256_set1_epi32(128 + (16 << 8))), 8);
+}
+
+// the horizontal add works on 128 bit lanes, the permute restores the order of the blocks
+COLOR_TARGET_AVX2
+static inline __m256i color_block_mean_avx2(__m256i a0, __m256i a1, __m256i b0, __m256i b1, int shift)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	__m256i a = _mm256_add_epi32(_mm256_and_si256(_mm256_srl_epi32(a0, count), mask),
+		_mm256_and_si256(_mm256_srl_epi32(a1, count), mask));
+	__m256i b = _mm256_add_epi32(_mm256_and_si256(_mm256_srl_epi32(b0, count), mask),
+		_mm256_and_si256(_mm256_srl_epi32(b1, count), mask));
+	__m256i sum = _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), 0xD8);
+	return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(2)), 2);
+}
+
+COLOR_TARGET_AVX2
+static inline __m256i color_chroma_avx2(__m256i r, __m256i g, __m256i b, int kr, int kg, int kb)
+{
+	__m256i s = _mm256_add_epi32(
+		_mm256_mullo_epi32(r, _mm256_set1_epi32(kr)), _mm256_mullo_epi32(g, _mm256_set1_epi32(kg)));
+	s = _mm256_add_epi32(s, _mm256_mullo_epi32(b, _mm256_set1_epi32(kb)));
+	return _mm256_srli_epi32(_mm256_add_epi32(s, _mm256_set1_epi32(128 + (128 << 8))), 8);
+}
+
+// bytes of a0 a1 (low 128 bits) and b0 b1 (high 128 bits), 8 values each
+COLOR_TARGET_AVX2
+static inline __m256i color_pack_avx2(__m256i a0, __m256i a1, __m256i b0, __m256i b1)
+{
+	__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(a0, a1), _mm256_packus_epi32(b0, b1));
+	return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+COLOR_TARGET_AVX2
+static int rgba_to_yuv_rows_avx2(const uchar* s0, const uchar* s1, uchar* y0, uchar* y1, uchar* u, uchar* v, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m256i p00 = _mm256_loadu_si256((const __m256i*)(s0 + x * 4));
+		__m256i p01 = _mm256_loadu_si256((const __m256i*)(s0 + x * 4 + 32));
+		__m256i p10 = _mm256_loadu_si256((const __m256i*)(s1 + x * 4));
+		__m256i p11 = _mm256_loadu_si256((const __m256i*)(s1 + x * 4 + 32));
+
+		__m256i luma = color_pack_avx2(
+			color_luma_avx2(p00), color_luma_avx2(p01), color_luma_avx2(p10), color_luma_avx2(p11));
+		_mm_storeu_si128((__m128i*)(y0 + x), _mm256_castsi256_si128(luma));
+		_mm_storeu_si128((__m128i*)(y1 + x), _mm256_extracti128_si256(luma, 1));
+
+		__m256i r = color_block_mean_avx2(p00, p10, p01, p11, 0);
+		__m256i g = color_block_mean_avx2(p00, p10, p01, p11, 8);
+		__m256i b = color_block_mean_avx2(p00, p10, p01, p11, 16);
+
+		__m256i cu = color_chroma_avx2(r, g, b, -38, -74, 112);
+		__m256i cv = color_chroma_avx2(r, g, b, 112, -94, -18);
+		__m128i chroma = _mm256_castsi256_si128(color_pack_avx2(cu, cv, cu, cv));
+		_mm_storel_epi64((__m128i*)(u + x / 2), chroma);
+		_mm_storel_epi64((__m128i*)(v + x / 2), _mm_srli_si128(chroma, 8));
+	}
+
+	return x;
+}
+
+COLOR_TARGET_AVX2
+static inline __m256i color_rgba_avx2(__m256i C, __m256i D, __m256i E)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i max = _mm256_set1_epi32(255);
+	__m256i c = _mm256_add_epi32(_mm256_mullo_epi32(C, _mm256_set1_epi32(298)), _mm256_set1_epi32(128));
+
+	__m256i r = _mm256_srai_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(E, _mm256_set1_epi32(409))), 8);
+	__m256i g = _mm256_srai_epi32(_mm256_sub_epi32(c, _mm256_add_epi32(_mm256_mullo_epi32(D, _mm256_set1_epi32(100)),
+		_mm256_mullo_epi32(E, _mm256_set1_epi32(208)))), 8);
+	__m256i b = _mm256_srai_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(D, _mm256_set1_epi32(516))), 8);
+
+	r = _mm256_min_epi32(_mm256_max_epi32(r, zero), max);
+	g = _mm256_min_epi32(_mm256_max_epi32(g, zero), max);
+	b = _mm256_min_epi32(_mm256_max_epi32(b, zero), max);
+
+	__m256i rgba = _mm256_or_si256(r, _mm256_slli_epi32(g, 8));
+	rgba = _mm256_or_si256(rgba, _mm256_slli_epi32(b, 16));
+	return _mm256_or_si256(rgba, _mm256_set1_epi32((int)0xFF000000));
+}
+
+COLOR_TARGET_AVX2
+static int yuv_to_rgba_row_avx2(const uchar* y, const uchar* u, const uchar* v, uchar* dst, int width)
+{
+	const __m256i k16 = _mm256_set1_epi32(16);
+	const __m256i k128 = _mm256_set1_epi32(128);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		__m128i yv = _mm_loadu_si128((const __m128i*)(y + x));
+		__m128i uv = _mm_loadl_epi64((const __m128i*)(u + x / 2));
+		__m128i vv = _mm_loadl_epi64((const __m128i*)(v + x / 2));
+		uv = _mm_unpacklo_epi8(uv, uv);
+		vv = _mm_unpacklo_epi8(vv, vv);
+
+		for (int i = 0; i < 2; i++) {
+			__m256i C = _mm256_sub_epi32(_mm256_cvtepu8_epi32(yv), k16);
+			__m256i D = _mm256_sub_epi32(_mm256_cvtepu8_epi32(uv), k128);
+			__m256i E = _mm256_sub_epi32(_mm256_cvtepu8_epi32(vv), k128);
+			_mm256_storeu_si256((__m256i*)(dst + (x + i * 8) * 4), color_rgba_avx2(C, D, E));
+
+			yv = _mm_srli_si128(yv, 8);
+			uv = _mm_srli_si128(uv, 8);
+			vv = _mm_srli_si128(vv, 8);
+		}
+	}
+
+	return x;
+}
+
+COLOR_TARGET_AVX2
+static int rgba_to_half_avx2(unsigned short* dst, const uchar* src, int count)
+{
+	const __m256 scale = _mm256_set1_ps(g_color_half_scale);
+
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+		__m256 f0 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p)), scale);
+		__m256 f1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(p, 8))), scale);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(f0, _MM_FROUND_TO_NEAREST_INT));
+		_mm_storeu_si128((__m128i*)(dst + i + 8), _mm256_cvtps_ph(f1, _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	return i;
+}
+
+COLOR_TARGET_AVX2
+static int float_to_half_avx2(unsigned short* dst, const float* src, int count)
+{
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+		_mm_storeu_si128((__m128i*)(dst + i + 8), _mm256_cvtps_ph(_mm256_loadu_ps(src + i + 8), _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	return i;
+}
+
+COLOR_TARGET_AVX2
+static int half_to_float_avx2(float* dst, const unsigned short* src, int count)
+{
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+		_mm256_storeu_ps(dst + i + 8, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i + 8))));
+	}
+
+	return i;
+}
+
+COLOR_TARGET_AVX2
+static int rgba_to_rgb_avx2(uchar* dst, const uchar* src, int count, int channel_size)
+{
+	uchar m[16];
+	color_rgb_pack_mask(m, channel_size);
+	const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)m));
+	const __m256i order = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+	// 12 bytes of each lane joined to 24
+	size_t size = (size_t)count * 3 * channel_size;
+	int r = 0;
+	for (; (size_t)r * 24 + 32 <= size; r++) {
+		__m256i p = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + (size_t)r * 32)), mask);
+		_mm256_storeu_si256((__m256i*)(dst + (size_t)r * 24), _mm256_permutevar8x32_epi32(p, order));
+	}
+
+	return r * 8 / channel_size;
+}
+
+COLOR_TARGET_AVX2
+static int rgb_to_rgba_avx2(uchar* dst, const uchar* src, int count, int channel_size, unsigned int alpha)
+{
+	uchar m[16], a[16];
+	color_rgb_unpack_mask(m, a, channel_size, alpha);
+	const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)m));
+	const __m256i alphas = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)a));
+	const __m256i order = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+
+	size_t size = (size_t)count * 3 * channel_size;
+	int r = 0;
+	for (; (size_t)r * 24 + 32 <= size; r++) {
+		__m256i p = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(src + (size_t)r * 24)), order);
+		_mm256_storeu_si256((__m256i*)(dst + (size_t)r * 32), _mm256_or_si256(_mm256_shuffle_epi8(p, mask), alphas));
+	}
+
+	return r * 8 / channel_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// AVX-512, 16 pixels per register
+
+COLOR_TARGET_AVX512
+static inline __m512i color_luma_avx512(__m512i p)
+{
+	const __m512i mask = _mm512_set1_epi32(0xFF);
+	__m512i r = _mm512_and_si512(p, mask);
+	__m512i g = _mm512_and_si512(_mm512_srli_epi32(p, 8), mask);
+	__m512i b = _mm512_and_si512(_mm512_srli_epi32(p, 16), mask);
+
+	__m512i s = _mm512_add_epi32(
+		_mm512_mullo_epi32(r, _mm512_set1_epi32(66)), _mm512_mullo_epi32(g, _mm512_set1_epi32(129)));
+	s = _mm512_add_epi32(s, _mm512_mullo_epi32(b, _mm512_set1_epi32(25)));
+	return _mm512_srli_epi32(_mm512_add_epi32(s, _mm512_set1_epi32(128 + (16 << 8))), 8);
+}
+
+// the mean of a block ends up in the even 32 bit elements, the odd ones are ignored
+COLOR_TARGET_AVX512
+static inline __m512i color_block_mean_avx512(__m512i a0, __m512i a1, int shift)
+{
+	const __m512i mask = _mm512_set1_epi32(0xFF);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	__m512i a = _mm512_add_epi32(_mm512_and_si512(_mm512_srl_epi32(a0, count), mask),
+		_mm512_and_si512(_mm512_srl_epi32(a1, count), mask));
+	a = _mm512_add_epi32(a, _mm512_srli_epi64(a, 32));
+	return _mm512_srli_epi32(_mm512_add_epi32(a, _mm512_set1_epi32(2)), 2);
+}
+
+COLOR_TARGET_AVX512
+static inline __m512i color_chroma_avx512(__m512i r, __m512i g, __m512i b, int kr, int kg, int kb)
+{
+	__m512i s = _mm512_add_epi32(
+		_mm512_mullo_epi32(r, _mm512_set1_epi32(kr)), _mm512_mullo_epi32(g, _mm512_set1_epi32(kg)));
+	s = _mm512_add_epi32(s, _mm512_mullo_epi32(b, _mm512_set1_epi32(kb)));
+	return _mm512_srli_epi32(_mm512_add_epi32(s, _mm512_set1_epi32(128 + (128 << 8))), 8);
+}
+
+COLOR_TARGET_AVX512
+static int rgba_to_yuv_rows_avx512(const uchar* s0, const uchar* s1, uchar* y0, uchar* y1, uchar* u, uchar* v, int width)
+{
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		for (int i = 0; i < 2; i++) {
+			int px = x + i * 16;
+			__m512i p0 = _mm512_loadu_si512((const void*)(s0 + px * 4));
+			__m512i p1 = _mm512_loadu_si512((const void*)(s1 + px * 4));
+
+			_mm_storeu_si128((__m128i*)(y0 + px), _mm512_cvtepi32_epi8(color_luma_avx512(p0)));
+			_mm_storeu_si128((__m128i*)(y1 + px), _mm512_cvtepi32_epi8(color_luma_avx512(p1)));
+
+			__m512i r = color_block_mean_avx512(p0, p1, 0);
+			__m512i g = color_block_mean_avx512(p0, p1, 8);
+			__m512i b = color_block_mean_avx512(p0, p1, 16);
+
+			// the low byte of every 64 bit element is the chroma of a block
+			_mm_storel_epi64((__m128i*)(u + px / 2), _mm512_cvtepi64_epi8(color_chroma_avx512(r, g, b, -38, -74, 112)));
+			_mm_storel_epi64((__m128i*)(v + px / 2), _mm512_cvtepi64_epi8(color_chroma_avx512(r, g, b, 112, -94, -18)));
+		}
+	}
+
+	return x;
+}
+
+COLOR_TARGET_AVX512
+static inline __m512i color_rgba_avx512(__m512i C, __m512i D, __m512i E)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i max = _mm512_set1_epi32(255);
+	__m512i c = _mm512_add_epi32(_mm512_mullo_epi32(C, _mm512_set1_epi32(298)), _mm512_set1_epi32(128));
+
+	__m512i r = _mm512_srai_epi32(_mm512_add_epi32(c, _mm512_mullo_epi32(E, _mm512_set1_epi32(409))), 8);
+	__m512i g = _mm512_srai_epi32(_mm512_sub_epi32(c, _mm512_add_epi32(_mm512_mullo_epi32(D, _mm512_set1_epi32(100)),
+		_mm512_mullo_epi32(E, _mm512_set1_epi32(208)))), 8);
+	__m512i b = _mm512_srai_epi32(_mm512_add_epi32(c, _mm512_mullo_epi32(D, _mm512_set1_epi32(516))), 8);
+
+	r = _mm512_min_epi32(_mm512_max_epi32(r, zero), max);
+	g = _mm512_min_epi32(_mm512_max_epi32(g, zero), max);
+	b = _mm512_min_epi32(_mm512_max_epi32(b, zero), max);
+
+	__m512i rgba = _mm512_or_si512(r, _mm512_slli_epi32(g, 8));
+	rgba = _mm512_or_si512(rgba, _mm512_slli_epi32(b, 16));
+	return _mm512_or_si512(rgba, _mm512_set1_epi32((int)0xFF000000));
+}
+
+COLOR_TARGET_AVX512
+static int yuv_to_rgba_row_avx512(const uchar* y, const uchar* u, const uchar* v, uchar* dst, int width)
+{
+	const __m512i k16 = _mm512_set1_epi32(16);
+	const __m512i k128 = _mm512_set1_epi32(128);
+
+	int x = 0;
+	for (; x + 32 <= width; x += 32) {
+		__m128i uv = _mm_loadu_si128((const __m128i*)(u + x / 2));
+		__m128i vv = _mm_loadu_si128((const __m128i*)(v + x / 2));
+
+		__m128i ys[2] = { _mm_loadu_si128((const __m128i*)(y + x)), _mm_loadu_si128((const __m128i*)(y + x + 16)) };
+		__m128i us[2] = { _mm_unpacklo_epi8(uv, uv), _mm_unpackhi_epi8(uv, uv) };
+		__m128i vs[2] = { _mm_unpacklo_epi8(vv, vv), _mm_unpackhi_epi8(vv, vv) };
+
+		for (int i = 0; i < 2; i++) {
+			__m512i C = _mm512_sub_epi32(_mm512_cvtepu8_epi32(ys[i]), k16);
+			__m512i D = _mm512_sub_epi32(_mm512_cvtepu8_epi32(us[i]), k128);
+			__m512i E = _mm512_sub_epi32(_mm512_cvtepu8_epi32(vs[i]), k128);
+			_mm512_storeu_si512((void*)(dst + (x + i * 16) * 4), color_rgba_avx512(C, D, E));
+		}
+	}
+
+	return x;
+}
+
+COLOR_TARGET_AVX512
+static int rgba_to_half_avx512(unsigned short* dst, const uchar* src, int count)
+{
+	const __m512 scale = _mm512_set1_ps(g_color_half_scale);
+
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		for (int j = 0; j < 2; j++) {
+			__m128i p = _mm_loadu_si128((const __m128i*)(src + i + j * 16));
+			__m512 f = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(p)), scale);
+			_mm256_storeu_si256((__m256i*)(dst + i + j * 16), _mm512_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+		}
+	}
+
+	return i;
+}
+
+COLOR_TARGET_AVX512
+static int float_to_half_avx512(unsigned short* dst, const float* src, int count)
+{
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+		_mm256_storeu_si256((__m256i*)(dst + i + 16), _mm512_cvtps_ph(_mm512_loadu_ps(src + i + 16), _MM_FROUND_TO_NEAREST_INT));
+	}
+
+	return i;
+}
+
+COLOR_TARGET_AVX512
+static int half_to_float_avx512(float* dst, const unsigned short* src, int count)
+{
+	int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		_mm512_storeu_ps(dst + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(src + i))));
+		_mm512_storeu_ps(dst + i + 16, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(src + i + 16))));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef COLOR_NEON
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// NEON, 16 pixels per iteration
+
+static inline uint8x16_t color_luma_neon(uint8x16x4_t p)
+{
+	uint16x8_t lo = vmull_u8(vget_low_u8(p.val[0]), vdup_n_u8(66));
+	lo = vmlal_u8(lo, vget_low_u8(p.val[1]), vdup_n_u8(129));
+	lo = vmlal_u8(lo, vget_low_u8(p.val[2]), vdup_n_u8(25));
+
+	uint16x8_t hi = vmull_u8(vget_high_u8(p.val[0]), vdup_n_u8(66));
+	hi = vmlal_u8(hi, vget_high_u8(p.val[1]), vdup_n_u8(129));
+	hi = vmlal_u8(hi, vget_high_u8(p.val[2]), vdup_n_u8(25));
+
+	// the rounding shift adds the 128
+	return vaddq_u8(vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)), vdupq_n_u8(16));
+}
+
+static inline int16x8_t color_block_mean_neon(uint8x16_t a, uint8x16_t b)
+{
+	return vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(a), vpaddlq_u8(b)), 2));
+}
+
+static inline uint8x8_t color_chroma_neon(int16x8_t r, int16x8_t g, int16x8_t b, short kr, short kg, short kb)
+{
+	int16x8_t s = vmulq_n_s16(r, kr);
+	s = vmlaq_n_s16(s, g, kg);
+	s = vmlaq_n_s16(s, b, kb);
+	return vqmovun_s16(vaddq_s16(vrshrq_n_s16(s, 8), vdupq_n_s16(128)));
+}
+
+static int rgba_to_yuv_rows_neon(const uchar* s0, const uchar* s1, uchar* y0, uchar* y1, uchar* u, uchar* v, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t a = vld4q_u8(s0 + x * 4);
+		uint8x16x4_t b = vld4q_u8(s1 + x * 4);
+
+		vst1q_u8(y0 + x, color_luma_neon(a));
+		vst1q_u8(y1 + x, color_luma_neon(b));
+
+		int16x8_t r = color_block_mean_neon(a.val[0], b.val[0]);
+		int16x8_t g = color_block_mean_neon(a.val[1], b.val[1]);
+		int16x8_t bl = color_block_mean_neon(a.val[2], b.val[2]);
+
+		vst1_u8(u + x / 2, color_chroma_neon(r, g, bl, -38, -74, 112));
+		vst1_u8(v + x / 2, color_chroma_neon(r, g, bl, 112, -94, -18));
+	}
+
+	return x;
+}
+
+// (k0 * a + k1 * b + k2 * c + 128) >> 8 clipped to [0, 255]
+static inline uint8x8_t color_channel_neon(int16x8_t a, int16x8_t b, int16x8_t c, short k0, short k1, short k2)
+{
+	int32x4_t lo = vmull_n_s16(vget_low_s16(a), k0);
+	lo = vmlal_n_s16(lo, vget_low_s16(b), k1);
+	lo = vmlal_n_s16(lo, vget_low_s16(c), k2);
+
+	int32x4_t hi = vmull_n_s16(vget_high_s16(a), k0);
+	hi = vmlal_n_s16(hi, vget_high_s16(b), k1);
+	hi = vmlal_n_s16(hi, vget_high_s16(c), k2);
+
+	return vqmovun_s16(vcombine_s16(vrshrn_n_s32(lo, 8), vrshrn_n_s32(hi, 8)));
+}
+
+static int yuv_to_rgba_row_neon(const uchar* y, const uchar* u, const uchar* v, uchar* dst, int width)
+{
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16_t yv = vld1q_u8(y + x);
+		uint8x8_t u8 = vld1_u8(u + x / 2);
+		uint8x8_t v8 = vld1_u8(v + x / 2);
+		uint8x8x2_t uz = vzip_u8(u8, u8);
+		uint8x8x2_t vz = vzip_u8(v8, v8);
+
+		uint8x16x4_t out;
+		out.val[3] = vdupq_n_u8(255);
+
+		uint8x8_t channels[3][2];
+		for (int i = 0; i < 2; i++) {
+			uint8x8_t yh = (i == 0) ? vget_low_u8(yv) : vget_high_u8(yv);
+			int16x8_t C = vreinterpretq_s16_u16(vsubl_u8(yh, vdup_n_u8(16)));
+			int16x8_t D = vreinterpretq_s16_u16(vsubl_u8(uz.val[i], vdup_n_u8(128)));
+			int16x8_t E = vreinterpretq_s16_u16(vsubl_u8(vz.val[i], vdup_n_u8(128)));
+
+			channels[0][i] = color_channel_neon(C, E, D, 298, 409, 0);
+			channels[1][i] = color_channel_neon(C, D, E, 298, -100, -208);
+			channels[2][i] = color_channel_neon(C, D, E, 298, 516, 0);
+		}
+
+		for (int c = 0; c < 3; c++) {
+			out.val[c] = vcombine_u8(channels[c][0], channels[c][1]);
+		}
+		vst4q_u8(dst + x * 4, out);
+	}
+
+	return x;
+}
+
+static int rgba_to_half_neon(unsigned short* dst, const uchar* src, int count)
+{
+	const float32x4_t scale = vdupq_n_f32(g_color_half_scale);
+
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t p = vld1q_u8(src + i);
+		uint16x8_t w[2] = { vmovl_u8(vget_low_u8(p)), vmovl_u8(vget_high_u8(p)) };
+		for (int j = 0; j < 4; j++) {
+			uint32x4_t q = (j % 2 == 0) ? vmovl_u16(vget_low_u16(w[j / 2])) : vmovl_u16(vget_high_u16(w[j / 2]));
+			float32x4_t f = vmulq_f32(vcvtq_f32_u32(q), scale);
+			vst1_u16(dst + i + j * 4, vreinterpret_u16_f16(vcvt_f16_f32(f)));
+		}
+	}
+
+	return i;
+}
+
+static int float_to_half_neon(unsigned short* dst, const float* src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+		vst1_u16(dst + i + 4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i + 4))));
+	}
+
+	return i;
+}
+
+static int half_to_float_neon(float* dst, const unsigned short* src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+		vst1q_f32(dst + i + 4, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i + 4))));
+	}
+
+	return i;
+}
+
+static int rgba_to_rgb_neon(uchar* dst, const uchar* src, int count, int channel_size)
+{
+	int i = 0;
+	if (channel_size == 4) {
+		for (; i + 4 <= count; i += 4) {
+			uint32x4x4_t p = vld4q_u32((const uint32_t*)src + (size_t)i * 4);
+			uint32x4x3_t q = { { p.val[0], p.val[1], p.val[2] } };
+			vst3q_u32((uint32_t*)dst + (size_t)i * 3, q);
+		}
+	}
+	else if (channel_size == 2) {
+		for (; i + 8 <= count; i += 8) {
+			uint16x8x4_t p = vld4q_u16((const uint16_t*)src + (size_t)i * 4);
+			uint16x8x3_t q = { { p.val[0], p.val[1], p.val[2] } };
+			vst3q_u16((uint16_t*)dst + (size_t)i * 3, q);
+		}
+	}
+	else {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t p = vld4q_u8(src + (size_t)i * 4);
+			uint8x16x3_t q = { { p.val[0], p.val[1], p.val[2] } };
+			vst3q_u8(dst + (size_t)i * 3, q);
+		}
+	}
+
+	return i;
+}
+
+static int rgb_to_rgba_neon(uchar* dst, const uchar* src, int count, int channel_size, unsigned int alpha)
+{
+	int i = 0;
+	if (channel_size == 4) {
+		const uint32x4_t a = vdupq_n_u32(alpha);
+		for (; i + 4 <= count; i += 4) {
+			uint32x4x3_t p = vld3q_u32((const uint32_t*)src + (size_t)i * 3);
+			uint32x4x4_t q = { { p.val[0], p.val[1], p.val[2], a } };
+			vst4q_u32((uint32_t*)dst + (size_t)i * 4, q);
+		}
+	}
+	else if (channel_size == 2) {
+		const uint16x8_t a = vdupq_n_u16((uint16_t)alpha);
+		for (; i + 8 <= count; i += 8) {
+			uint16x8x3_t p = vld3q_u16((const uint16_t*)src + (size_t)i * 3);
+			uint16x8x4_t q = { { p.val[0], p.val[1], p.val[2], a } };
+			vst4q_u16((uint16_t*)dst + (size_t)i * 4, q);
+		}
+	}
+	else {
+		const uint8x16_t a = vdupq_n_u8((uint8_t)alpha);
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x3_t p = vld3q_u8(src + (size_t)i * 3);
+			uint8x16x4_t q = { { p.val[0], p.val[1], p.val[2], a } };
+			vst4q_u8(dst + (size_t)i * 4, q);
+		}
+	}
+
+	return i;
+}
+
+static size_t shuffle_neon(uchar* dst, const uchar* src, const uchar* reference, size_t count, int element_size)
+{
+	size_t i = 0;
+	if (element_size == 4) {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t p = vld4q_u8(src + i * 4);
+			if (reference) {
+				uint8x16x4_t r = vld4q_u8(reference + i * 4);
+				for (int b = 0; b < 4; b++)
+					p.val[b] = veorq_u8(p.val[b], r.val[b]);
+			}
+			for (int b = 0; b < 4; b++)
+				vst1q_u8(dst + b * count + i, p.val[b]);
+		}
+	}
+	else if (element_size == 2) {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x2_t p = vld2q_u8(src + i * 2);
+			if (reference) {
+				uint8x16x2_t r = vld2q_u8(reference + i * 2);
+				for (int b = 0; b < 2; b++)
+					p.val[b] = veorq_u8(p.val[b], r.val[b]);
+			}
+			for (int b = 0; b < 2; b++)
+				vst1q_u8(dst + b * count + i, p.val[b]);
+		}
+	}
+
+	return i;
+}
+
+static size_t unshuffle_neon(uchar* dst, const uchar* src, const uchar* reference, size_t count, int element_size)
+{
+	size_t i = 0;
+	if (element_size == 4) {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t p;
+			for (int b = 0; b < 4; b++)
+				p.val[b] = vld1q_u8(src + b * count + i);
+			if (reference) {
+				uint8x16x4_t r = vld4q_u8(reference + i * 4);
+				for (int b = 0; b < 4; b++)
+					p.val[b] = veorq_u8(p.val[b], r.val[b]);
+			}
+			vst4q_u8(dst + i * 4, p);
+		}
+	}
+	else if (element_size == 2) {
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x2_t p;
+			for (int b = 0; b < 2; b++)
+				p.val[b] = vld1q_u8(src + b * count + i);
+			if (reference) {
+				uint8x16x2_t r = vld2q_u8(reference + i * 2);
+				for (int b = 0; b < 2; b++)
+					p.val[b] = veorq_u8(p.val[b], r.val[b]);
+			}
+			vst2q_u8(dst + i * 2, p);
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// dispatch
+
+typedef struct ColorCpu {
+	bool sse41 = false;
+	bool f16c = false;
+	bool avx2 = false;
+	bool avx512 = false;
+} ColorCpu;
+
+#ifdef COLOR_X86
+static void color_cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#  ifdef _MSC_VER
+	int info[4];
+	__cpuidex(info, leaf, subleaf);
+	for (int i = 0; i < 4; i++) {
+		regs[i] = (unsigned int)info[i];
+	}
+#  else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#  endif
+}
+
+// the registers the OS saves on a context switch
+static unsigned long long color_xgetbv()
+{
+#  ifdef _MSC_VER
+	return _xgetbv(0);
+#  else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#  endif
+}
+#endif
+
+static ColorCpu color_detect_cpu()
+{
+	ColorCpu cpu;
+
+#ifdef COLOR_X86
+	unsigned int regs[4];
+	color_cpuid(0, 0, regs);
+	unsigned int max_leaf = regs[0];
+
+	color_cpuid(1, 0, regs);
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	unsigned long long xcr0 = osxsave ? color_xgetbv() : 0;
+	bool ymm = avx && (xcr0 & 0x6) == 0x6;
+	bool zmm = ymm && (xcr0 & 0xE0) == 0xE0;
+
+	cpu.sse41 = (regs[2] & (1u << 19)) != 0;
+	cpu.f16c = ymm && (regs[2] & (1u << 29)) != 0;
+
+	if (max_leaf >= 7) {
+		color_cpuid(7, 0, regs);
+		cpu.avx2 = cpu.f16c && (regs[1] & (1u << 5)) != 0;
+		cpu.avx512 = cpu.avx2 && zmm && (regs[1] & (1u << 16)) != 0;
+	}
+#endif
+
+	return cpu;
+}
+
+static const ColorCpu& color_cpu()
+{
+	static ColorCpu cpu = color_detect_cpu();
+	return cpu;
+}
+
+static bool color_is_supported(int isa)
+{
+	const ColorCpu& cpu = color_cpu();
+
+	switch (isa) {
+	case COLOR_ISA_SCALAR:
+		return true;
+	case COLOR_ISA_SSE41:
+		return cpu.sse41;
+	case COLOR_ISA_AVX2:
+		return cpu.avx2;
+	case COLOR_ISA_AVX512:
+		return cpu.avx512;
+	case COLOR_ISA_NEON:
+#ifdef COLOR_NEON
+		return true;
+#else
+		return false;
+#endif
+	default:
+		return false;
+	}
+}
+
+static ColorKernels color_kernels_of(int isa)
+{
+	ColorKernels kernels = { COLOR_ISA_SCALAR, rgba_to_yuv_rows_none, yuv_to_rgba_row_none, rgba_to_half_none,
+		float_to_half_none, half_to_float_none, rgba_to_rgb_none, rgb_to_rgba_none, shuffle_none, shuffle_none };
+	if (!color_is_supported(isa))
+		return kernels;
+
+	kernels.isa = isa;
+
+	switch (isa) {
+#ifdef COLOR_X86
+	case COLOR_ISA_SSE41:
+		kernels.rgba_to_yuv_rows = rgba_to_yuv_rows_sse41;
+		kernels.yuv_to_rgba_row = yuv_to_rgba_row_sse41;
+		kernels.rgba_to_rgb = rgba_to_rgb_sse41;
+		kernels.rgb_to_rgba = rgb_to_rgba_sse41;
+		kernels.shuffle = shuffle_sse41;
+		kernels.unshuffle = unshuffle_sse41;
+		if (color_cpu().f16c) {
+			kernels.rgba_to_half = rgba_to_half_f16c;
+			kernels.float_to_half = float_to_half_f16c;
+			kernels.half_to_float = half_to_float_f16c;
+		}
+		break;
+	case COLOR_ISA_AVX2:
+		kernels.rgba_to_yuv_rows = rgba_to_yuv_rows_avx2;
+		kernels.yuv_to_rgba_row = yuv_to_rgba_row_avx2;
+		kernels.rgba_to_half = rgba_to_half_avx2;
+		kernels.float_to_half = float_to_half_avx2;
+		kernels.half_to_float = half_to_float_avx2;
+		kernels.rgba_to_rgb = rgba_to_rgb_avx2;
+		kernels.rgb_to_rgba = rgb_to_rgba_avx2;
+		// the plane transpose is bound by the stores, wider registers do not help
+		kernels.shuffle = shuffle_sse41;
+		kernels.unshuffle = unshuffle_sse41;
+		break;
+	case COLOR_ISA_AVX512:
+		kernels.rgba_to_yuv_rows = rgba_to_yuv_rows_avx512;
+		kernels.yuv_to_rgba_row = yuv_to_rgba_row_avx512;
+		kernels.rgba_to_half = rgba_to_half_avx512;
+		kernels.float_to_half = float_to_half_avx512;
+		kernels.half_to_float = half_to_float_avx512;
+		// byte shuffles need AVX-512BW, the AVX2 kernels are used
+		kernels.rgba_to_rgb = rgba_to_rgb_avx2;
+		kernels.rgb_to_rgba = rgb_to_rgba_avx2;
+		kernels.shuffle = shuffle_sse41;
+		kernels.unshuffle = unshuffle_sse41;
+		break;
+#endif
+#ifdef COLOR_NEON
+	case COLOR_ISA_NEON:
+		kernels.rgba_to_yuv_rows = rgba_to_yuv_rows_neon;
+		kernels.yuv_to_rgba_row = yuv_to_rgba_row_neon;
+		kernels.rgba_to_half = rgba_to_half_neon;
+		kernels.float_to_half = float_to_half_neon;
+		kernels.half_to_float = half_to_float_neon;
+		kernels.rgba_to_rgb = rgba_to_rgb_neon;
+		kernels.rgb_to_rgba = rgb_to_rgba_neon;
+		kernels.shuffle = shuffle_neon;
+		kernels.unshuffle = unshuffle_neon;
+		break;
+#endif
+	default:
+		break;
+	}
+
+	return kernels;
+}
+
+static const char* g_color_isa_names[] = { "scalar", "sse41", "avx2", "avx512", "neon" };
+
+static int color_select_isa()
+{
+	int best = COLOR_ISA_SCALAR;
+	for (int isa = COLOR_ISA_SSE41; isa <= COLOR_ISA_NEON; isa++) {
+		if (color_is_supported(isa)) {
+			best = isa;
+		}
+	}
+
+	const char* env = getenv("BRAAS_HPC_COLOR_ISA");
+	if (env != NULL) {
+		for (int isa = COLOR_ISA_SCALAR; isa <= COLOR_ISA_NEON; isa++) {
+			if (strcmp(env, g_color_isa_names[isa]) == 0) {
+				if (color_is_supported(isa)) {
+					return isa;
+				}
+				printf("BRAAS_HPC_COLOR_ISA: %s is not supported, using %s\n", env, g_color_isa_names[best]);
+				break;
+			}
+		}
+	}
+
+	return best;
+}
+
+static ColorKernels& color_kernels()
+{
+	static ColorKernels kernels = color_kernels_of(color_select_isa());
+	return kernels;
+}
+
+int color_get_isa()
+{
+	return color_kernels().isa;
+}
+
+const char* color_get_isa_name()
+{
+	return g_color_isa_names[color_kernels().isa];
+}
+
+int color_set_isa(int isa)
+{
+	if (color_is_supported(isa)) {
+		color_kernels() = color_kernels_of(isa);
+	}
+
+	return color_kernels().isa;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// conversions
+
+void color_rgba_to_yuv_i420(unsigned char* destination, const unsigned char* source, int height, int width)
+{
+	const ColorKernels& kernels = color_kernels();
+
+	size_t plane = (size_t)width * height;
+	int chroma_width = width / 2;
+	int chroma_height = height / 2;
+
+	uchar* dst_y = destination;
+	uchar* dst_u = destination + plane;
+	uchar* dst_v = destination + plane + plane / 4;
+
+#pragma omp parallel for
+	for (int cy = 0; cy < chroma_height; cy++) {
+		const uchar* s0 = source + (size_t)cy * 2 * width * 4;
+		const uchar* s1 = s0 + (size_t)width * 4;
+		uchar* y0 = dst_y + (size_t)cy * 2 * width;
+		uchar* y1 = y0 + width;
+		uchar* u = dst_u + (size_t)cy * chroma_width;
+		uchar* v = dst_v + (size_t)cy * chroma_width;
+
+		int x = kernels.rgba_to_yuv_rows(s0, s1, y0, y1, u, v, width);
+		rgba_to_yuv_rows_scalar(s0, s1, y0, y1, u, v, x, width);
+	}
+
+	// odd height, the last row has no chroma
+	if (height % 2 == 1) {
+		rgba_to_luma_row_scalar(source + (plane - width) * 4, dst_y + plane - width, width);
+	}
+}
+
+// the chroma rows of an odd last row or the neutral chroma of frames narrower than 2 pixels
+static void color_yuv_rows(const unsigned char* source, int height, int width, std::vector<uchar>& neutral,
+	const uchar*& src_u, const uchar*& src_v, int& chroma_width, int& chroma_height, size_t& chroma_stride)
+{
+	size_t plane = (size_t)width * height;
+	chroma_width = width / 2;
+	chroma_height = height / 2;
+	chroma_stride = chroma_width;
+	src_u = source + plane;
+	src_v = source + plane + plane / 4;
+
+	if (chroma_width < 1 || chroma_height < 1) {
+		chroma_width = width / 2 + 1;
+		chroma_height = 1;
+		chroma_stride = 0;
+		neutral.assign(chroma_width, 128);
+		src_u = neutral.data();
+		src_v = neutral.data();
+	}
+}
+
+static inline void color_yuv_to_rgba_row(const ColorKernels& kernels, const uchar* y, const uchar* u, const uchar* v,
+	uchar* dst, int width, int chroma_width)
+{
+	int x = kernels.yuv_to_rgba_row(y, u, v, dst, width);
+	yuv_to_rgba_row_scalar(y, u, v, dst, x, width, chroma_width);
+}
+
+void color_yuv_i420_to_rgba(unsigned char* destination, const unsigned char* source, int height, int width)
+{
+	const ColorKernels& kernels = color_kernels();
+
+	std::vector<uchar> neutral;
+	const uchar *src_u, *src_v;
+	int chroma_width, chroma_height;
+	size_t chroma_stride;
+	color_yuv_rows(source, height, width, neutral, src_u, src_v, chroma_width, chroma_height, chroma_stride);
+
+#pragma omp parallel for
+	for (int y = 0; y < height; y++) {
+		int cy = (y / 2 < chroma_height) ? y / 2 : chroma_height - 1;
+		color_yuv_to_rgba_row(kernels,
+			source + (size_t)y * width,
+			src_u + cy * chroma_stride,
+			src_v + cy * chroma_stride,
+			destination + (size_t)y * width * 4,
+			width,
+			chroma_width);
+	}
+}
+
+void color_yuv_i420_to_rgba_half(unsigned short* destination, const unsigned char* source, int height, int width)
+{
+	const ColorKernels& kernels = color_kernels();
+
+	std::vector<uchar> neutral;
+	const uchar *src_u, *src_v;
+	int chroma_width, chroma_height;
+	size_t chroma_stride;
+	color_yuv_rows(source, height, width, neutral, src_u, src_v, chroma_width, chroma_height, chroma_stride);
+
+	int count = width * 4;
+
+#pragma omp parallel
+	{
+		// one RGBA row per thread, it stays in the cache for the half conversion
+		std::vector<uchar> row(count);
+
+#pragma omp for
+		for (int y = 0; y < height; y++) {
+			int cy = (y / 2 < chroma_height) ? y / 2 : chroma_height - 1;
+			color_yuv_to_rgba_row(kernels,
+				source + (size_t)y * width,
+				src_u + cy * chroma_stride,
+				src_v + cy * chroma_stride,
+				row.data(),
+				width,
+				chroma_width);
+
+			unsigned short* dst = destination + (size_t)y * count;
+			int i = kernels.rgba_to_half(dst, row.data(), count);
+			rgba_to_half_scalar(dst, row.data(), i, count);
+		}
+	}
+}
+
+void color_rgba_to_half(unsigned short* destination, const unsigned char* source, int height, int width)
+{
+	const ColorKernels& kernels = color_kernels();
+	int count = width * 4;
+
+#pragma omp parallel for
+	for (int y = 0; y < height; y++) {
+		unsigned short* dst = destination + (size_t)y * count;
+		const uchar* src = source + (size_t)y * count;
+		int i = kernels.rgba_to_half(dst, src, count);
+		rgba_to_half_scalar(dst, src, i, count);
+	}
+}
+
+// blocks of values converted by one thread
+#define COLOR_HALF_BLOCK 65536
+
+void color_float_to_half(unsigned short* destination, const float* source, size_t count)
+{
+	const ColorKernels& kernels = color_kernels();
+	long long blocks = (long long)((count + COLOR_HALF_BLOCK - 1) / COLOR_HALF_BLOCK);
+
+#pragma omp parallel for
+	for (long long b = 0; b < blocks; b++) {
+		size_t begin = (size_t)b * COLOR_HALF_BLOCK;
+		int n = (int)(count - begin < COLOR_HALF_BLOCK ? count - begin : COLOR_HALF_BLOCK);
+		int i = kernels.float_to_half(destination + begin, source + begin, n);
+		float_to_half_scalar(destination + begin, source + begin, i, n);
+	}
+}
+
+void color_half_to_float(float* destination, const unsigned short* source, size_t count)
+{
+	const ColorKernels& kernels = color_kernels();
+	long long blocks = (long long)((count + COLOR_HALF_BLOCK - 1) / COLOR_HALF_BLOCK);
+
+#pragma omp parallel for
+	for (long long b = 0; b < blocks; b++) {
+		size_t begin = (size_t)b * COLOR_HALF_BLOCK;
+		int n = (int)(count - begin < COLOR_HALF_BLOCK ? count - begin : COLOR_HALF_BLOCK);
+		int i = kernels.half_to_float(destination + begin, source + begin, n);
+		half_to_float_scalar(destination + begin, source + begin, i, n);
+	}
+}
+
+// blocks of pixels packed by one thread
+#define COLOR_RGB_BLOCK 16384
+
+void color_rgba_to_rgb(void* destination, const void* source, size_t count, int channel_size)
+{
+	const ColorKernels& kernels = color_kernels();
+	long long blocks = (long long)((count + COLOR_RGB_BLOCK - 1) / COLOR_RGB_BLOCK);
+
+#pragma omp parallel for
+	for (long long b = 0; b < blocks; b++) {
+		size_t begin = (size_t)b * COLOR_RGB_BLOCK;
+		int n = (int)(count - begin < COLOR_RGB_BLOCK ? count - begin : COLOR_RGB_BLOCK);
+		uchar* dst = (uchar*)destination + begin * 3 * channel_size;
+		const uchar* src = (const uchar*)source + begin * 4 * channel_size;
+		int i = kernels.rgba_to_rgb(dst, src, n, channel_size);
+		rgba_to_rgb_scalar(dst, src, i, n, channel_size);
+	}
+}
+
+void color_rgb_to_rgba(void* destination, const void* source, size_t count, int channel_size, unsigned int alpha)
+{
+	const ColorKernels& kernels = color_kernels();
+	long long blocks = (long long)((count + COLOR_RGB_BLOCK - 1) / COLOR_RGB_BLOCK);
+
+#pragma omp parallel for
+	for (long long b = 0; b < blocks; b++) {
+		size_t begin = (size_t)b * COLOR_RGB_BLOCK;
+		int n = (int)(count - begin < COLOR_RGB_BLOCK ? count - begin : COLOR_RGB_BLOCK);
+		uchar* dst = (uchar*)destination + begin * 4 * channel_size;
+		const uchar* src = (const uchar*)source + begin * 3 * channel_size;
+		int i = kernels.rgb_to_rgba(dst, src, n, channel_size, alpha);
+		rgb_to_rgba_scalar(dst, src, i, n, channel_size, alpha);
+	}
+}
+
+void color_shuffle(unsigned char* destination, const unsigned char* source, const unsigned char* reference, size_t count, int element_size)
+{
+	size_t i = color_kernels().shuffle(destination, source, reference, count, element_size);
+	shuffle_scalar(destination, source, reference, i, count, element_size);
+}
+
+void color_unshuffle(unsigned char* destination, const unsigned char* source, const unsigned char* reference, size_t count, int element_size)
+{
+	size_t i = color_kernels().unshuffle(destination, source, reference, count, element_size);
+	unshuffle_scalar(destination, source, reference, i, count, element_size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// scaling
+
+template<typename T> static inline T color_lerp_value(float value)
+{
+	return (T)(value + 0.5f);
+}
+
+template<> inline float color_lerp_value<float>(float value)
+{
+	return value;
+}
+
+template<typename T>
+static void color_scale_rgba_type(T* destination, int height, int width, const T* source, int source_height, int source_width)
+{
+	// the pixel centers of both frames are aligned, the edges are clamped
+	std::vector<int> x0(width), x1(width);
+	std::vector<float> fx(width);
+	float scale_x = (float)source_width / width;
+	for (int x = 0; x < width; x++) {
+		float sx = (x + 0.5f) * scale_x - 0.5f;
+		if (sx < 0.0f)
+			sx = 0.0f;
+		int i = (int)sx;
+		x0[x] = i < source_width - 1 ? i : source_width - 1;
+		x1[x] = i + 1 < source_width ? i + 1 : source_width - 1;
+		fx[x] = sx - i;
+	}
+
+	float scale_y = (float)source_height / height;
+
+#pragma omp parallel for
+	for (int y = 0; y < height; y++) {
+		float sy = (y + 0.5f) * scale_y - 0.5f;
+		if (sy < 0.0f)
+			sy = 0.0f;
+		int i = (int)sy;
+		float fy = sy - i;
+		const T* r0 = source + (size_t)(i < source_height - 1 ? i : source_height - 1) * source_width * 4;
+		const T* r1 = source + (size_t)(i + 1 < source_height ? i + 1 : source_height - 1) * source_width * 4;
+		T* dst = destination + (size_t)y * width * 4;
+
+		for (int x = 0; x < width; x++) {
+			const T* p00 = r0 + x0[x] * 4;
+			const T* p01 = r0 + x1[x] * 4;
+			const T* p10 = r1 + x0[x] * 4;
+			const T* p11 = r1 + x1[x] * 4;
+			float f = fx[x];
+			for (int c = 0; c < 4; c++) {
+				float top = p00[c] + (p01[c] - (float)p00[c]) * f;
+				float bottom = p10[c] + (p11[c] - (float)p10[c]) * f;
+				dst[x * 4 + c] = color_lerp_value<T>(top + (bottom - top) * fy);
+			}
+		}
+	}
+}
+
+void color_scale_rgba(void* destination, int height, int width, const void* source, int source_height, int source_width, int channel_size)
+{
+	if (width <= 0 || height <= 0 || source_width <= 0 || source_height <= 0)
+		return;
+
+	if (channel_size == 4) {
+		color_scale_rgba_type((float*)destination, height, width, (const float*)source, source_height, source_width);
+	}
+	else if (channel_size == 2) {
+		color_scale_rgba_type((unsigned short*)destination, height, width, (const unsigned short*)source, source_height, source_width);
+	}
+	else {
+		color_scale_rgba_type((uchar*)destination, height, width, (const uchar*)source, source_height, source_width);
+	}
+}
@@ -0,0 +1,67 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_COLOR_H__
+#define __RENDERENGINE_COLOR_H__
+
+#include <stddef.h>
+#include "renderengine_api.h"
+
+#define COLOR_ISA_SCALAR 0
+#define COLOR_ISA_SSE41 1
+#define COLOR_ISA_AVX2 2
+#define COLOR_ISA_AVX512 3
+#define COLOR_ISA_NEON 4
+
+// Color conversions between RGBA8, float, half float RGBA, RGB and I420 (BT.601 video range). The
+// I420 planes are Y (width * height), U and V (width / 2 * height / 2 each, starting at
+// width * height and width * height * 5 / 4). The kernels are selected once by the CPU
+// features, BRAAS_HPC_COLOR_ISA=scalar|sse41|avx2|avx512 limits the selection.
+
+// the selected instruction set
+BRAAS_HPC_EXPORT_DLL int color_get_isa();
+BRAAS_HPC_EXPORT_DLL const char* color_get_isa_name();
+
+// forces an instruction set (if supported), returns the selected one
+BRAAS_HPC_EXPORT_DLL int color_set_isa(int isa);
+
+BRAAS_HPC_EXPORT_DLL void color_rgba_to_yuv_i420(unsigned char* destination, const unsigned char* source, int height, int width);
+BRAAS_HPC_EXPORT_DLL void color_yuv_i420_to_rgba(unsigned char* destination, const unsigned char* source, int height, int width);
+BRAAS_HPC_EXPORT_DLL void color_yuv_i420_to_rgba_half(unsigned short* destination, const unsigned char* source, int height, int width);
+BRAAS_HPC_EXPORT_DLL void color_rgba_to_half(unsigned short* destination, const unsigned char* source, int height, int width);
+
+// count floats to halfs (round to nearest even) and back
+BRAAS_HPC_EXPORT_DLL void color_float_to_half(unsigned short* destination, const float* source, size_t count);
+BRAAS_HPC_EXPORT_DLL void color_half_to_float(float* destination, const unsigned short* source, size_t count);
+
+// count RGBA pixels with channels of channel_size bytes (1, 2 or 4) to RGB and back, alpha
+// holds the bits of the alpha channel (0xff, 0xffff, 0x3c00 = half 1.0, 0x3f800000 = float 1.0)
+BRAAS_HPC_EXPORT_DLL void color_rgba_to_rgb(void* destination, const void* source, size_t count, int channel_size);
+BRAAS_HPC_EXPORT_DLL void color_rgb_to_rgba(void* destination, const void* source, size_t count, int channel_size, unsigned int alpha);
+
+// count elements of element_size bytes to element_size planes of count bytes (byte b of
+// every element in plane b) and back, XORed with the elements of reference unless NULL.
+// Not threaded, the codec calls them for its strips in parallel.
+BRAAS_HPC_EXPORT_DLL void color_shuffle(unsigned char* destination, const unsigned char* source, const unsigned char* reference, size_t count, int element_size);
+BRAAS_HPC_EXPORT_DLL void color_unshuffle(unsigned char* destination, const unsigned char* source, const unsigned char* reference, size_t count, int element_size);
+
+// bilinear scaling of RGBA pixels with channels of channel_size bytes (1, 2 or 4 = float)
+BRAAS_HPC_EXPORT_DLL void color_scale_rgba(void* destination, int height, int width,
+	const void* source, int source_height, int source_width, int channel_size);
+
+#endif
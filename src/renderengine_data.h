@@ -49,10 +49,21 @@ typedef struct renderengine_data {
 	int reset;
 	int frame;
 
+	// region of interest x, y, width, height at the resolution of the client, width 0: the whole frame
+	int roi[4];
+
 	struct renderengine_cam cam;
 
 }renderengine_data;
 
+// a rectangle of a progressively sent frame, last: the frame is complete
+typedef struct renderengine_tile {
+	int x, y;
+	int width, height;
+	int last;
+	int reserved;
+}renderengine_tile;
+
 //typedef struct BRaaSHPCDataRender {
 //	float colorMap[4 * 128];
 //	float domain[2];
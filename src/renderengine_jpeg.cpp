@@ -0,0 +1,563 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_jpeg.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WITH_CLIENT_JPEG
+#  include <setjmp.h>
+#  include <jpeglib.h>
+#endif
+
+#define JPEG_MARKER_SOF0 0xC0
+#define JPEG_MARKER_SOF1 0xC1
+#define JPEG_MARKER_RST0 0xD0
+#define JPEG_MARKER_RST7 0xD7
+#define JPEG_MARKER_SOI 0xD8
+#define JPEG_MARKER_EOI 0xD9
+#define JPEG_MARKER_SOS 0xDA
+#define JPEG_MARKER_DRI 0xDD
+
+#ifdef WITH_CLIENT_JPEG
+
+// the segments in front of the entropy coded data
+typedef struct JpegHeader {
+	size_t sof = 0;        // offset of the SOF marker
+	size_t scan = 0;       // first byte after the SOS segment
+	int baseline = 0;      // SOF0/SOF1, one scan
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	int mcu_width = 8;
+	int mcu_height = 8;
+	int restart_interval = 0;
+} JpegHeader;
+
+static inline int jpeg_read_u16(const unsigned char* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static bool jpeg_parse_header(const unsigned char* data, size_t size, JpegHeader& header)
+{
+	if (size < 4 || data[0] != 0xFF || data[1] != JPEG_MARKER_SOI)
+		return false;
+
+	size_t p = 2;
+	while (p + 4 <= size) {
+		if (data[p] != 0xFF)
+			return false;
+
+		int marker = data[p + 1];
+		if (marker == 0xFF) {
+			p++;
+			continue;
+		}
+
+		size_t length = (size_t)jpeg_read_u16(data + p + 2);
+		if (length < 2 || p + 2 + length > size)
+			return false;
+
+		const unsigned char* segment = data + p + 4;
+
+		if (marker >= JPEG_MARKER_SOF0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+			if (length < 8)
+				return false;
+
+			header.sof = p;
+			header.baseline = (marker == JPEG_MARKER_SOF0 || marker == JPEG_MARKER_SOF1);
+			header.height = jpeg_read_u16(segment + 1);
+			header.width = jpeg_read_u16(segment + 3);
+			header.components = segment[5];
+
+			int max_h = 1, max_v = 1;
+			for (int c = 0; c < header.components && 9 + 3 * c < (int)length; c++) {
+				int h = segment[7 + 3 * c] >> 4;
+				int v = segment[7 + 3 * c] & 0x0F;
+				max_h = (h > max_h) ? h : max_h;
+				max_v = (v > max_v) ? v : max_v;
+			}
+			header.mcu_width = 8 * max_h;
+			header.mcu_height = 8 * max_v;
+		}
+		else if (marker == JPEG_MARKER_DRI && length >= 4) {
+			header.restart_interval = jpeg_read_u16(segment);
+		}
+		else if (marker == JPEG_MARKER_SOS) {
+			header.scan = p + 2 + length;
+			return header.sof != 0;
+		}
+
+		p += 2 + length;
+	}
+
+	return false;
+}
+
+typedef struct JpegError {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jump;
+} JpegError;
+
+static void jpeg_error_exit(j_common_ptr cinfo)
+{
+	char message[JMSG_LENGTH_MAX];
+	(*cinfo->err->format_message)(cinfo, message);
+	printf("CpuJpeg: %s\n", message);
+
+	longjmp(((JpegError*)cinfo->err)->jump, 1);
+}
+
+// compressed data into a growing buffer
+typedef struct JpegDestination {
+	struct jpeg_destination_mgr mgr;
+	JpegStrip* strip;
+} JpegDestination;
+
+static void jpeg_init_destination(j_compress_ptr cinfo)
+{
+	JpegDestination* dest = (JpegDestination*)cinfo->dest;
+	if (dest->strip->data.size() < 65536) {
+		dest->strip->data.resize(65536);
+	}
+	dest->mgr.next_output_byte = dest->strip->data.data();
+	dest->mgr.free_in_buffer = dest->strip->data.size();
+}
+
+static boolean jpeg_empty_output_buffer(j_compress_ptr cinfo)
+{
+	JpegDestination* dest = (JpegDestination*)cinfo->dest;
+	size_t used = dest->strip->data.size();
+	dest->strip->data.resize(used * 2);
+	dest->mgr.next_output_byte = dest->strip->data.data() + used;
+	dest->mgr.free_in_buffer = dest->strip->data.size() - used;
+	return TRUE;
+}
+
+static void jpeg_term_destination(j_compress_ptr cinfo)
+{
+	JpegDestination* dest = (JpegDestination*)cinfo->dest;
+	dest->strip->size = dest->strip->data.size() - dest->mgr.free_in_buffer;
+}
+
+// one row of RGBA pixels to RGBA8
+static void jpeg_load_row(unsigned char* dst, const char* src, int width, int format)
+{
+	int count = width * 4;
+
+	if (format == 16) {
+		const unsigned short* s = (const unsigned short*)src;
+		for (int i = 0; i < count; i++) {
+			dst[i] = (unsigned char)(s[i] >> 8);
+		}
+	}
+	else if (format == 32) {
+		const float* s = (const float*)src;
+		for (int i = 0; i < count; i++) {
+			float v = s[i] * 255.0f + 0.5f;
+			dst[i] = (unsigned char)(v > 0.0f ? (v < 255.0f ? v : 255.0f) : 0.0f);
+		}
+	}
+	else {
+		memcpy(dst, src, count);
+	}
+}
+
+// one row of RGBA8 to RGBA pixels
+static void jpeg_store_row(char* dst, const unsigned char* src, int width, int format)
+{
+	int count = width * 4;
+
+	if (format == 16) {
+		unsigned short* d = (unsigned short*)dst;
+		for (int i = 0; i < count; i++) {
+			d[i] = (unsigned short)(src[i] * 257);
+		}
+	}
+	else if (format == 32) {
+		float* d = (float*)dst;
+		for (int i = 0; i < count; i++) {
+			d[i] = src[i] * (1.0f / 255.0f);
+		}
+	}
+	else {
+		memcpy(dst, src, count);
+	}
+}
+
+// Y Cb Cr A of GPUJPEG with alpha to RGBA8 (JFIF full range)
+static void jpeg_ycca_to_rgba(unsigned char* row, int width)
+{
+	for (int x = 0; x < width; x++) {
+		unsigned char* p = row + x * 4;
+		int Y = p[0] << 16;
+		int Cb = p[1] - 128;
+		int Cr = p[2] - 128;
+
+		int r = (Y + 91881 * Cr + 32768) >> 16;
+		int g = (Y - 22554 * Cb - 46802 * Cr + 32768) >> 16;
+		int b = (Y + 116130 * Cb + 32768) >> 16;
+
+		p[0] = (unsigned char)(r < 0 ? 0 : (r > 255 ? 255 : r));
+		p[1] = (unsigned char)(g < 0 ? 0 : (g > 255 ? 255 : g));
+		p[2] = (unsigned char)(b < 0 ? 0 : (b > 255 ? 255 : b));
+	}
+}
+
+static bool jpeg_encode_strip(JpegStrip& strip, const char* pixels, int width, int rows, int format, int quality)
+{
+	struct jpeg_compress_struct cinfo;
+	JpegError error;
+	JpegDestination dest;
+
+	cinfo.err = jpeg_std_error(&error.mgr);
+	error.mgr.error_exit = jpeg_error_exit;
+	if (setjmp(error.jump)) {
+		jpeg_destroy_compress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_compress(&cinfo);
+
+	dest.strip = &strip;
+	dest.mgr.init_destination = jpeg_init_destination;
+	dest.mgr.empty_output_buffer = jpeg_empty_output_buffer;
+	dest.mgr.term_destination = jpeg_term_destination;
+	cinfo.dest = &dest.mgr;
+
+	cinfo.image_width = width;
+	cinfo.image_height = rows;
+	cinfo.input_components = 4;
+	cinfo.in_color_space = JCS_EXT_RGBA;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+
+	// 4:4:4 and the standard Huffman tables, every strip has the same tables
+	for (int c = 0; c < cinfo.num_components; c++) {
+		cinfo.comp_info[c].h_samp_factor = 1;
+		cinfo.comp_info[c].v_samp_factor = 1;
+	}
+	cinfo.optimize_coding = FALSE;
+	cinfo.restart_interval = (width + 7) / 8;
+	cinfo.dct_method = JDCT_ISLOW;
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	size_t stride = (size_t)width * 4 * (format / 8);
+	strip.row.resize((size_t)width * 4);
+
+	while (cinfo.next_scanline < cinfo.image_height) {
+		const char* src = pixels + cinfo.next_scanline * stride;
+		JSAMPROW row;
+		if (format == 8) {
+			row = (JSAMPROW)src;
+		}
+		else {
+			jpeg_load_row(strip.row.data(), src, width, format);
+			row = strip.row.data();
+		}
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	return true;
+}
+
+static bool jpeg_decode_strip(
+	JpegStrip& strip, const unsigned char* data, size_t size, char* pixels, int width, int rows, int format)
+{
+	struct jpeg_decompress_struct cinfo;
+	JpegError error;
+
+	cinfo.err = jpeg_std_error(&error.mgr);
+	error.mgr.error_exit = jpeg_error_exit;
+	if (setjmp(error.jump)) {
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char*)data, (unsigned long)size);
+	jpeg_read_header(&cinfo, TRUE);
+
+	if ((int)cinfo.image_width != width || (int)cinfo.image_height != rows ||
+		(cinfo.num_components != 3 && cinfo.num_components != 4)) {
+		printf("CpuJpeg: a %dx%d image with %d components does not fit %dx%d\n",
+			cinfo.image_width, cinfo.image_height, cinfo.num_components, width, rows);
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	// GPUJPEG with alpha writes Y Cb Cr A, libjpeg would take it for CMYK
+	bool ycca = (cinfo.num_components == 4);
+	if (ycca) {
+		cinfo.jpeg_color_space = JCS_CMYK;
+		cinfo.out_color_space = JCS_CMYK;
+	}
+	else {
+		cinfo.out_color_space = JCS_EXT_RGBA;
+	}
+	cinfo.dct_method = JDCT_ISLOW;
+
+	jpeg_start_decompress(&cinfo);
+
+	size_t stride = (size_t)width * 4 * (format / 8);
+	strip.row.resize((size_t)width * 4);
+
+	while (cinfo.output_scanline < cinfo.output_height) {
+		char* dst = pixels + cinfo.output_scanline * stride;
+		bool direct = (format == 8 && !ycca);
+		JSAMPROW row = direct ? (JSAMPROW)dst : strip.row.data();
+		jpeg_read_scanlines(&cinfo, &row, 1);
+
+		if (!direct) {
+			if (ycca) {
+				jpeg_ycca_to_rgba(row, width);
+			}
+			jpeg_store_row(dst, row, width, format);
+		}
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	return true;
+}
+
+#endif
+
+bool CpuJpeg::is_supported()
+{
+#ifdef WITH_CLIENT_JPEG
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool CpuJpeg::encode(const char* pixels, int width, int height, int format)
+{
+#ifdef WITH_CLIENT_JPEG
+	if (width < 1 || height < 1 || width > 65535 || height > 65535 || (format != 8 && format != 16 && format != 32)) {
+		printf("CpuJpeg::encode: unsupported image %dx%d, format %d\n", width, height, format);
+		return false;
+	}
+
+	// strips of JPEG_STRIP_MCU_ROWS rows of 8x8 MCUs, each row is a restart interval
+	int mcu_rows = (height + 7) / 8;
+	int units = (mcu_rows + JPEG_STRIP_MCU_ROWS - 1) / JPEG_STRIP_MCU_ROWS;
+	int strip_rows = ((units + JPEG_MAX_STRIPS - 1) / JPEG_MAX_STRIPS) * JPEG_STRIP_MCU_ROWS * 8;
+	int strips = (height + strip_rows - 1) / strip_rows;
+
+	if ((int)m_strips.size() < strips) {
+		m_strips.resize(strips);
+	}
+
+	size_t stride = (size_t)width * 4 * (format / 8);
+	int error = 0;
+
+#pragma omp parallel for
+	for (int s = 0; s < strips; s++) {
+		int row = s * strip_rows;
+		int rows = (row + strip_rows <= height) ? strip_rows : height - row;
+		if (!jpeg_encode_strip(m_strips[s], pixels + row * stride, width, rows, format, m_quality)) {
+#pragma omp atomic write
+			error = 1;
+		}
+	}
+
+	if (error)
+		return false;
+
+	// the header of the first strip with the height of the frame, then the scans joined
+	// by the restart marker that ends the last interval of a strip
+	JpegHeader first;
+	if (!jpeg_parse_header(m_strips[0].data.data(), m_strips[0].size, first)) {
+		printf("CpuJpeg::encode: invalid stream\n");
+		return false;
+	}
+
+	size_t size = first.scan + 2;
+	for (int s = 0; s < strips; s++) {
+		size += m_strips[s].size - first.scan;
+	}
+
+	if (m_data.size() < size) {
+		m_data.resize(size);
+	}
+
+	unsigned char* out = m_data.data();
+	memcpy(out, m_strips[0].data.data(), first.scan);
+	out[first.sof + 5] = (unsigned char)(height >> 8);
+	out[first.sof + 6] = (unsigned char)(height & 0xFF);
+	out += first.scan;
+
+	for (int s = 0; s < strips; s++) {
+		const JpegStrip& strip = m_strips[s];
+		// all strips have the same header, the scan ends with EOI
+		size_t scan_size = strip.size - first.scan - 2;
+		memcpy(out, strip.data.data() + first.scan, scan_size);
+		out += scan_size;
+
+		*out++ = 0xFF;
+		*out++ = (s < strips - 1) ? JPEG_MARKER_RST7 : JPEG_MARKER_EOI;
+	}
+
+	m_size = out - m_data.data();
+
+	return true;
+#else
+	printf("CpuJpeg::encode: not compiled with JPEG support\n");
+	return false;
+#endif
+}
+
+char* CpuJpeg::prepare_decode(size_t size)
+{
+	if (m_data.size() < size) {
+		m_data.resize(size);
+	}
+	m_size = size;
+
+	return (char*)m_data.data();
+}
+
+bool CpuJpeg::decode(char* pixels, int width, int height, int format)
+{
+#ifdef WITH_CLIENT_JPEG
+	if (format != 8 && format != 16 && format != 32) {
+		printf("CpuJpeg::decode: unsupported format %d\n", format);
+		return false;
+	}
+
+	JpegHeader header;
+	if (!jpeg_parse_header(m_data.data(), m_size, header) || header.width != width || header.height != height) {
+		printf("CpuJpeg::decode: the stream does not contain a %dx%d image\n", width, height);
+		return false;
+	}
+
+	// restart intervals of whole MCU rows can be decoded independently
+	int mcus_per_row = (width + header.mcu_width - 1) / header.mcu_width;
+	if (header.baseline && header.restart_interval > 0 && header.restart_interval % mcus_per_row == 0) {
+		return decode_strips(pixels, width, height, format);
+	}
+
+	if (m_strips.empty()) {
+		m_strips.resize(1);
+	}
+
+	return jpeg_decode_strip(m_strips[0], m_data.data(), m_size, pixels, width, height, format);
+#else
+	printf("CpuJpeg::decode: not compiled with JPEG support\n");
+	return false;
+#endif
+}
+
+bool CpuJpeg::decode_strips(char* pixels, int width, int height, int format)
+{
+#ifdef WITH_CLIENT_JPEG
+	JpegHeader header;
+	jpeg_parse_header(m_data.data(), m_size, header);
+
+	const unsigned char* data = m_data.data();
+	size_t end = m_size;
+	while (end >= header.scan + 2 && !(data[end - 2] == 0xFF && data[end - 1] == JPEG_MARKER_EOI)) {
+		end--;
+	}
+	if (end < header.scan + 2) {
+		printf("CpuJpeg::decode: missing EOI\n");
+		return false;
+	}
+	end -= 2;
+
+	// the restart intervals, a 0xFF in the entropy coded data is followed by 0x00
+	std::vector<size_t> segments;
+	segments.push_back(header.scan);
+	for (size_t p = header.scan; p + 1 < end; p++) {
+		if (data[p] == 0xFF && data[p + 1] >= JPEG_MARKER_RST0 && data[p + 1] <= JPEG_MARKER_RST7) {
+			segments.push_back(p + 2);
+		}
+	}
+	segments.push_back(end + 2);
+
+	int intervals = (int)segments.size() - 1;
+	int interval_rows = header.restart_interval / ((width + header.mcu_width - 1) / header.mcu_width) * header.mcu_height;
+	if ((size_t)intervals * interval_rows < (size_t)height) {
+		printf("CpuJpeg::decode: %d restart intervals do not cover %d rows\n", intervals, height);
+		return false;
+	}
+
+	int group = (intervals + JPEG_MAX_STRIPS - 1) / JPEG_MAX_STRIPS;
+	int strips = (intervals + group - 1) / group;
+	if ((int)m_strips.size() < strips) {
+		m_strips.resize(strips);
+	}
+
+	size_t stride = (size_t)width * 4 * (format / 8);
+	int error = 0;
+
+#pragma omp parallel for
+	for (int s = 0; s < strips; s++) {
+		int first = s * group;
+		int last = (first + group < intervals) ? first + group : intervals;
+		int row = first * interval_rows;
+		if (row >= height)
+			continue;
+
+		int rows = (last * interval_rows < height) ? (last - first) * interval_rows : height - row;
+
+		// the header with the height of the strip and the intervals renumbered from 0
+		JpegStrip& strip = m_strips[s];
+		size_t size = header.scan + 2;
+		for (int i = first; i < last; i++) {
+			size += segments[i + 1] - segments[i];
+		}
+		if (strip.data.size() < size) {
+			strip.data.resize(size);
+		}
+
+		unsigned char* out = strip.data.data();
+		memcpy(out, data, header.scan);
+		out[header.sof + 5] = (unsigned char)(rows >> 8);
+		out[header.sof + 6] = (unsigned char)(rows & 0xFF);
+		out += header.scan;
+
+		for (int i = first; i < last; i++) {
+			size_t segment_size = segments[i + 1] - segments[i] - 2;
+			memcpy(out, data + segments[i], segment_size);
+			out += segment_size;
+
+			*out++ = 0xFF;
+			*out++ = (i < last - 1) ? (unsigned char)(JPEG_MARKER_RST0 + (i - first) % 8) : JPEG_MARKER_EOI;
+		}
+
+		if (!jpeg_decode_strip(strip, strip.data.data(), out - strip.data.data(), pixels + row * stride, width, rows, format)) {
+#pragma omp atomic write
+			error = 1;
+		}
+	}
+
+	return error == 0;
+#else
+	return false;
+#endif
+}
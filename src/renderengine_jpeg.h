@@ -0,0 +1,71 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_JPEG_H__
+#define __RENDERENGINE_JPEG_H__
+
+#include <stdlib.h>
+#include <vector>
+#include "renderengine_api.h"
+
+#define JPEG_QUALITY_DEFAULT 75
+#define JPEG_MAX_STRIPS 32
+
+// the restart markers cycle through 8 numbers, a strip starts with marker 0
+#define JPEG_STRIP_MCU_ROWS 8
+
+typedef struct JpegStrip {
+	std::vector<unsigned char> data;
+	size_t size = 0;
+	std::vector<unsigned char> row; // one row of pixels converted from/to RGBA8
+} JpegStrip;
+
+// Baseline JPEG on the CPU (libjpeg-turbo) with the stream of GPUJPEG: YCbCr 4:4:4 and a
+// restart marker after every MCU row. The frame is encoded in strips of whole restart
+// intervals on parallel threads and the strips are joined at their restart markers, a
+// received stream is split at the restart markers in the same way.
+// format: bits of a channel of the RGBA pixels, 8, 16 or 32 (float).
+class BRAAS_HPC_EXPORT_DLL CpuJpeg {
+protected:
+	int m_quality = JPEG_QUALITY_DEFAULT;
+
+	std::vector<JpegStrip> m_strips;
+	std::vector<unsigned char> m_data; // the whole stream
+	size_t m_size = 0;
+
+public:
+	static bool is_supported();
+
+	void set_quality(int quality) { m_quality = quality; }
+	int get_quality() { return m_quality; }
+
+	// the result is get_data() and get_size()
+	bool encode(const char* pixels, int width, int height, int format);
+
+	char* get_data() { return (char*)m_data.data(); }
+	size_t get_size() { return m_size; }
+
+	// buffer for a received stream of size bytes
+	char* prepare_decode(size_t size);
+	bool decode(char* pixels, int width, int height, int format);
+
+protected:
+	bool decode_strips(char* pixels, int width, int height, int format);
+};
+
+#endif
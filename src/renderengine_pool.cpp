@@ -0,0 +1,186 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_pool.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
+static size_t round_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+bool BufferCapacity::request(size_t size, size_t alignment)
+{
+	if (m_capacity > 0 && size <= m_capacity) {
+		if (size >= m_capacity / 4) {
+			m_small_requests = 0;
+			return false;
+		}
+
+		if (++m_small_requests < POOL_SHRINK_REQUESTS)
+			return false;
+	}
+
+	size_t capacity = round_up(size + size / 4, alignment);
+	m_capacity = capacity > 0 ? capacity : alignment;
+	m_small_requests = 0;
+	return true;
+}
+
+void BufferCapacity::clear()
+{
+	m_capacity = 0;
+	m_small_requests = 0;
+}
+
+PooledBuffer::~PooledBuffer()
+{
+	release();
+}
+
+size_t PooledBuffer::get_page_size()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (size_t)info.dwPageSize;
+#else
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+char* PooledBuffer::reserve(size_t size)
+{
+	size_t alignment = m_huge_pages ? POOL_HUGE_PAGE_SIZE : get_page_size();
+	if (!m_capacity.request(size, alignment) && m_data != NULL)
+		return m_data;
+
+	free_data();
+
+	size_t capacity = m_capacity.get_capacity();
+#ifdef _WIN32
+	m_data = (char*)VirtualAlloc(NULL, capacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	void* data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	m_data = data == MAP_FAILED ? NULL : (char*)data;
+#endif
+
+	if (m_data == NULL) {
+		printf("PooledBuffer: Allocation of %zu bytes failed\n", capacity);
+		m_capacity.clear();
+		return NULL;
+	}
+
+	m_size = capacity;
+	m_allocations++;
+
+	if (m_huge_pages)
+		advise_huge_pages();
+	if (m_lock)
+		lock();
+
+	return m_data;
+}
+
+void PooledBuffer::release()
+{
+	free_data();
+	m_capacity.clear();
+}
+
+void PooledBuffer::free_data()
+{
+	if (m_data == NULL)
+		return;
+
+	unlock();
+
+#ifdef _WIN32
+	VirtualFree(m_data, 0, MEM_RELEASE);
+#else
+	munmap(m_data, m_size);
+#endif
+
+	m_data = NULL;
+	m_size = 0;
+}
+
+void PooledBuffer::set_huge_pages(bool enabled)
+{
+	m_huge_pages = enabled;
+	if (m_data != NULL)
+		advise_huge_pages();
+}
+
+void PooledBuffer::set_lock(bool enabled)
+{
+	m_lock = enabled;
+	if (m_data == NULL)
+		return;
+
+	if (enabled)
+		lock();
+	else
+		unlock();
+}
+
+// transparent huge pages need no reserved pool, only Linux has them
+void PooledBuffer::advise_huge_pages()
+{
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+	madvise(m_data, m_size, m_huge_pages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+}
+
+void PooledBuffer::lock()
+{
+	if (m_locked)
+		return;
+
+#ifdef _WIN32
+	m_locked = VirtualLock(m_data, m_size) != 0;
+#else
+	m_locked = mlock(m_data, m_size) == 0;
+#endif
+
+	if (!m_locked)
+		printf("PooledBuffer: Locking %zu bytes failed (memlock limit), the buffer can be paged out\n", m_size);
+}
+
+void PooledBuffer::unlock()
+{
+	if (!m_locked)
+		return;
+
+#ifdef _WIN32
+	VirtualUnlock(m_data, m_size);
+#else
+	munlock(m_data, m_size);
+#endif
+
+	m_locked = false;
+}
@@ -0,0 +1,88 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_POOL_H__
+#define __RENDERENGINE_POOL_H__
+
+#include <stddef.h>
+#include "renderengine_api.h"
+
+// requests in a row that need less than a quarter of the capacity before it shrinks
+#define POOL_SHRINK_REQUESTS 8
+
+// alignment of the capacity on huge pages
+#define POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Capacity of a grow-only buffer. A request within the capacity keeps it, a larger one grows
+// it with a quarter of headroom, and it shrinks only after POOL_SHRINK_REQUESTS requests in a
+// row needed less than a quarter of it, so a resized viewport does not reallocate per event.
+class BRAAS_HPC_EXPORT_DLL BufferCapacity {
+protected:
+	size_t m_capacity = 0;
+	int m_small_requests = 0;
+
+public:
+	// true if the buffer has to be reallocated with get_capacity() bytes to hold size bytes,
+	// the capacity is a multiple of alignment
+	bool request(size_t size, size_t alignment);
+	size_t get_capacity() { return m_capacity; }
+	void clear();
+};
+
+// Page aligned host memory of a BufferCapacity, optionally on transparent huge pages (Linux)
+// and locked in RAM. The contents are lost when the buffer is reallocated.
+class BRAAS_HPC_EXPORT_DLL PooledBuffer {
+protected:
+	BufferCapacity m_capacity;
+	char* m_data = NULL;
+	size_t m_size = 0; // bytes mapped, the capacity when the buffer was allocated
+
+	bool m_huge_pages = false;
+	bool m_lock = false;
+	bool m_locked = false;
+	int m_allocations = 0;
+
+public:
+	~PooledBuffer();
+
+	// a buffer of at least size bytes, NULL if out of memory
+	char* reserve(size_t size);
+	// frees the buffer and its capacity
+	void release();
+
+	char* get_data() { return m_data; }
+	size_t get_capacity() { return m_size; }
+	int get_allocations() { return m_allocations; }
+
+	// both apply to the current buffer and to the next ones
+	void set_huge_pages(bool enabled);
+	bool is_huge_pages() { return m_huge_pages; }
+	void set_lock(bool enabled);
+	bool is_lock() { return m_lock; }
+	bool is_locked() { return m_locked; }
+
+	static size_t get_page_size();
+
+protected:
+	void free_data();
+	void advise_huge_pages();
+	void lock();
+	void unlock();
+};
+
+#endif
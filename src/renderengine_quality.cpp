@@ -0,0 +1,124 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_quality.h"
+
+// weight of the last frame in the averages
+#define QUALITY_AVERAGE 0.25
+
+// the encode and send always get at least this part of the frame time, with a slower
+// renderer the target is out of reach and the quality would drop to the minimum
+#define QUALITY_MIN_BUDGET 0.25
+
+#define QUALITY_MAX_STEP 15
+#define QUALITY_STILL_STEP 5
+
+static double average(double value, double sample)
+{
+	return value <= 0.0 ? sample : value + (sample - value) * QUALITY_AVERAGE;
+}
+
+void QualityController::set_range(int min_quality, int max_quality)
+{
+	m_min = min_quality < 1 ? 1 : (min_quality > 100 ? 100 : min_quality);
+	m_max = max_quality < m_min ? m_min : (max_quality > 100 ? 100 : max_quality);
+
+	if (m_quality >= 0)
+		m_quality = clamp(m_quality);
+
+	if (m_motion_quality >= 0)
+		m_motion_quality = clamp(m_motion_quality);
+}
+
+int QualityController::clamp(int quality)
+{
+	if (quality < m_min)
+		return m_min;
+
+	if (quality > m_max)
+		return m_max;
+
+	return quality;
+}
+
+int QualityController::get_quality(int initial)
+{
+	if (m_quality < 0)
+		m_quality = clamp(initial);
+
+	return m_quality;
+}
+
+void QualityController::update(double start, double end, size_t bytes, int idle_frames)
+{
+	double send = end - start;
+	if (send < 0.0)
+		send = 0.0;
+
+	m_send = average(m_send, send);
+	if (send > 0.0)
+		m_throughput = average(m_throughput, (double)bytes / send);
+
+	// the time between two frames is the send of the previous one and the rendering
+	if (m_last_start > 0.0) {
+		double render = start - m_last_start - m_last_send;
+		m_render = average(m_render, render > 0.0 ? render : 0.0);
+	}
+	m_last_start = start;
+	m_last_send = send;
+
+	if (!is_enabled() || m_quality < 0)
+		return;
+
+	if (idle_frames >= m_idle_frames) {
+		if (!m_still) {
+			m_still = true;
+			m_motion_quality = m_quality;
+		}
+
+		m_quality = clamp(m_quality + QUALITY_STILL_STEP);
+		return;
+	}
+
+	// back to the quality that kept up with the motion before the view stopped
+	if (m_still) {
+		m_still = false;
+		m_quality = m_motion_quality;
+		m_send = 0.0; // the times of the still frames do not apply
+		return;
+	}
+
+	double frame = 1.0 / m_target_fps;
+	double budget = frame - m_render;
+	if (budget < frame * QUALITY_MIN_BUDGET)
+		budget = frame * QUALITY_MIN_BUDGET;
+
+	if (m_send <= 0.0)
+		return;
+
+	// the size of a JPEG grows faster than linear with the quality near the top, so the
+	// quality goes down in steps proportional to the overrun and up one by one
+	double ratio = budget / m_send;
+	if (ratio < 0.9) {
+		int step = (int)((1.0 - ratio) * 50.0);
+		m_quality = clamp(m_quality - (step < 1 ? 1 : (step > QUALITY_MAX_STEP ? QUALITY_MAX_STEP : step)));
+	}
+	else if (ratio > 1.25) {
+		m_quality = clamp(m_quality + 1);
+	}
+}
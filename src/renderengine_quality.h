@@ -0,0 +1,80 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_QUALITY_H__
+#define __RENDERENGINE_QUALITY_H__
+
+#include <stdlib.h>
+#include "renderengine_api.h"
+
+#define QUALITY_MIN_DEFAULT 30
+#define QUALITY_MAX_DEFAULT 95
+
+// frames without a change of the camera after which the view is still
+#define QUALITY_IDLE_FRAMES_DEFAULT 8
+
+// Chooses the quality of the lossy stream frame by frame. While the camera moves the
+// quality follows the time the encode and send of a frame may take to reach the target
+// frame rate (the rest of the frame time is rendering), when the view is still the
+// quality rises to the maximum as the progressive render converges.
+class BRAAS_HPC_EXPORT_DLL QualityController {
+protected:
+	float m_target_fps = 0.0f; // 0: the quality is fixed
+	int m_min = QUALITY_MIN_DEFAULT;
+	int m_max = QUALITY_MAX_DEFAULT;
+	int m_idle_frames = QUALITY_IDLE_FRAMES_DEFAULT;
+
+	int m_quality = -1;
+	int m_motion_quality = -1; // quality of the last moving frames, restored on motion
+	bool m_still = false;
+
+	// averages over the last frames in seconds and bytes per second
+	double m_send = 0.0;
+	double m_render = 0.0;
+	double m_throughput = 0.0;
+
+	double m_last_start = 0.0;
+	double m_last_send = 0.0;
+
+public:
+	void set_target_fps(float fps) { m_target_fps = fps > 0.0f ? fps : 0.0f; }
+	float get_target_fps() { return m_target_fps; }
+	bool is_enabled() { return m_target_fps > 0.0f; }
+
+	void set_range(int min_quality, int max_quality);
+	int get_min() { return m_min; }
+	int get_max() { return m_max; }
+
+	void set_idle_frames(int frames) { m_idle_frames = frames > 0 ? frames : 1; }
+	int get_idle_frames() { return m_idle_frames; }
+
+	// quality of the next frame, initial is used before the first update
+	int get_quality(int initial);
+
+	// a frame of bytes was encoded and sent from start to end (seconds), idle_frames
+	// frames were sent since the camera last changed
+	void update(double start, double end, size_t bytes, int idle_frames);
+
+	double get_send_time() { return m_send; }
+	double get_throughput() { return m_throughput; }
+
+protected:
+	int clamp(int quality);
+};
+
+#endif
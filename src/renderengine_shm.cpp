@@ -0,0 +1,507 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_shm.h"
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#endif
+
+#define SHM_HEADER_SIZE 4096
+#define SHM_RING_SIZE_CLIENT_TO_SERVER (1L * 1024L * 1024L)
+#define SHM_RING_SIZE_SERVER_TO_CLIENT (64L * 1024L * 1024L)
+
+#define SHM_WAIT_TIMEOUT_MS 100
+#define SHM_SPIN_COUNT 1000
+
+ShmConnection::ShmConnection()
+{
+	for (int tid = 0; tid < MAX_CONNECTIONS; tid++) {
+		g_segment[tid] = NULL;
+		g_segment_size[tid] = 0;
+	}
+
+	strcpy(g_shm_name, "braas_hpc");
+}
+
+bool ShmConnection::is_shm_name(const char* server)
+{
+	return server != NULL && strncmp(server, SHM_PREFIX, strlen(SHM_PREFIX)) == 0;
+}
+
+void ShmConnection::segment_name(char* name, int offset)
+{
+	sprintf(name, "/braas_hpc_%s_%d", g_shm_name, g_shm_port + offset);
+}
+
+bool ShmConnection::segment_create(int offset)
+{
+	char name[1200];
+	segment_name(name, offset);
+
+	size_t ring_size_s2c = SHM_RING_SIZE_SERVER_TO_CLIENT;
+	const char* env_shm_size = std::getenv("BRAAS_HPC_SHM_SIZE");
+	if (env_shm_size != NULL && atoi(env_shm_size) > 0) {
+		ring_size_s2c = (size_t)atoi(env_shm_size) * 1024L * 1024L;
+	}
+
+	size_t size = SHM_HEADER_SIZE + SHM_RING_SIZE_CLIENT_TO_SERVER + ring_size_s2c;
+
+	// a segment left behind by a crashed server must not be reused
+	shm_unlink(name);
+
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd == -1) {
+		printf("shm_open %s failed\n", name);
+		fflush(0);
+		return false;
+	}
+
+	if (ftruncate(fd, size) == -1) {
+		printf("ftruncate %s failed\n", name);
+		fflush(0);
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+
+	void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (ptr == MAP_FAILED) {
+		printf("mmap %s failed\n", name);
+		fflush(0);
+		shm_unlink(name);
+		return false;
+	}
+
+	ShmSegment* segment = (ShmSegment*)ptr;
+	memset(ptr, 0, SHM_HEADER_SIZE);
+
+	segment->ring[SHM_RING_CLIENT_TO_SERVER].capacity = SHM_RING_SIZE_CLIENT_TO_SERVER;
+	segment->ring[SHM_RING_CLIENT_TO_SERVER].offset = SHM_HEADER_SIZE;
+	segment->ring[SHM_RING_SERVER_TO_CLIENT].capacity = ring_size_s2c;
+	segment->ring[SHM_RING_SERVER_TO_CLIENT].offset = SHM_HEADER_SIZE + SHM_RING_SIZE_CLIENT_TO_SERVER;
+	segment->magic.store(SHM_MAGIC);
+
+	g_segment[offset] = segment;
+	g_segment_size[offset] = size;
+
+	printf("listen on %s\n", name);
+	fflush(0);
+
+	// the equivalent of accept: wait for the client to map the segment
+	while (segment->attached.load() == 0) {
+		ring_wait(segment, segment->attached, segment->ring[SHM_RING_CLIENT_TO_SERVER].head_waiters, 0);
+	}
+
+	printf("accept on %s\n", name);
+	fflush(0);
+
+	return true;
+}
+
+bool ShmConnection::segment_open(int offset)
+{
+	char name[1200];
+	segment_name(name, offset);
+
+	int wait_count = 0;
+	ShmSegment* segment = NULL;
+	size_t size = 0;
+
+	while (segment == NULL) {
+		int fd = shm_open(name, O_RDWR, 0600);
+		struct stat st;
+
+		if (fd != -1 && fstat(fd, &st) == 0 && (size_t)st.st_size > SHM_HEADER_SIZE) {
+			size = st.st_size;
+			void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (ptr != MAP_FAILED) {
+				segment = (ShmSegment*)ptr;
+				if (segment->magic.load() != SHM_MAGIC || segment->attached.load() != 0) {
+					munmap(ptr, size);
+					segment = NULL;
+				}
+			}
+		}
+
+		if (fd != -1) {
+			close(fd);
+		}
+
+		// a connect timeout of 0 is one blocking attempt as with TCP, it waits for the segment without a deadline
+		if (segment == NULL) {
+			if (g_connect_timeout_sec > 0 && wait_count * 10 >= g_connect_timeout_sec * 1000) {
+				printf("shm segment %s not found\n", name);
+				fflush(0);
+				return false;
+			}
+
+			if (wait_count++ == 0) {
+				printf("wait on server %s\n", name);
+				fflush(0);
+			}
+			usleep(10000);
+		}
+	}
+
+	g_segment[offset] = segment;
+	g_segment_size[offset] = size;
+
+	ring_wake(segment->attached, segment->ring[SHM_RING_CLIENT_TO_SERVER].head_waiters);
+
+	printf("connect to %s\n", name);
+	fflush(0);
+
+	return true;
+}
+
+void ShmConnection::segment_close(int offset)
+{
+	ShmSegment* segment = g_segment[offset];
+	if (segment == NULL)
+		return;
+
+	// wake up the peer, it reports a connection error once its ring is drained
+	segment->closed.store(1);
+	for (int r = 0; r < 2; r++) {
+		ring_wake(segment->ring[r].head_seq, segment->ring[r].head_waiters);
+		ring_wake(segment->ring[r].tail_seq, segment->ring[r].tail_waiters);
+	}
+
+	munmap(segment, g_segment_size[offset]);
+
+	if (g_is_server) {
+		char name[1200];
+		segment_name(name, offset);
+		shm_unlink(name);
+	}
+
+	g_segment[offset] = NULL;
+	g_segment_size[offset] = 0;
+}
+
+// progress_time: the last progress of the transfer, which fails without progress for g_timeval_sec
+// (a peer that died without closing the segment), NULL waits without limit
+bool ShmConnection::ring_wait(ShmSegment* segment, std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters, uint32_t value,
+	const std::chrono::steady_clock::time_point* progress_time)
+{
+	for (int i = 0; i < SHM_SPIN_COUNT; i++) {
+		if (seq.load() != value)
+			return true;
+	}
+
+	if (segment->closed.load() != 0 && seq.load() == value)
+		return false;
+
+	if (progress_time != NULL && g_timeval_sec > 0 &&
+		std::chrono::steady_clock::now() - *progress_time >= std::chrono::seconds(g_timeval_sec)) {
+		printf("ring_wait: no progress for %d s\n", g_timeval_sec);
+		return false;
+	}
+
+	waiters.fetch_add(1);
+#ifdef __linux__
+	// shared futex, the segment is mapped by two processes
+	timespec ts;
+	ts.tv_sec = 0;
+	ts.tv_nsec = SHM_WAIT_TIMEOUT_MS * 1000000L;
+	syscall(SYS_futex, (uint32_t*)&seq, FUTEX_WAIT, value, &ts, NULL, 0);
+#else
+	usleep(100);
+#endif
+	waiters.fetch_sub(1);
+
+	// the caller checks the ring again, a closed peer is reported once nothing changes anymore
+	return true;
+}
+
+void ShmConnection::ring_wake(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters)
+{
+	seq.fetch_add(1);
+#ifdef __linux__
+	if (waiters.load() != 0) {
+		syscall(SYS_futex, (uint32_t*)&seq, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+	}
+#endif
+}
+
+bool ShmConnection::ring_write(ShmSegment* segment, ShmRing& ring, const char* data, size_t size)
+{
+	char* base = (char*)segment + ring.offset;
+	size_t written = 0;
+	std::chrono::steady_clock::time_point progress_time = std::chrono::steady_clock::now();
+
+	while (written < size) {
+		uint32_t seq = ring.tail_seq.load();
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		uint64_t free_size = ring.capacity - (head - ring.tail.load());
+
+		if (free_size == 0) {
+			if (!ring_wait(segment, ring.tail_seq, ring.tail_waiters, seq, &progress_time)) {
+				return false;
+			}
+			continue;
+		}
+
+		size_t chunk = (size - written < free_size) ? size - written : free_size;
+		size_t pos = head % ring.capacity;
+		size_t first = (chunk < ring.capacity - pos) ? chunk : ring.capacity - pos;
+
+		memcpy(base + pos, data + written, first);
+		memcpy(base, data + written + first, chunk - first);
+
+		ring.head.store(head + chunk);
+		ring_wake(ring.head_seq, ring.head_waiters);
+
+		written += chunk;
+		progress_time = std::chrono::steady_clock::now();
+	}
+
+	return true;
+}
+
+bool ShmConnection::ring_read(ShmSegment* segment, ShmRing& ring, char* data, size_t size)
+{
+	char* base = (char*)segment + ring.offset;
+	size_t read_size = 0;
+	std::chrono::steady_clock::time_point progress_time = std::chrono::steady_clock::now();
+
+	while (read_size < size) {
+		uint32_t seq = ring.head_seq.load();
+		uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+		uint64_t used_size = ring.head.load() - tail;
+
+		if (used_size == 0) {
+			if (!ring_wait(segment, ring.head_seq, ring.head_waiters, seq, &progress_time)) {
+				return false;
+			}
+			continue;
+		}
+
+		size_t chunk = (size - read_size < used_size) ? size - read_size : used_size;
+		size_t pos = tail % ring.capacity;
+		size_t first = (chunk < ring.capacity - pos) ? chunk : ring.capacity - pos;
+
+		memcpy(data + read_size, base + pos, first);
+		memcpy(data + read_size + first, base, chunk - first);
+
+		ring.tail.store(tail + chunk);
+		ring_wake(ring.tail_seq, ring.tail_waiters);
+
+		read_size += chunk;
+		progress_time = std::chrono::steady_clock::now();
+	}
+
+	return true;
+}
+
+// the size prefix of a message, a larger one than the maximum is a corrupt ring
+bool ShmConnection::ring_read_size(ShmSegment* segment, ShmRing& ring, uint64_t& size)
+{
+	if (!ring_read(segment, ring, (char*)&size, sizeof(uint64_t)))
+		return false;
+
+	if (size > g_max_message_size) {
+		printf("recv_data_data: message of %llu bytes exceeds the maximum of %llu\n", (unsigned long long)size, (unsigned long long)g_max_message_size);
+		return false;
+	}
+
+	return true;
+}
+
+void ShmConnection::init_sockets_data(const char* server, int port, bool is_server)
+{
+	g_is_server = is_server;
+	init_port();
+
+	if (is_shm_name(server)) {
+		// keep only characters allowed in a shm name
+		const char* name = server + strlen(SHM_PREFIX);
+		int len = 0;
+		for (; name[len] != 0 && len < 1000; len++) {
+			g_shm_name[len] = (name[len] == '/') ? '_' : name[len];
+		}
+		g_shm_name[len] = 0;
+	}
+
+	if (port != 0) {
+		g_shm_port = port;
+	}
+	else if (g_shm_port == 0) {
+		const char* env_p_port_data = std::getenv("SOCKET_SERVER_PORT_DATA");
+		g_shm_port = (env_p_port_data) ? atoi(env_p_port_data) : 7001;
+	}
+
+	if (g_segment[g_port_offset] == NULL) {
+		bool created = g_is_server ? segment_create(g_port_offset) : segment_open(g_port_offset);
+		if (!created) {
+			g_connection_error = 1;
+		}
+	}
+}
+
+bool ShmConnection::client_check()
+{
+	return g_segment[g_port_offset] != NULL;
+}
+
+bool ShmConnection::server_check()
+{
+	return g_segment[g_port_offset] != NULL;
+}
+
+void ShmConnection::interrupt_recv()
+{
+	if (g_port_offset < 0 || g_segment[g_port_offset] == NULL)
+		return;
+
+	// the peer sees the connection as closed too
+	ShmSegment* segment = g_segment[g_port_offset];
+	segment->closed.store(1);
+	for (int r = 0; r < 2; r++) {
+		ring_wake(segment->ring[r].head_seq, segment->ring[r].head_waiters);
+		ring_wake(segment->ring[r].tail_seq, segment->ring[r].tail_waiters);
+	}
+}
+
+void ShmConnection::client_close()
+{
+	for (int tid = 0; tid < MAX_CONNECTIONS; tid++) {
+		segment_close(tid);
+	}
+
+	TcpConnection::client_close();
+}
+
+void ShmConnection::server_close()
+{
+	for (int tid = 0; tid < MAX_CONNECTIONS; tid++) {
+		segment_close(tid);
+	}
+
+	TcpConnection::server_close();
+}
+
+void ShmConnection::send_data_data(char* data, size_t size, bool ack_enabled)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	ShmSegment* segment = g_segment[g_port_offset];
+	ShmRing& ring = segment->ring[g_is_server ? SHM_RING_SERVER_TO_CLIENT : SHM_RING_CLIENT_TO_SERVER];
+
+	// the ring is a byte stream, the size prefix keeps the message boundaries
+	uint64_t message_size = size;
+	if (!ring_write(segment, ring, (char*)&message_size, sizeof(uint64_t)) || !ring_write(segment, ring, data, size)) {
+		g_connection_error = 1;
+	}
+}
+
+void ShmConnection::recv_data_data(char* data, size_t size, bool ack_enabled)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	ShmSegment* segment = g_segment[g_port_offset];
+	ShmRing& ring = segment->ring[g_is_server ? SHM_RING_CLIENT_TO_SERVER : SHM_RING_SERVER_TO_CLIENT];
+
+	uint64_t message_size = 0;
+	if (!ring_read_size(segment, ring, message_size)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	if (message_size != size) {
+		printf("recv_data_data: size mismatch %lld != %lld\n", (long long)message_size, (long long)size);
+		g_connection_error = 1;
+		return;
+	}
+
+	if (!ring_read(segment, ring, data, size)) {
+		g_connection_error = 1;
+	}
+}
+
+void ShmConnection::send_data_striped(char* data, size_t size)
+{
+	send_data_data(data, size);
+}
+
+void ShmConnection::recv_data_striped(char* data, size_t size)
+{
+	recv_data_data(data, size);
+}
+
+void ShmConnection::send_data_gather(TcpBuffer* messages, int count, int channel)
+{
+	for (int i = 0; i < count && !is_error(); i++) {
+		send_data_data(messages[i].data, messages[i].size);
+	}
+}
+
+void ShmConnection::recv_data_scatter(TcpBuffer* messages, int count)
+{
+	for (int i = 0; i < count && !is_error(); i++) {
+		recv_data_data(messages[i].data, messages[i].size);
+	}
+}
+
+void ShmConnection::recv_data_scatter_sized(std::vector<char>* messages, int count)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	ShmSegment* segment = g_segment[g_port_offset];
+	ShmRing& ring = segment->ring[g_is_server ? SHM_RING_CLIENT_TO_SERVER : SHM_RING_SERVER_TO_CLIENT];
+
+	for (int i = 0; i < count; i++) {
+		uint64_t message_size = 0;
+		if (!ring_read_size(segment, ring, message_size)) {
+			g_connection_error = 1;
+			return;
+		}
+
+		messages[i].resize(message_size);
+		if (!ring_read(segment, ring, messages[i].data(), message_size)) {
+			g_connection_error = 1;
+			return;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,108 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_SHM_H__
+#define __RENDERENGINE_SHM_H__
+
+#include "renderengine_tcp.h"
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#define SHM_PREFIX "shm://"
+#define SHM_MAGIC 0x42525348 // "BRSH"
+
+#define SHM_RING_CLIENT_TO_SERVER 0
+#define SHM_RING_SERVER_TO_CLIENT 1
+
+// Single producer/single consumer byte ring. head and tail count all bytes ever
+// written/read, the *_seq words are futex words bumped on every change.
+typedef struct ShmRing {
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;
+	std::atomic<uint32_t> head_seq;
+	std::atomic<uint32_t> tail_seq;
+	std::atomic<uint32_t> head_waiters;
+	std::atomic<uint32_t> tail_waiters;
+	uint64_t capacity;
+	uint64_t offset; // data offset from the segment start
+} ShmRing;
+
+typedef struct ShmSegment {
+	std::atomic<uint32_t> magic;
+	std::atomic<uint32_t> attached;
+	std::atomic<uint32_t> closed;
+	uint32_t reserved;
+	ShmRing ring[2];
+} ShmSegment;
+
+// Transport for client and server on the same node: the data socket is replaced by
+// two rings in a POSIX shared memory segment named after the "shm://name" server and the port.
+class BRAAS_HPC_EXPORT_DLL ShmConnection : public TcpConnection {
+protected:
+	ShmSegment* g_segment[MAX_CONNECTIONS];
+	size_t g_segment_size[MAX_CONNECTIONS];
+
+	char g_shm_name[1024];
+	int g_shm_port = 0;
+
+public:
+	ShmConnection();
+
+	static bool is_shm_name(const char* server);
+
+	virtual void init_sockets_data(const char* server = NULL, int port = 0, bool is_server = true);
+
+	virtual bool client_check();
+	virtual bool server_check();
+
+	virtual void client_close();
+	virtual void server_close();
+
+	virtual void send_data_data(char* data, size_t size, bool ack = true);
+	virtual void recv_data_data(char* data, size_t size, bool ack = true);
+
+	virtual void send_data_striped(char* data, size_t size);
+	virtual void recv_data_striped(char* data, size_t size);
+
+	virtual void send_data_gather(TcpBuffer* messages, int count, int channel = -1);
+	virtual void recv_data_scatter(TcpBuffer* messages, int count);
+	virtual void recv_data_scatter_sized(std::vector<char>* messages, int count);
+
+	virtual bool is_full_duplex() { return true; }
+	virtual void interrupt_recv();
+
+protected:
+	void segment_name(char* name, int offset);
+	bool segment_create(int offset);
+	bool segment_open(int offset);
+	void segment_close(int offset);
+
+	bool ring_write(ShmSegment* segment, ShmRing& ring, const char* data, size_t size);
+	bool ring_read(ShmSegment* segment, ShmRing& ring, char* data, size_t size);
+	bool ring_read_size(ShmSegment* segment, ShmRing& ring, uint64_t& size);
+	bool ring_wait(ShmSegment* segment, std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters, uint32_t value,
+		const std::chrono::steady_clock::time_point* progress_time = NULL);
+	void ring_wake(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters);
+};
+
+#endif
+#endif
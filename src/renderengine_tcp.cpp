@@ -17,12 +17,24 @@
 // #####################################################################################################################
 
 #include "renderengine_tcp.h"
+#include "renderengine_color.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
+#include <thread>
+
+#ifndef _WIN32
+#  include <errno.h>
+#  include <fcntl.h>
+#endif
+
+#ifdef __linux__
+#  include <sys/epoll.h>
+#endif
 
 
 // #include <omp.h>
@@ -35,22 +47,43 @@
 #  define TCP_BLK_SIZE (1L * 1024L * 1024L * 1024L
 #  define TCP_MAX_SIZE (128L * 1024L * 1024L)
 
+#  define TCP_CLOSE_TIMEOUT_SEC 2
+
+#  define TCP_STRIPE_MIN_SIZE (256L * 1024L)
+
+#  define TCP_CONNECT_BACKOFF_MIN_MS 10
+#  define TCP_CONNECT_BACKOFF_MAX_MS 500
+
 
 #ifdef _WIN32
 #  define KERNEL_SOCKET_SEND(s, buf, len) send(s, buf, (int)len, 0)
 #  define KERNEL_SOCKET_RECV(s, buf, len) recv(s, buf, (int)len, 0)
 #  define KERNEL_SOCKET_SEND_IGNORE_RC(s, buf, len) send(s, buf, (int)len, 0)
 #  define KERNEL_SOCKET_RECV_IGNORE_RC(s, buf, len) recv(s, buf, (int)len, 0)
+#elif defined(MSG_NOSIGNAL)
+// the peer may close the connection with unacknowledged messages in flight (framed protocol),
+// report it as a connection error instead of SIGPIPE
+#  define KERNEL_SOCKET_SEND(s, buf, len) send(s, buf, len, MSG_NOSIGNAL); 
+#  define KERNEL_SOCKET_RECV(s, buf, len) read(s, buf, len); 
+#  define KERNEL_SOCKET_SEND_IGNORE_RC(s, buf, len) { auto rc = send(s, buf, len, MSG_NOSIGNAL); assert(rc == len); }
+#  define KERNEL_SOCKET_RECV_IGNORE_RC(s, buf, len) { auto rc = read(s, buf, len); assert(rc == len); }
+#  define KERNEL_SOCKET_SENDMSG_FLAGS MSG_NOSIGNAL
 #else
 #  define KERNEL_SOCKET_SEND(s, buf, len) write(s, buf, len); 
 #  define KERNEL_SOCKET_RECV(s, buf, len) read(s, buf, len); 
 #  define KERNEL_SOCKET_SEND_IGNORE_RC(s, buf, len) { auto rc = write(s, buf, len); assert(rc == len); }
 #  define KERNEL_SOCKET_RECV_IGNORE_RC(s, buf, len) { auto rc = read(s, buf, len); assert(rc == len); }
+#  define KERNEL_SOCKET_SENDMSG_FLAGS 0
 #endif
 
 TcpConnection::TcpConnection()
 {
 	init_port();
+
+	const char* env_connect_timeout = std::getenv("SOCKET_CONNECT_TIMEOUT_SEC");
+	if (env_connect_timeout != NULL) {
+		g_connect_timeout_sec = atoi(env_connect_timeout);
+	}
 }
 
 int TcpConnection::setsock_tcp_windowsize(int inSock, int inTCPWin, int inSend)
@@ -161,6 +194,10 @@ void TcpConnection::init_port()
 			g_client_id_cam[tid] = -1;
 			g_server_id_data[tid] = -1;
 			g_client_id_data[tid] = -1;
+
+			for (int s = 0; s < MAX_STRIPES; s++) {
+				g_client_id_stripe[tid][s] = -1;
+			}
 		}
 
 		g_connection_error = 0;
@@ -175,80 +212,110 @@ void TcpConnection::close_wsa()
 #  endif
 }
 
-bool TcpConnection::server_create(int port,
-	int& server_id,
-	int& client_id,
-	sockaddr_in& server_sock,
-	sockaddr_in& client_sock,
-	bool only_accept)
+bool TcpConnection::server_listen(int port, int& server_id, sockaddr_in& server_sock)
 {
-	init_port();
-
-	if (!only_accept) {
-		if (!init_wsa()) {
-			return false;
-		}
+	if (!init_wsa()) {
+		return false;
+	}
 
-		int type = SOCK_STREAM;
-		int protocol = IPPROTO_TCP;
+	int type = SOCK_STREAM;
+	int protocol = IPPROTO_TCP;
 
-		//#  ifdef WITH_SOCKET_UDP
-		//		type = SOCK_DGRAM;
-		//		protocol = IPPROTO_UDP;
-		//#  endif
+	//#  ifdef WITH_SOCKET_UDP
+	//		type = SOCK_DGRAM;
+	//		protocol = IPPROTO_UDP;
+	//#  endif
 
+	// dual stack, so IPv4 and IPv6 clients can connect
+	bool ipv6 = true;
+	server_id = socket(AF_INET6, type, protocol);
+	if (server_id == -1) {
+		ipv6 = false;
 		server_id = socket(AF_INET, type, protocol);
+	}
 
-		if (server_id == -1) {
-			printf("server_id == -1\n");
-			fflush(0);
-			return false;
-		}
+	if (server_id == -1) {
+		printf("server_id == -1\n");
+		fflush(0);
+		return false;
+	}
 
 #  if !defined(__MIC__) && !defined(WIN32)
-		int enable = 1;
-		setsockopt(server_id, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int));
+	int enable = 1;
+	setsockopt(server_id, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int));
 #  endif
 
-		// timeval tv;
-		// tv.tv_sec = g_timeval_sec;
-		// tv.tv_usec = 0;
-		// if (setsockopt(server_id, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(tv)) < 0) {
-		//  printf("setsockopt == -1\n");
-		//  fflush(0);
-		//  return false;
-		//}
-
-		// sockaddr_in sock_name;
-		memset(&server_sock, 0, sizeof(server_sock));
-		memset(&client_sock, 0, sizeof(client_sock));
-		server_sock.sin_family = AF_INET;
-		server_sock.sin_port = htons(port);
-		server_sock.sin_addr.s_addr = INADDR_ANY;
-
-		int err_bind = bind(server_id, (sockaddr*)&server_sock, sizeof(server_sock));
-		if (err_bind == -1) {
-			printf("err_bind == -1\n");
-			fflush(0);
-			return false;
-		}
+	// timeval tv;
+	// tv.tv_sec = g_timeval_sec;
+	// tv.tv_usec = 0;
+	// if (setsockopt(server_id, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(tv)) < 0) {
+	//  printf("setsockopt == -1\n");
+	//  fflush(0);
+	//  return false;
+	//}
+
+	// sockaddr_in sock_name;
+	memset(&server_sock, 0, sizeof(server_sock));
+	server_sock.sin_family = AF_INET;
+	server_sock.sin_port = htons(port);
+	server_sock.sin_addr.s_addr = INADDR_ANY;
+
+	int err_bind;
+	if (ipv6) {
+		int v6only = 0;
+		setsockopt(server_id, IPPROTO_IPV6, IPV6_V6ONLY, (char*)&v6only, sizeof(v6only));
+
+		sockaddr_in6 server_sock6;
+		memset(&server_sock6, 0, sizeof(server_sock6));
+		server_sock6.sin6_family = AF_INET6;
+		server_sock6.sin6_port = htons(port);
+		server_sock6.sin6_addr = in6addr_any;
+		err_bind = bind(server_id, (sockaddr*)&server_sock6, sizeof(server_sock6));
+	}
+	else {
+		err_bind = bind(server_id, (sockaddr*)&server_sock, sizeof(server_sock));
+	}
+	if (err_bind == -1) {
+		printf("err_bind == -1\n");
+		fflush(0);
+		return false;
+	}
+
+	//#  ifdef WITH_SOCKET_UDP
+	//		client_id = server_id;
+	//#  else
+
+	// the stripe connections of the client arrive right after the data connection
+	int err_listen = listen(server_id, MAX_STRIPES);
+	if (err_listen == -1) {
+		printf("err_listen == -1\n");
+		fflush(0);
+		return false;
+	}
+	//#    if defined(WITH_SOCKET_ONLY_DATA)
+	//		return true;
+	//#    endif
+
+	return true;
+}
 
-		//#  ifdef WITH_SOCKET_UDP
-		//		client_id = server_id;
-		//#  else
+bool TcpConnection::server_create(int port,
+	int& server_id,
+	int& client_id,
+	sockaddr_in& server_sock,
+	sockaddr_in& client_sock,
+	bool only_accept)
+{
+	init_port();
 
-		int err_listen = listen(server_id, 1);
-		if (err_listen == -1) {
-			printf("err_listen == -1\n");
-			fflush(0);
+	if (!only_accept) {
+		if (!server_listen(port, server_id, server_sock)) {
 			return false;
 		}
-		//#    if defined(WITH_SOCKET_ONLY_DATA)
-		//		return true;
-		//#    endif
+		memset(&client_sock, 0, sizeof(client_sock));
 	}
 
-	sockaddr_in client_info;
+	sockaddr_storage client_info;
 	socklen_t addr_len = sizeof(client_info);
 
 	printf("listen on %d\n", port);
@@ -259,10 +326,17 @@ bool TcpConnection::server_create(int port,
 		fflush(0);
 		return false;
 	}
+
+#  ifdef TCP_OPTIMIZATION
+	// as on the client side, a small message after a large one must not wait for the peer's delayed ACK
+	int nodelay = 1;
+	setsockopt(client_id, IPPROTO_TCP, TCP_NODELAY, (char*)&nodelay, sizeof(nodelay));
+#  endif
 	//#  endif
 
 		// printf("accept\n");
-	printf("accept on %d <-> %d\n", port, client_info.sin_port);
+	printf("accept on %d <-> %d\n", port, client_info.ss_family == AF_INET6 ?
+		((sockaddr_in6*)&client_info)->sin6_port : ((sockaddr_in*)&client_info)->sin_port);
 
 	fflush(0);
 
@@ -271,45 +345,25 @@ bool TcpConnection::server_create(int port,
 	return true;
 }
 
-bool TcpConnection::client_create(const char* server_name, int port, int& client_id, sockaddr_in& client_sock)
+bool TcpConnection::set_nonblocking(int id, bool enabled)
 {
-	// printf("connect to %s:%d\n", server_name, port);
-	init_port();
-
-	if (!init_wsa()) {
-		return false;
-	}
-
-	hostent* host = gethostbyname(server_name);
-	if (host == NULL) {
-		printf("host == NULL\n");
-		fflush(0);
+#  ifdef WIN32
+	u_long mode = enabled ? 1 : 0;
+	return ioctlsocket(id, FIONBIO, &mode) == 0;
+#  else
+	int flags = fcntl(id, F_GETFL, 0);
+	if (flags == -1)
 		return false;
-	}
-
-	int type = SOCK_STREAM;
-	int protocol = IPPROTO_TCP;
-
-	//#  ifdef WITH_SOCKET_UDP
-	//	type = SOCK_DGRAM;
-	//	protocol = IPPROTO_UDP;
-	//#  endif
+	return fcntl(id, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) == 0;
+#  endif
+}
 
-	client_id = socket(AF_INET, type, protocol);
-	if (client_id == -1) {
-		printf("client_id == -1\n");
-		fflush(0);
-		return false;
-	}
+int TcpConnection::connect_address(addrinfo* address, int timeout_ms)
+{
+	int client_id = (int)socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+	if (client_id == -1)
+		return -1;
 
-	// timeval tv;
-	// tv.tv_sec = g_timeval_sec;
-	// tv.tv_usec = 0;
-	// if (setsockopt(6client_id, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(tv)) < 0) {
-	//  printf("setsockopt == -1\n");
-	//  fflush(0);
-	//  return false;
-	//}
 	// netsh int tcp set global autotuninglevel=normal
 
 #  ifdef TCP_OPTIMIZATION
@@ -334,48 +388,125 @@ bool TcpConnection::client_create(const char* server_name, int port, int& client
 #    endif
 #  endif
 
-	// sockaddr_in client_sock;
-	memset(&client_sock, 0, sizeof(client_sock));
-	client_sock.sin_family = AF_INET;
-	client_sock.sin_port = htons(port);
-	memcpy(&(client_sock.sin_addr), host->h_addr, host->h_length);
+	// connect without blocking, so a missing server costs the backoff only and not the OS timeout
+	set_nonblocking(client_id, true);
+
+	int err_connect = connect(client_id, address->ai_addr, (int)address->ai_addrlen);
+	if (err_connect == -1) {
+#  ifdef WIN32
+		bool in_progress = WSAGetLastError() == WSAEWOULDBLOCK;
+#  else
+		bool in_progress = errno == EINPROGRESS;
+#  endif
+		if (in_progress) {
+			fd_set fds;
+			FD_ZERO(&fds);
+			FD_SET(client_id, &fds);
+
+			// timeout_ms < 0: until the OS gives up
+			timeval tv;
+			tv.tv_sec = timeout_ms / 1000;
+			tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+			int error = 0;
+			socklen_t error_len = sizeof(error);
+			if (select(client_id + 1, NULL, &fds, NULL, timeout_ms < 0 ? NULL : &tv) == 1 &&
+				getsockopt(client_id, SOL_SOCKET, SO_ERROR, (char*)&error, &error_len) == 0 && error == 0) {
+				err_connect = 0;
+			}
+		}
+	}
+
+	if (err_connect == -1) {
+		close_tcp(client_id);
+		return -1;
+	}
+
+	set_nonblocking(client_id, false);
+
+	return client_id;
+}
+
+bool TcpConnection::client_create(const char* server_name, int port, int& client_id, sockaddr_in& client_sock)
+{
+	// printf("connect to %s:%d\n", server_name, port);
+	init_port();
+
+	if (!init_wsa()) {
+		return false;
+	}
+
+	char port_name[16];
+	snprintf(port_name, sizeof(port_name), "%d", port);
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
 
-	//#  ifndef WITH_SOCKET_UDP
+	addrinfo* addresses = NULL;
+	if (getaddrinfo(server_name, port_name, &hints, &addresses) != 0 || addresses == NULL) {
+		printf("host == NULL\n");
+		fflush(0);
+		g_connection_error = 1;
+		return false;
+	}
 
+	// the first attempt is immediate, the server may not listen yet, so retry with
+	// exponential backoff until g_connect_timeout_sec. A timeout of 0 is a single
+	// attempt that waits as long as the OS lets connect wait.
+	bool retry = g_connect_timeout_sec > 0;
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = start_time + std::chrono::seconds(g_connect_timeout_sec);
+	int backoff_ms = TCP_CONNECT_BACKOFF_MIN_MS;
 	int connect_count = 0;
-	g_connection_error = 0;
 
-	while (true) {
-#    ifdef _WIN32
-		Sleep(2);
-#    else
-		usleep(2000000);
-#    endif
+	client_id = -1;
+	memset(&client_sock, 0, sizeof(client_sock));
 
-		int err_connect = connect(client_id, (sockaddr*)&client_sock, sizeof(client_sock));
-		if (client_id == -1) {
-			printf("disconnect\n");
-			return false;
+	while (client_id == -1) {
+		for (addrinfo* address = addresses; address != NULL && client_id == -1; address = address->ai_next) {
+			long long remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+
+			client_id = connect_address(address, !retry ? -1 : remaining_ms > 0 ? (int)remaining_ms : 0);
+			if (client_id != -1 && address->ai_family == AF_INET) {
+				memcpy(&client_sock, address->ai_addr, sizeof(client_sock));
+			}
 		}
 
-		connect_count++;
+		if (client_id != -1)
+			break;
 
-		if (connect_count < 2 && err_connect == -1) {
-			printf("%d: wait on server %s:%d\n", connect_count, server_name, port);
+		connect_count++;
+		long long remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+			deadline - std::chrono::steady_clock::now()).count();
+		if (!retry || remaining_ms <= 0) {
+			break;
+		}
 
-			//#      ifdef _WIN32
-			//      Sleep(2);
-			//#      else
-			//      usleep(2000000);
-			//#      endif
-			continue;
+		if (connect_count == 1) {
+			printf("wait on server %s:%d\n", server_name, port);
 		}
-		g_connection_error = err_connect;
-		break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms < remaining_ms ? backoff_ms : remaining_ms));
+		backoff_ms = (backoff_ms * 2 < TCP_CONNECT_BACKOFF_MAX_MS) ? backoff_ms * 2 : TCP_CONNECT_BACKOFF_MAX_MS;
+	}
+
+	freeaddrinfo(addresses);
+
+	if (client_id == -1) {
+		printf("connect to %s:%d failed\n", server_name, port);
+		fflush(0);
+		g_connection_error = 1;
+		return false;
 	}
-	//#  endif
 
-		// printf("connect\n");
+	g_connect_latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+	g_connection_error = 0;
+
+	// printf("connect\n");
 	printf("connect to %s:%d\n", server_name, port);
 	fflush(0);
 
@@ -391,6 +522,35 @@ void TcpConnection::close_tcp(int id)
 #  endif
 }
 
+void TcpConnection::close_tcp_graceful(int id)
+{
+	if (id == -1)
+		return;
+
+	// Without per-message ACKs the peer may still be reading our last messages while its
+	// ACK frames sit unread in our receive buffer. Closing with unread data resets the
+	// connection and drops the peer's unread messages, so drain it first.
+#  ifdef WIN32
+	shutdown(id, SD_SEND);
+	DWORD tv = TCP_CLOSE_TIMEOUT_SEC * 1000;
+#  else
+	shutdown(id, SHUT_WR);
+	timeval tv;
+	tv.tv_sec = TCP_CLOSE_TIMEOUT_SEC;
+	tv.tv_usec = 0;
+#  endif
+	setsockopt(id, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
+
+	char buf[4096];
+	while (true) {
+		int temp = KERNEL_SOCKET_RECV(id, buf, sizeof(buf));
+		if (temp < 1)
+			break;
+	}
+
+	close_tcp(id);
+}
+
 void TcpConnection::client_close()
 {
 	//#  if 0  // ndef _WIN32
@@ -399,17 +559,31 @@ void TcpConnection::client_close()
 	for (int tid = 0; tid < MAX_CONNECTIONS; tid++) {
 		// int tid = omp_get_thread_num();
 		close_tcp(g_client_id_cam[tid]);
-		close_tcp(g_client_id_data[tid]);
+		if (g_framed) {
+			close_tcp_graceful(g_client_id_data[tid]);
+		}
+		else {
+			close_tcp(g_client_id_data[tid]);
+		}
 
 		//g_server_id_cam[tid] = -1;
 		g_client_id_cam[tid] = -1;
 
 		//g_server_id_data[tid] = -1;
 		g_client_id_data[tid] = -1;
+
+		for (int s = 1; s < MAX_STRIPES; s++) {
+			close_tcp(g_client_id_stripe[tid][s]);
+			g_client_id_stripe[tid][s] = -1;
+		}
 	}
 
+	close_epoll();
+
 	g_connection_error = 0;
 	g_port_offset = -1;
+	g_channel = 0;
+	g_follow_channel = false;
 }
 
 void TcpConnection::server_close()
@@ -426,8 +600,14 @@ void TcpConnection::server_close()
 		g_server_id_data[tid] = -1;
 	}
 
+	close_tcp(g_server_id_viewer);
+	g_server_id_viewer = -1;
+
+	close_epoll();
+
 	g_connection_error = 0;
 	g_port_offset = -1;
+	g_channel = 0;
 
 	//close_wsa();
 }
@@ -515,8 +695,25 @@ void TcpConnection::init_sockets_data(const char* server, int port, bool is_serv
 	g_is_server = is_server;
 	init_port();
 
-	if (g_client_id_data[g_port_offset] == -1) {
+	// the sockets of another port offset (set_timestep) are opened on first use with the same server and port
+	if (server != NULL) {
+		strncpy(g_server_name, server, sizeof(g_server_name) - 1);
+	}
+	else if (g_server_name[0] != '\0') {
+		server = g_server_name;
+	}
+
+	if (port != 0) {
+		g_server_port = port;
+	}
+	else {
+		port = g_server_port;
+	}
+
+	// a failed connect is not retried on every send/recv
+	if (g_client_id_data[g_port_offset] == -1 && !is_error()) {
 		init_wsa();
+		reset_frame_state(g_port_offset);
 
 		//#  if (!defined(WITH_SOCKET_ONLY_DATA) && !defined(BLENDER_CLIENT) && \
 		//       !defined(WITH_CLIENT_MPI_VRCLIENT)) || \
@@ -558,6 +755,7 @@ void TcpConnection::init_sockets_data(const char* server, int port, bool is_serv
 						// int tid = omp_get_thread_num();
 			client_create(server_temp, port + g_port_offset, g_client_id_data[g_port_offset], g_client_sockaddr_data[g_port_offset]);
 			//}
+			init_sockets_stripes(server_temp, port + g_port_offset);
 	//#    endif
 			// char ack = -1;
 			// send_data_data(&ack, sizeof(ack));
@@ -609,6 +807,7 @@ void TcpConnection::init_sockets_data(const char* server, int port, bool is_serv
 				g_server_sockaddr_data[g_port_offset],
 				g_client_sockaddr_data[g_port_offset], false);
 			//}
+			init_sockets_stripes(NULL, port + g_port_offset);
 			// char ack = -1;
 			// recv_data_data(&ack, sizeof(ack));
 	//#    endif
@@ -617,73 +816,758 @@ void TcpConnection::init_sockets_data(const char* server, int port, bool is_serv
 	}
 }
 
-void TcpConnection::send_data_cam(char* data, size_t size, bool ack_enabled)
+void TcpConnection::init_sockets_stripes(const char* server, int port)
 {
-	DEBUG_PRINT(size);
-
-	init_sockets_cam();
-
-	if (is_error())
+	// the stripes of a message on a dropped channel could not be skipped
+	if (is_multiplexed())
 		return;
 
-	size_t sended_size = 0;
-
-	while (sended_size != size) {
-		size_t size_to_send = size - sended_size;
-		if (size_to_send > TCP_MAX_SIZE) {
-			size_to_send = TCP_MAX_SIZE;
+	// the additional stripe connections are accepted on the listening data socket,
+	// the client announces the stripe index of each connection
+	for (int s = 1; s < g_stripes; s++) {
+		if (!g_is_server) {
+			sockaddr_in client_sock;
+			if (!client_create(server, port, g_client_id_stripe[g_port_offset][s], client_sock) ||
+				!send_raw(g_client_id_stripe[g_port_offset][s], (char*)&s, sizeof(int))) {
+				g_connection_error = 1;
+				return;
+			}
 		}
-
-		int temp = KERNEL_SOCKET_SEND(g_client_id_cam[g_port_offset], (char*)data + sended_size, size_to_send);
-
-		if (temp < 1) {
-			g_connection_error = 1;
-			break;
+		else {
+			int client_id = -1;
+			int stripe = 0;
+			if (!server_create(port,
+				g_server_id_data[g_port_offset],
+				client_id,
+				g_server_sockaddr_data[g_port_offset],
+				g_client_sockaddr_data[g_port_offset], true) ||
+				!recv_raw(client_id, (char*)&stripe, sizeof(int)) || stripe < 1 || stripe >= g_stripes) {
+				printf("init_sockets_stripes: invalid stripe connection\n");
+				g_connection_error = 1;
+				return;
+			}
+			g_client_id_stripe[g_port_offset][stripe] = client_id;
 		}
-
-		sended_size += temp;
 	}
+}
 
-	if (ack_enabled) {
-		char ack = 0;
-		KERNEL_SOCKET_RECV_IGNORE_RC(g_client_id_cam[g_port_offset], &ack, 1);
-		if (ack != 0) {
-			printf("error in send_data_cam\n");
-			g_connection_error = 1;
-		}
+int TcpConnection::get_viewer_port(int port)
+{
+	if (port == 0) {
+		const char* env_p_port_data = std::getenv("SOCKET_SERVER_PORT_DATA");
+		port = (env_p_port_data) ? atoi(env_p_port_data) : 7001;
 	}
+
+	return port + TCP_VIEWER_PORT_OFFSET;
 }
 
-void TcpConnection::send_data_data(char* data, size_t size, bool ack_enabled)
+void TcpConnection::init_sockets_viewer(const char* server, int port)
 {
-	DEBUG_PRINT(size);
-
-	init_sockets_data();
+	// a viewer has the data connection only, port is the data port of the server
+	g_stripes = 1;
+	init_sockets_data(server, get_viewer_port(port), false);
 
-	if (is_error())
-		return;
+	g_follow_channel = true;
 
-	size_t sended_size = 0;
+	int hello = TCP_VIEWER_HELLO;
+	if (!is_error() && !send_raw(g_client_id_data[g_port_offset], (char*)&hello, sizeof(int))) {
+		g_connection_error = 1;
+	}
+}
 
-	while (sended_size != size) {
-		size_t size_to_send = size - sended_size;
-		if (size_to_send > TCP_MAX_SIZE) {
-			size_to_send = TCP_MAX_SIZE;
+bool TcpConnection::listen_viewers()
+{
+	if (g_server_id_viewer != -1)
+		return true;
+
+	int port = get_viewer_port(g_server_port);
+	if (!server_listen(port, g_server_id_viewer, g_server_sockaddr_viewer)) {
+		printf("listen_viewers: cannot listen on %d\n", port);
+		if (g_server_id_viewer != -1) {
+			close_tcp(g_server_id_viewer);
+			g_server_id_viewer = -1;
 		}
+		return false;
+	}
 
-		int temp = KERNEL_SOCKET_SEND(g_client_id_data[g_port_offset], (char*)data + sended_size, size_to_send);
+	printf("listen for viewers on %d\n", port);
+	fflush(0);
 
-		if (temp < 1) {
-			g_connection_error = 1;
-			break;
-		}
+	return true;
+}
 
-		sended_size += temp;
+int TcpConnection::accept_viewer(int timeout_ms)
+{
+	int server_id = g_server_id_viewer;
+	if (server_id == -1) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+		return -1;
 	}
 
-	if (ack_enabled) {
-		char ack = 0;
-		KERNEL_SOCKET_RECV_IGNORE_RC(g_client_id_data[g_port_offset], &ack, 1);
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(server_id, &fds);
+
+	timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	if (select(server_id + 1, &fds, NULL, NULL, &tv) < 1)
+		return -1;
+
+	sockaddr_storage client_info;
+	socklen_t addr_len = sizeof(client_info);
+	int client_id = accept(server_id, (sockaddr*)&client_info, &addr_len);
+	if (client_id == -1)
+		return -1;
+
+#  ifdef TCP_OPTIMIZATION
+	int nodelay = 1;
+	setsockopt(client_id, IPPROTO_TCP, TCP_NODELAY, (char*)&nodelay, sizeof(nodelay));
+#  endif
+
+	// a client that does not say hello must not block the accepting thread
+#  ifdef WIN32
+	DWORD hello_tv = TCP_CLOSE_TIMEOUT_SEC * 1000;
+#  else
+	timeval hello_tv;
+	hello_tv.tv_sec = TCP_CLOSE_TIMEOUT_SEC;
+	hello_tv.tv_usec = 0;
+#  endif
+	setsockopt(client_id, SOL_SOCKET, SO_RCVTIMEO, (char*)&hello_tv, sizeof(hello_tv));
+
+	int hello = 0;
+	int temp = KERNEL_SOCKET_RECV(client_id, (char*)&hello, sizeof(int));
+	if (temp != sizeof(int) || hello != TCP_VIEWER_HELLO) {
+		printf("accept_viewer: invalid viewer connection\n");
+		close_tcp(client_id);
+		return -1;
+	}
+
+#  ifdef WIN32
+	hello_tv = 0;
+#  else
+	hello_tv.tv_sec = 0;
+#  endif
+	setsockopt(client_id, SOL_SOCKET, SO_RCVTIMEO, (char*)&hello_tv, sizeof(hello_tv));
+
+	printf("accept viewer\n");
+	fflush(0);
+
+	return client_id;
+}
+
+void TcpConnection::attach_viewer(int client_id, TcpConnection* main)
+{
+	init_port();
+
+	g_is_server = true;
+	g_port_offset = 0;
+	g_stripes = 1;
+	g_framed = main->g_framed;
+	g_frame_window = main->g_frame_window;
+	g_multiplexed = main->g_multiplexed;
+	g_event_loop = main->g_event_loop;
+	g_timeval_sec = main->g_timeval_sec;
+
+	reset_frame_state(g_port_offset);
+	g_client_id_data[g_port_offset] = client_id;
+	g_connection_error = 0;
+}
+
+void TcpConnection::set_stripes(int stripes)
+{
+	if (stripes < 1) {
+		stripes = 1;
+	}
+	else if (stripes > MAX_STRIPES) {
+		printf("set_stripes: max. %d stripes are supported\n", MAX_STRIPES);
+		stripes = MAX_STRIPES;
+	}
+	g_stripes = stripes;
+}
+
+int TcpConnection::get_stripe_count(size_t size)
+{
+	if (is_multiplexed())
+		return 1;
+
+	// both sides derive the count from the message size only, small messages are not split
+	size_t stripes = size / TCP_STRIPE_MIN_SIZE;
+	if (stripes > (size_t)g_stripes) {
+		stripes = g_stripes;
+	}
+	return stripes > 1 ? (int)stripes : 1;
+}
+
+void TcpConnection::send_data_striped(char* data, size_t size)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	int stripes = get_stripe_count(size);
+	if (stripes == 1) {
+		send_data_data(data, size);
+		return;
+	}
+
+	size_t stripe_size = (size + stripes - 1) / stripes;
+	int error = 0;
+
+	if (g_event_loop) {
+		// one thread drives all stripe sockets together with stripe 0 of the message
+		TcpTransfer transfers[MAX_STRIPES];
+		for (int s = 1; s < stripes; s++) {
+			size_t offset = s * stripe_size;
+			transfers[s - 1].id = g_client_id_stripe[g_port_offset][s];
+			transfers[s - 1].data = data + offset;
+			transfers[s - 1].size = (offset + stripe_size < size) ? stripe_size : size - offset;
+			transfers[s - 1].done = 0;
+			transfers[s - 1].send = true;
+		}
+
+		send_message(data, stripe_size, true, transfers, stripes - 1);
+		return;
+	}
+
+	// stripe 0 goes through the data socket, so it carries the ACK/framing of the message
+#pragma omp parallel for num_threads(stripes)
+	for (int s = 0; s < stripes; s++) {
+		size_t offset = s * stripe_size;
+		size_t size_to_send = (offset + stripe_size < size) ? stripe_size : size - offset;
+
+		if (s == 0) {
+			send_data_data(data, size_to_send);
+		}
+		else if (!send_raw(g_client_id_stripe[g_port_offset][s], data + offset, size_to_send)) {
+#pragma omp atomic write
+			error = 1;
+		}
+	}
+
+	if (error) {
+		g_connection_error = 1;
+	}
+}
+
+void TcpConnection::recv_data_striped(char* data, size_t size)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	int stripes = get_stripe_count(size);
+	if (stripes == 1) {
+		recv_data_data(data, size);
+		return;
+	}
+
+	size_t stripe_size = (size + stripes - 1) / stripes;
+	int error = 0;
+
+	if (g_event_loop) {
+		TcpTransfer transfers[MAX_STRIPES];
+		for (int s = 1; s < stripes; s++) {
+			size_t offset = s * stripe_size;
+			transfers[s - 1].id = g_client_id_stripe[g_port_offset][s];
+			transfers[s - 1].data = data + offset;
+			transfers[s - 1].size = (offset + stripe_size < size) ? stripe_size : size - offset;
+			transfers[s - 1].done = 0;
+			transfers[s - 1].send = false;
+		}
+
+		recv_message(data, stripe_size, true, transfers, stripes - 1);
+		return;
+	}
+
+#pragma omp parallel for num_threads(stripes)
+	for (int s = 0; s < stripes; s++) {
+		size_t offset = s * stripe_size;
+		size_t size_to_recv = (offset + stripe_size < size) ? stripe_size : size - offset;
+
+		if (s == 0) {
+			recv_data_data(data, size_to_recv);
+		}
+		else if (!recv_raw(g_client_id_stripe[g_port_offset][s], data + offset, size_to_recv)) {
+#pragma omp atomic write
+			error = 1;
+		}
+	}
+
+	if (error) {
+		g_connection_error = 1;
+	}
+}
+
+bool TcpConnection::can_gather(TcpBuffer* messages, int count)
+{
+	if (!g_framed || count < 1 || count > TCP_GATHER_MAX)
+		return false;
+
+	// a striped message needs the parallel stripe sockets
+	for (int i = 0; i < count; i++) {
+		if (get_stripe_count(messages[i].size) > 1)
+			return false;
+	}
+
+	return true;
+}
+
+void TcpConnection::send_data_gather(TcpBuffer* messages, int count, int channel)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	// the legacy protocol waits for an ACK after every message
+	if (!can_gather(messages, count)) {
+		for (int i = 0; i < count && !is_error(); i++) {
+			send_data_striped(messages[i].data, messages[i].size);
+		}
+		return;
+	}
+
+	send_frame_gather(messages, count, channel < 0 ? (int)g_channel : channel);
+}
+
+void TcpConnection::recv_data_scatter(TcpBuffer* messages, int count)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	if (!can_gather(messages, count)) {
+		for (int i = 0; i < count && !is_error(); i++) {
+			recv_data_striped(messages[i].data, messages[i].size);
+		}
+		return;
+	}
+
+	recv_frame_scatter(messages, count);
+}
+
+void TcpConnection::recv_data_scatter_sized(std::vector<char>* messages, int count)
+{
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	TcpBuffer buffers[TCP_GATHER_MAX];
+	for (int i = 0; i < count && i < TCP_GATHER_MAX; i++) {
+		buffers[i].data = messages[i].data();
+		buffers[i].size = messages[i].size();
+	}
+
+	if (!can_gather(buffers, count)) {
+		recv_data_scatter(buffers, count);
+		return;
+	}
+
+	recv_frame_scatter_sized(messages, count);
+}
+
+bool TcpConnection::send_raw(int id, char* data, size_t size)
+{
+	if (g_event_loop) {
+		TcpTransfer t = { id, data, size, 0, true };
+		return transfer_event_loop(&t, 1);
+	}
+
+	size_t sended_size = 0;
+
+	while (sended_size != size) {
+		size_t size_to_send = size - sended_size;
+		if (size_to_send > TCP_MAX_SIZE) {
+			size_to_send = TCP_MAX_SIZE;
+		}
+
+		int temp = KERNEL_SOCKET_SEND(id, (char*)data + sended_size, size_to_send);
+
+		if (temp < 1) {
+			return false;
+		}
+
+		sended_size += temp;
+	}
+
+	return true;
+}
+
+bool TcpConnection::recv_raw(int id, char* data, size_t size)
+{
+	if (g_event_loop) {
+		TcpTransfer t = { id, data, size, 0, false };
+		return transfer_event_loop(&t, 1);
+	}
+
+	size_t sended_size = 0;
+
+	while (sended_size != size) {
+		size_t size_to_send = size - sended_size;
+		if (size_to_send > TCP_MAX_SIZE) {
+			size_to_send = TCP_MAX_SIZE;
+		}
+
+		int temp = KERNEL_SOCKET_RECV(id, (char*)data + sended_size, size_to_send);
+
+		if (temp < 1) {
+			return false;
+		}
+
+		sended_size += temp;
+	}
+
+	return true;
+}
+
+bool TcpConnection::send_raw_gather(int id, TcpBuffer* buffers, int count)
+{
+#ifdef _WIN32
+	for (int i = 0; i < count; i++) {
+		if (!send_raw(id, buffers[i].data, buffers[i].size))
+			return false;
+	}
+	return true;
+#else
+	if (g_event_loop) {
+		for (int i = 0; i < count; i++) {
+			if (!send_raw(id, buffers[i].data, buffers[i].size))
+				return false;
+		}
+		return true;
+	}
+
+	iovec iov[2 * TCP_GATHER_MAX + 1];
+	for (int i = 0; i < count; i++) {
+		iov[i].iov_base = buffers[i].data;
+		iov[i].iov_len = buffers[i].size;
+	}
+
+	int first = 0;
+	while (first < count) {
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov + first;
+		msg.msg_iovlen = count - first;
+
+		ssize_t temp = sendmsg(id, &msg, KERNEL_SOCKET_SENDMSG_FLAGS);
+		if (temp < 1) {
+			if (temp == -1 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		// skip the buffers written completely, the next call continues inside a partial one
+		size_t sent = (size_t)temp;
+		while (first < count && sent >= iov[first].iov_len) {
+			sent -= iov[first].iov_len;
+			first++;
+		}
+		if (first < count) {
+			iov[first].iov_base = (char*)iov[first].iov_base + sent;
+			iov[first].iov_len -= sent;
+		}
+	}
+
+	return true;
+#endif
+}
+
+bool TcpConnection::recv_raw_scatter(int id, TcpBuffer* buffers, int count)
+{
+#ifdef _WIN32
+	for (int i = 0; i < count; i++) {
+		if (!recv_raw(id, buffers[i].data, buffers[i].size))
+			return false;
+	}
+	return true;
+#else
+	if (g_event_loop) {
+		for (int i = 0; i < count; i++) {
+			if (!recv_raw(id, buffers[i].data, buffers[i].size))
+				return false;
+		}
+		return true;
+	}
+
+	iovec iov[2 * TCP_GATHER_MAX + 1];
+	for (int i = 0; i < count; i++) {
+		iov[i].iov_base = buffers[i].data;
+		iov[i].iov_len = buffers[i].size;
+	}
+
+	int first = 0;
+	while (first < count) {
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov + first;
+		msg.msg_iovlen = count - first;
+
+		ssize_t temp = recvmsg(id, &msg, MSG_WAITALL);
+		if (temp < 1) {
+			if (temp == -1 && errno == EINTR)
+				continue;
+			return false;
+		}
+
+		size_t received = (size_t)temp;
+		while (first < count && received >= iov[first].iov_len) {
+			received -= iov[first].iov_len;
+			first++;
+		}
+		if (first < count) {
+			iov[first].iov_base = (char*)iov[first].iov_base + received;
+			iov[first].iov_len -= received;
+		}
+	}
+
+	return true;
+#endif
+}
+
+bool TcpConnection::transfer(TcpTransfer* transfers, int count)
+{
+	if (g_event_loop) {
+		return transfer_event_loop(transfers, count);
+	}
+
+	for (int i = 0; i < count; i++) {
+		TcpTransfer& t = transfers[i];
+		if (!(t.send ? send_raw(t.id, t.data + t.done, t.size - t.done) : recv_raw(t.id, t.data + t.done, t.size - t.done))) {
+			return false;
+		}
+		t.done = t.size;
+	}
+
+	return true;
+}
+
+void TcpConnection::set_event_loop(bool enabled)
+{
+#ifdef __linux__
+	g_event_loop = enabled;
+#else
+	if (enabled) {
+		printf("set_event_loop: the event loop is only supported on Linux\n");
+	}
+	g_event_loop = false;
+#endif
+
+	const char* env_timeout = std::getenv("SOCKET_TIMEOUT_SEC");
+	if (env_timeout != NULL) {
+		g_timeval_sec = atoi(env_timeout);
+	}
+}
+
+// Advances all transfers with non-blocking calls and waits in epoll while none of
+// them can progress. The transfers fail when none of them progresses for g_timeval_sec.
+bool TcpConnection::transfer_event_loop(TcpTransfer* transfers, int count)
+{
+#ifdef __linux__
+	int epoll_id = -1;
+	bool registered[MAX_STRIPES] = {};
+	bool result = false;
+	std::chrono::steady_clock::time_point progress_time = std::chrono::steady_clock::now();
+
+	while (true) {
+		int active = 0;
+
+		for (int i = 0; i < count; i++) {
+			TcpTransfer& t = transfers[i];
+
+			while (t.done != t.size) {
+				size_t size_to_transfer = t.size - t.done;
+				if (size_to_transfer > TCP_MAX_SIZE) {
+					size_to_transfer = TCP_MAX_SIZE;
+				}
+
+				ssize_t temp = t.send ? send(t.id, t.data + t.done, size_to_transfer, MSG_NOSIGNAL | MSG_DONTWAIT) :
+					recv(t.id, t.data + t.done, size_to_transfer, MSG_DONTWAIT);
+
+				if (temp > 0) {
+					t.done += temp;
+					progress_time = std::chrono::steady_clock::now();
+					continue;
+				}
+
+				if (temp == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+					goto done;
+				}
+
+				if (errno != EINTR)
+					break;
+			}
+
+			if (t.done != t.size) {
+				active++;
+			}
+			else if (registered[i]) {
+				// a finished socket stays ready and would wake up every epoll_wait
+				epoll_ctl(epoll_id, EPOLL_CTL_DEL, t.id, NULL);
+				registered[i] = false;
+			}
+		}
+
+		if (active == 0) {
+			result = true;
+			break;
+		}
+
+		int timeout_ms = -1;
+		if (g_timeval_sec > 0) {
+			long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - progress_time).count();
+			if (elapsed >= g_timeval_sec * 1000LL) {
+				printf("transfer_event_loop: no progress for %d s\n", g_timeval_sec);
+				break;
+			}
+			timeout_ms = (int)(g_timeval_sec * 1000LL - elapsed);
+		}
+
+		// the pending transfers join the epoll set on the first wait
+		if (epoll_id == -1) {
+			epoll_id = acquire_epoll();
+			if (epoll_id == -1) {
+				printf("transfer_event_loop: epoll_create1 failed\n");
+				break;
+			}
+
+			for (int i = 0; i < count; i++) {
+				if (transfers[i].done == transfers[i].size)
+					continue;
+
+				epoll_event ev;
+				ev.events = transfers[i].send ? EPOLLOUT : EPOLLIN;
+				ev.data.u32 = i;
+				if (epoll_ctl(epoll_id, EPOLL_CTL_ADD, transfers[i].id, &ev) == -1) {
+					printf("transfer_event_loop: epoll_ctl failed\n");
+					goto done;
+				}
+				registered[i] = true;
+			}
+		}
+
+		epoll_event events[MAX_STRIPES];
+		int ready = epoll_wait(epoll_id, events, MAX_STRIPES, timeout_ms);
+		if (ready == -1 && errno != EINTR) {
+			break;
+		}
+	}
+
+done:
+	if (epoll_id != -1) {
+		// the set goes back empty, so the next call of any thread can reuse it
+		for (int i = 0; i < count; i++) {
+			if (registered[i]) {
+				epoll_ctl(epoll_id, EPOLL_CTL_DEL, transfers[i].id, NULL);
+			}
+		}
+		release_epoll(epoll_id);
+	}
+
+	return result;
+#else
+	return false;
+#endif
+}
+
+int TcpConnection::acquire_epoll()
+{
+#ifdef __linux__
+	{
+		std::lock_guard<std::mutex> lock(g_epoll_mutex);
+		if (!g_epoll_free.empty()) {
+			int epoll_id = g_epoll_free.back();
+			g_epoll_free.pop_back();
+			return epoll_id;
+		}
+	}
+
+	return epoll_create1(EPOLL_CLOEXEC);
+#else
+	return -1;
+#endif
+}
+
+void TcpConnection::release_epoll(int epoll_id)
+{
+	std::lock_guard<std::mutex> lock(g_epoll_mutex);
+	g_epoll_free.push_back(epoll_id);
+}
+
+void TcpConnection::close_epoll()
+{
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(g_epoll_mutex);
+	for (size_t i = 0; i < g_epoll_free.size(); i++) {
+		close(g_epoll_free[i]);
+	}
+	g_epoll_free.clear();
+#endif
+}
+
+void TcpConnection::send_data_cam(char* data, size_t size, bool ack_enabled)
+{
+	DEBUG_PRINT(size);
+
+	init_sockets_cam();
+
+	if (is_error())
+		return;
+
+	if (!send_raw(g_client_id_cam[g_port_offset], data, size)) {
+		g_connection_error = 1;
+	}
+
+	if (ack_enabled) {
+		char ack = 0;
+		KERNEL_SOCKET_RECV_IGNORE_RC(g_client_id_cam[g_port_offset], &ack, 1);
+		if (ack != 0) {
+			printf("error in send_data_cam\n");
+			g_connection_error = 1;
+		}
+	}
+}
+
+void TcpConnection::send_data_data(char* data, size_t size, bool ack_enabled)
+{
+	DEBUG_PRINT(size);
+
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	send_message(data, size, ack_enabled, NULL, 0);
+}
+
+void TcpConnection::send_message(char* data, size_t size, bool ack_enabled, TcpTransfer* extra, int extra_count)
+{
+	if (g_framed) {
+		send_frame_data(data, size, extra, extra_count);
+		return;
+	}
+
+	TcpTransfer transfers[MAX_STRIPES];
+	transfers[0] = { g_client_id_data[g_port_offset], data, size, 0, true };
+	for (int i = 0; i < extra_count; i++) {
+		transfers[i + 1] = extra[i];
+	}
+
+	if (!transfer(transfers, extra_count + 1)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	if (ack_enabled) {
+		char ack = 0;
+		KERNEL_SOCKET_RECV_IGNORE_RC(g_client_id_data[g_port_offset], &ack, 1);
 		if (ack != 0) {
 			printf("error in g_client_id_data\n");
 			g_connection_error = 1;
@@ -691,78 +1575,517 @@ void TcpConnection::send_data_data(char* data, size_t size, bool ack_enabled)
 	}
 }
 
-void TcpConnection::recv_data_cam(char* data, size_t size, bool ack_enabled)
+void TcpConnection::recv_data_cam(char* data, size_t size, bool ack_enabled)
+{
+	DEBUG_PRINT(size);
+
+	init_sockets_cam();
+
+	if (is_error())
+		return;
+
+	if (!recv_raw(g_client_id_cam[g_port_offset], data, size)) {
+		g_connection_error = 1;
+	}
+
+	if (ack_enabled) {
+		char ack = 0;
+		KERNEL_SOCKET_SEND_IGNORE_RC(g_client_id_cam[g_port_offset], &ack, 1);
+		if (ack != 0) {
+			printf("error in g_client_id_cam\n");
+			g_connection_error = 1;
+		}
+	}
+}
+
+void TcpConnection::recv_data_data(char* data, size_t size, bool ack_enabled)
+{
+	DEBUG_PRINT(size);
+
+	init_sockets_data(NULL, 0, g_is_server);
+
+	if (is_error())
+		return;
+
+	recv_message(data, size, ack_enabled, NULL, 0);
+}
+
+void TcpConnection::recv_message(char* data, size_t size, bool ack_enabled, TcpTransfer* extra, int extra_count)
+{
+	if (g_framed) {
+		recv_frame_data(data, size, extra, extra_count);
+		return;
+	}
+
+	TcpTransfer transfers[MAX_STRIPES];
+	transfers[0] = { g_client_id_data[g_port_offset], data, size, 0, false };
+	for (int i = 0; i < extra_count; i++) {
+		transfers[i + 1] = extra[i];
+	}
+
+	if (!transfer(transfers, extra_count + 1)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	if (ack_enabled) {
+		char ack = 0;
+		KERNEL_SOCKET_SEND_IGNORE_RC(g_client_id_data[g_port_offset], &ack, 1);
+		if (ack != 0) {
+			printf("error in g_client_id_data\n");
+			g_connection_error = 1;
+		}
+	}
+}
+
+void TcpConnection::interrupt_recv()
+{
+	if (g_port_offset < 0)
+		return;
+
+#  ifdef WIN32
+	int how = SD_RECEIVE;
+#  else
+	int how = SHUT_RD;
+#  endif
+
+	if (g_client_id_data[g_port_offset] != -1) {
+		shutdown(g_client_id_data[g_port_offset], how);
+	}
+
+	for (int s = 1; s < MAX_STRIPES; s++) {
+		if (g_client_id_stripe[g_port_offset][s] != -1) {
+			shutdown(g_client_id_stripe[g_port_offset][s], how);
+		}
+	}
+}
+
+/////////////////////////
+// Framed protocol: every message is prefixed by a TcpFrameHeader and the
+// per-message ACK is replaced by a cumulative one. The sender only blocks when
+// g_frame_window messages are unacknowledged.
+
+void TcpConnection::set_framed(bool enabled)
+{
+	g_framed = enabled;
+
+	const char* env_window = std::getenv("SOCKET_FRAMED_WINDOW");
+	if (env_window != NULL) {
+		g_frame_window = atoi(env_window);
+		if (g_frame_window < 0) {
+			g_frame_window = 0;
+		}
+	}
+}
+
+void TcpConnection::reset_frame_state(int offset)
+{
+	TcpFrameState& state = g_frame_state[offset];
+	state.send_seq = 0;
+	state.send_acked = 0;
+	state.recv_seq = 0;
+	state.recv_acked = 0;
+	state.pending.clear();
+}
+
+bool TcpConnection::recv_frame_header(int id, TcpFrameState& state, TcpFrameHeader& header)
+{
+	if (!recv_raw(id, (char*)&header, sizeof(TcpFrameHeader))) {
+		return false;
+	}
+
+	return check_frame_header(state, header);
+}
+
+bool TcpConnection::check_frame_header(TcpFrameState& state, TcpFrameHeader& header)
+{
+	if (header.magic != TCP_FRAME_MAGIC) {
+		printf("recv_frame_header: invalid magic %x\n", header.magic);
+		return false;
+	}
+
+	// checked before anything is allocated or read for the payload
+	if (header.size > g_max_message_size) {
+		printf("recv_frame_header: message of %llu bytes exceeds the maximum of %llu\n", header.size, (unsigned long long)g_max_message_size);
+		return false;
+	}
+
+	// the acknowledgement is cumulative, so a stale one must not move the window back
+	if ((int)(header.ack - state.send_acked) > 0) {
+		std::lock_guard<std::mutex> lock(g_frame_state_mutex);
+		state.send_acked = header.ack;
+		g_frame_cv.notify_all();
+	}
+
+	if (TCP_FRAME_KIND(header.type) == TCP_FRAME_DATA) {
+		if (header.seq != state.recv_seq + 1) {
+			printf("recv_frame_header: unexpected sequence %u, expected %u\n", header.seq, state.recv_seq + 1);
+			return false;
+		}
+		state.recv_seq = header.seq;
+	}
+
+	return true;
+}
+
+bool TcpConnection::send_frame_ack(int id, TcpFrameState& state)
 {
-	DEBUG_PRINT(size);
+	int ack_interval = g_frame_window / 2;
+	if (g_frame_window == 0 || (int)(state.recv_seq - state.recv_acked) < (ack_interval > 0 ? ack_interval : 1)) {
+		return true;
+	}
 
-	init_sockets_cam();
+	std::lock_guard<std::mutex> lock(g_frame_send_mutex);
 
-	if (is_error())
-		return;
+	TcpFrameHeader header;
+	header.magic = TCP_FRAME_MAGIC;
+	header.type = TCP_FRAME_ACK;
+	header.seq = state.send_seq;
+	header.ack = state.recv_seq;
+	header.size = 0;
+	state.recv_acked = header.ack;
 
-	size_t sended_size = 0;
+	return send_raw(id, (char*)&header, sizeof(TcpFrameHeader));
+}
 
-	while (sended_size != size) {
-		size_t size_to_send = size - sended_size;
-		if (size_to_send > TCP_MAX_SIZE) {
-			size_to_send = TCP_MAX_SIZE;
+bool TcpConnection::read_ahead_frame(int id, TcpFrameState& state)
+{
+	TcpFrameHeader header;
+	if (!recv_frame_header(id, state, header)) {
+		return false;
+	}
+
+	if (TCP_FRAME_KIND(header.type) == TCP_FRAME_DATA) {
+		// keep the message for the next recv_frame_data and acknowledge it,
+		// otherwise both sides could wait for each other with a full window
+		state.pending.push_back(TcpFrameMessage());
+		state.pending.back().channel = TCP_FRAME_CHANNEL(header.type);
+		state.pending.back().data.resize(header.size);
+		if (!recv_raw(id, state.pending.back().data.data(), header.size)) {
+			return false;
 		}
 
-		int temp = KERNEL_SOCKET_RECV(g_client_id_cam[g_port_offset], (char*)data + sended_size, size_to_send);
+		send_frame_ack(id, state);
+	}
 
-		if (temp < 1) {
-			g_connection_error = 1;
+	return true;
+}
+
+bool TcpConnection::accept_frame_channel(unsigned int message_channel, int& channel)
+{
+	if (!is_multiplexed())
+		return true;
+
+	// channel is -1 until the first message of a call, the next ones have to match it
+	if (channel == -1) {
+		if (!g_is_server && !g_follow_channel && message_channel != (unsigned int)g_channel)
+			return false;
+
+		channel = (int)message_channel;
+		g_channel = channel;
+		return true;
+	}
+
+	return message_channel == (unsigned int)channel;
+}
+
+bool TcpConnection::skip_frame_payload(int id, size_t size)
+{
+	char buffer[64 * 1024];
+	while (size > 0) {
+		size_t size_to_recv = size < sizeof(buffer) ? size : sizeof(buffer);
+		if (!recv_raw(id, buffer, size_to_recv))
+			return false;
+		size -= size_to_recv;
+	}
+	return true;
+}
+
+bool TcpConnection::recv_frame_next(int id, TcpFrameState& state, TcpFrameHeader& header, int& channel, bool have_header)
+{
+	// reads up to the next data message of the channel, messages of other channels are
+	// stale (the timestep was changed) and are dropped
+	while (true) {
+		if (!have_header && !recv_frame_header(id, state, header))
+			return false;
+		have_header = false;
+
+		if (TCP_FRAME_KIND(header.type) != TCP_FRAME_DATA)
+			continue;
+
+		if (accept_frame_channel(TCP_FRAME_CHANNEL(header.type), channel))
+			return true;
+
+		if (!skip_frame_payload(id, header.size))
+			return false;
+
+		send_frame_ack(id, state);
+	}
+}
+
+bool TcpConnection::wait_frame_window(int id, TcpFrameState& state, int count)
+{
+	// more messages than the window at once need an empty window
+	while (g_frame_window > 0) {
+		int in_flight = (int)(state.send_seq - state.send_acked);
+		if (in_flight + count <= g_frame_window || (count > g_frame_window && in_flight == 0))
 			break;
+
+		std::unique_lock<std::mutex> recv_lock(g_frame_recv_mutex, std::try_to_lock);
+		if (recv_lock.owns_lock()) {
+			if (!read_ahead_frame(id, state)) {
+				g_connection_error = 1;
+				return false;
+			}
+		}
+		else {
+			// another thread is reading the socket and processes the ACKs for us
+			std::unique_lock<std::mutex> lock(g_frame_state_mutex);
+			g_frame_cv.wait_for(lock, std::chrono::milliseconds(10));
 		}
 
-		sended_size += temp;
+		if (is_error())
+			return false;
 	}
 
-	if (ack_enabled) {
-		char ack = 0;
-		KERNEL_SOCKET_SEND_IGNORE_RC(g_client_id_cam[g_port_offset], &ack, 1);
-		if (ack != 0) {
-			printf("error in g_client_id_cam\n");
+	return true;
+}
+
+void TcpConnection::send_frame_data(char* data, size_t size, TcpTransfer* extra, int extra_count)
+{
+	int id = g_client_id_data[g_port_offset];
+	TcpFrameState& state = g_frame_state[g_port_offset];
+
+	if (!wait_frame_window(id, state, 1))
+		return;
+
+	std::lock_guard<std::mutex> lock(g_frame_send_mutex);
+
+	TcpFrameHeader header;
+	header.magic = TCP_FRAME_MAGIC;
+	header.type = TCP_FRAME_DATA | ((unsigned int)g_channel << TCP_FRAME_CHANNEL_SHIFT);
+	header.seq = ++state.send_seq;
+	header.ack = state.recv_seq;
+	header.size = size;
+	state.recv_acked = header.ack;
+
+	if (extra_count == 0) {
+		// header and payload in one call, so a small message is one segment
+		TcpBuffer buffers[2] = { { (char*)&header, sizeof(TcpFrameHeader) }, { data, size } };
+		if (!send_raw_gather(id, buffers, 2)) {
 			g_connection_error = 1;
 		}
+		return;
+	}
+
+	TcpTransfer transfers[MAX_STRIPES];
+	transfers[0] = { id, data, size, 0, true };
+	for (int i = 0; i < extra_count; i++) {
+		transfers[i + 1] = extra[i];
+	}
+
+	if (!send_raw(id, (char*)&header, sizeof(TcpFrameHeader)) || !transfer(transfers, extra_count + 1)) {
+		g_connection_error = 1;
 	}
 }
 
-void TcpConnection::recv_data_data(char* data, size_t size, bool ack_enabled)
+int TcpConnection::pop_pending_frame(TcpFrameState& state, char* data, size_t size, int& channel)
 {
-	DEBUG_PRINT(size);
+	while (!state.pending.empty()) {
+		TcpFrameMessage& message = state.pending.front();
+		if (!accept_frame_channel(message.channel, channel)) {
+			state.pending.pop_front();
+			continue;
+		}
 
-	init_sockets_data();
+		if (message.data.size() != size) {
+			printf("recv_frame_data: size mismatch %lld != %lld\n", (long long)message.data.size(), (long long)size);
+			return -1;
+		}
 
-	if (is_error())
+		memcpy(data, message.data.data(), size);
+		state.pending.pop_front();
+		return 1;
+	}
+
+	return 0;
+}
+
+void TcpConnection::recv_frame_data(char* data, size_t size, TcpTransfer* extra, int extra_count)
+{
+	int id = g_client_id_data[g_port_offset];
+	TcpFrameState& state = g_frame_state[g_port_offset];
+	int channel = -1;
+
+	std::lock_guard<std::mutex> recv_lock(g_frame_recv_mutex);
+
+	int popped = pop_pending_frame(state, data, size, channel);
+	if (popped != 0) {
+		if (popped < 0 || (extra_count > 0 && !transfer(extra, extra_count))) {
+			g_connection_error = 1;
+		}
 		return;
+	}
 
-	size_t sended_size = 0;
+	TcpFrameHeader header;
+	if (!recv_frame_next(id, state, header, channel)) {
+		g_connection_error = 1;
+		return;
+	}
 
-	while (sended_size != size) {
-		size_t size_to_send = size - sended_size;
-		if (size_to_send > TCP_MAX_SIZE) {
-			size_to_send = TCP_MAX_SIZE;
+	if (header.size != size) {
+		printf("recv_frame_data: size mismatch %lld != %lld\n", (long long)header.size, (long long)size);
+		g_connection_error = 1;
+		return;
+	}
+
+	TcpTransfer transfers[MAX_STRIPES];
+	transfers[0] = { id, data, size, 0, false };
+	for (int i = 0; i < extra_count; i++) {
+		transfers[i + 1] = extra[i];
+	}
+
+	if (!transfer(transfers, extra_count + 1)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	// the peer may already be gone after its last message, a lost ACK is not an error here
+	send_frame_ack(id, state);
+}
+
+void TcpConnection::send_frame_gather(TcpBuffer* messages, int count, int channel)
+{
+	int id = g_client_id_data[g_port_offset];
+	TcpFrameState& state = g_frame_state[g_port_offset];
+
+	if (!wait_frame_window(id, state, count))
+		return;
+
+	std::lock_guard<std::mutex> lock(g_frame_send_mutex);
+
+	TcpFrameHeader headers[TCP_GATHER_MAX];
+	TcpBuffer buffers[2 * TCP_GATHER_MAX];
+
+	for (int i = 0; i < count; i++) {
+		headers[i].magic = TCP_FRAME_MAGIC;
+		headers[i].type = TCP_FRAME_DATA | ((unsigned int)channel << TCP_FRAME_CHANNEL_SHIFT);
+		headers[i].seq = ++state.send_seq;
+		headers[i].ack = state.recv_seq;
+		headers[i].size = messages[i].size;
+
+		buffers[2 * i] = { (char*)&headers[i], sizeof(TcpFrameHeader) };
+		buffers[2 * i + 1] = messages[i];
+	}
+	state.recv_acked = headers[count - 1].ack;
+
+	if (!send_raw_gather(id, buffers, 2 * count)) {
+		g_connection_error = 1;
+	}
+}
+
+void TcpConnection::recv_frame_scatter(TcpBuffer* messages, int count)
+{
+	int id = g_client_id_data[g_port_offset];
+	TcpFrameState& state = g_frame_state[g_port_offset];
+	int channel = -1; // all messages of the call are of the channel of the first one
+
+	std::lock_guard<std::mutex> recv_lock(g_frame_recv_mutex);
+
+	int i = 0;
+	for (; i < count; i++) {
+		int popped = pop_pending_frame(state, messages[i].data, messages[i].size, channel);
+		if (popped < 0) {
+			g_connection_error = 1;
+			return;
 		}
+		if (popped == 0)
+			break;
+	}
 
-		int temp = KERNEL_SOCKET_RECV(g_client_id_data[g_port_offset], (char*)data + sended_size, size_to_send);
+	if (i == count)
+		return;
 
-		if (temp < 1) {
+	TcpFrameHeader header;
+	if (!recv_frame_next(id, state, header, channel)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	for (; i < count; i++) {
+		if (header.size != messages[i].size) {
+			printf("recv_frame_scatter: size mismatch %lld != %lld\n", (long long)header.size, (long long)messages[i].size);
+			g_connection_error = 1;
+			return;
+		}
+
+		// the payload and the header of the next message are read by one call
+		TcpBuffer buffers[2] = { messages[i], { (char*)&header, sizeof(TcpFrameHeader) } };
+		bool last = (i + 1 == count);
+		if (!recv_raw_scatter(id, buffers, last ? 1 : 2)) {
 			g_connection_error = 1;
+			return;
+		}
+
+		if (last)
 			break;
+
+		if (!check_frame_header(state, header) || !recv_frame_next(id, state, header, channel, true)) {
+			g_connection_error = 1;
+			return;
 		}
+	}
 
-		sended_size += temp;
+	send_frame_ack(id, state);
+}
+
+void TcpConnection::recv_frame_scatter_sized(std::vector<char>* messages, int count)
+{
+	int id = g_client_id_data[g_port_offset];
+	TcpFrameState& state = g_frame_state[g_port_offset];
+	int channel = -1;
+
+	std::lock_guard<std::mutex> recv_lock(g_frame_recv_mutex);
+
+	int i = 0;
+	while (i < count && !state.pending.empty()) {
+		TcpFrameMessage& message = state.pending.front();
+		if (accept_frame_channel(message.channel, channel)) {
+			messages[i++].swap(message.data);
+		}
+		state.pending.pop_front();
 	}
 
-	if (ack_enabled) {
-		char ack = 0;
-		KERNEL_SOCKET_SEND_IGNORE_RC(g_client_id_data[g_port_offset], &ack, 1);
-		if (ack != 0) {
-			printf("error in g_client_id_data\n");
+	if (i == count)
+		return;
+
+	TcpFrameHeader header;
+	if (!recv_frame_next(id, state, header, channel)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	for (; i < count; i++) {
+		// the size is bounded by check_frame_header
+		messages[i].resize(header.size);
+
+		TcpBuffer buffers[2] = { { messages[i].data(), messages[i].size() }, { (char*)&header, sizeof(TcpFrameHeader) } };
+		bool last = (i + 1 == count);
+		if (!recv_raw_scatter(id, buffers, last ? 1 : 2)) {
+			g_connection_error = 1;
+			return;
+		}
+
+		if (last)
+			break;
+
+		if (!check_frame_header(state, header) || !recv_frame_next(id, state, header, channel, true)) {
 			g_connection_error = 1;
+			return;
 		}
 	}
+
+	send_frame_ack(id, state);
 }
 
 // limit UDP 65,507 bytes
@@ -796,258 +2119,36 @@ bool TcpConnection::read_data_kernelglobal(void* data, size_t size)
 
 void TcpConnection::rgb_to_yuv_i420(unsigned char* destination, unsigned char* source, int tile_h, int tile_w)
 {
-	unsigned char* dst_y = destination;
-	unsigned char* dst_u = destination + tile_w * tile_h;
-	unsigned char* dst_v = destination + tile_w * tile_h + tile_w * tile_h / 4;
-
-#pragma omp parallel for
-	for (int y = 0; y < tile_h; y++) {
-		for (int x = 0; x < tile_w; x++) {
-
-			int index_src = x + y * tile_w;
-
-			// if (x >= tile_w) {
-			//    index_src += tile_h * tile_w;
-			//}
-
-			unsigned char r = source[index_src * 4 + 0];
-			unsigned char g = source[index_src * 4 + 1];
-			unsigned char b = source[index_src * 4 + 2];
-
-			// Y
-			int index_y = x + y * tile_w;
-			dst_y[index_y] = ((66 * r + 129 * g + 25 * b) >> 8) + 16;
-
-			// U
-			if (x % 2 == 0 && y % 2 == 0) {
-				int index_u = (x / 2) + (y / 2) * (tile_w / 2);
-				dst_u[index_u] = ((-38 * r + -74 * g + 112 * b) >> 8) + 128;
-			}
-
-			// V
-			if (x % 2 == 0 && y % 2 == 0) {
-				int index_v = (x / 2) + (y / 2) * (tile_w / 2);
-				dst_v[index_v] = ((112 * r + -94 * g + -18 * b) >> 8) + 128;
-			}
-		}
-	}
-}
-
-#if 0  // def WITH_CLIENT_GPUJPEG
-void TcpConnection::rgb_to_half(
-	unsigned short* destination, unsigned char* source, int tile_h, int tile_w)
-{
-#  pragma omp parallel for
-	for (int y = 0; y < tile_h; y++) {
-		for (int x = 0; x < tile_w; x++) {
-
-			int index_src = x + y * tile_w;
-			int index_dst = x + y * tile_w;
-
-			float scale = 1.0f / 255.0f;
-			unsigned short* h = &destination[index_dst * 4 + 0];
-			unsigned char* f = &source[index_src * 3 + 0];
-
-			for (int i = 0; i < 4; i++) {
-				/* optimized float to half for pixels:
-				 * assumes no negative, no nan, no inf, and sets denormal to 0 */
-				union {
-					unsigned int i;
-					float f;
-				} in;
-				float fscale = ((i == 3) ? 255.0f : f[i]) * scale;
-				in.f = (fscale > 0.0f) ? ((fscale < 65504.0f) ? fscale : 65504.0f) : 0.0f;
-				int x = in.i;
-
-				int absolute = x & 0x7FFFFFFF;
-				int Z = absolute + 0xC8000000;
-				int result = (absolute < 0x38800000) ? 0 : Z;
-				int rshift = (result >> 13);
-
-				h[i] = (rshift & 0x7FFF);
-			}
-		}
-	}
+	color_rgba_to_yuv_i420(destination, source, tile_h, tile_w);
 }
 
-#else
 void TcpConnection::rgb_to_half(unsigned short* destination, unsigned char* source, int tile_h, int tile_w)
 {
-#  pragma omp parallel for
-	for (int y = 0; y < tile_h; y++) {
-		for (int x = 0; x < tile_w; x++) {
-
-			int index_src = x + y * tile_w;
-			int index_dst = x + y * tile_w;
-
-			float scale = 1.0f / 255.0f;
-			unsigned short* h = &destination[index_dst * 4 + 0];
-			unsigned char* f = &source[index_src * 4 + 0];
-
-			for (int i = 0; i < 4; i++) {
-				/* optimized float to half for pixels:
-				 * assumes no negative, no nan, no inf, and sets denormal to 0 */
-				union {
-					unsigned int i;
-					float f;
-				} in;
-				float fscale = f[i] * scale;
-				in.f = (fscale > 0.0f) ? ((fscale < 65504.0f) ? fscale : 65504.0f) : 0.0f;
-				int x = in.i;
-
-				int absolute = x & 0x7FFFFFFF;
-				int Z = absolute + 0xC8000000;
-				int result = (absolute < 0x38800000) ? 0 : Z;
-				int rshift = (result >> 13);
-
-				h[i] = (rshift & 0x7FFF);
-			}
-		}
-	}
+	color_rgba_to_half(destination, source, tile_h, tile_w);
 }
-#endif
+
 void TcpConnection::yuv_i420_to_rgb(unsigned char* destination, unsigned char* source, int tile_h, int tile_w)
 {
-
-	unsigned char* src_y = source;
-	unsigned char* src_u = source + tile_w * tile_h;
-	unsigned char* src_v = source + tile_w * tile_h + tile_w * tile_h / 4;
-
-#pragma omp parallel for
-	for (int y = 0; y < tile_h; y++) {
-		for (int x = 0; x < tile_w; x++) {
-
-			int index_dst = x + y * tile_w;
-
-			// if (x >= tile_w) {
-			//    index_dst += tile_h * tile_w;
-			//}
-
-			unsigned char* r = &destination[index_dst * 4 + 0];
-			unsigned char* g = &destination[index_dst * 4 + 1];
-			unsigned char* b = &destination[index_dst * 4 + 2];
-			unsigned char* a = &destination[index_dst * 4 + 3];
-
-			// Y
-			int index_y = x + y * tile_w;
-			// dst_y[index_y] = ((66 * r + 129 * g + 25 * b) >> 8) + 16;
-			unsigned char Y = src_y[index_y];
-
-			// U
-			// if (x % 2 == 0 && y % 2 == 0) {
-			int index_u = (x / 2) + (y / 2) * tile_w / 2;
-			// dst_u[index_u] = ((-38 * r + -74 * g + 112 * b) >> 8) + 128;
-			//}
-			unsigned char U = src_u[index_u];
-
-			// V
-			// if (x % 2 == 0 && y % 2 == 0) {
-			int index_v = (x / 2) + (y / 2) * tile_w / 2;
-			// dst_v[index_v] = ((112 * r + -94 * g + -18 * b) >> 8) + 128;
-			//}
-			unsigned char V = src_v[index_v];
-
-			unsigned char C = Y - 16;
-			unsigned char D = U - 128;
-			unsigned char E = V - 128;
-
-			// R = clip((298 * C + 409 * E + 128) >> 8)
-			//    G = clip((298 * C - 100 * D - 208 * E + 128) >> 8)
-			//    B = clip((298 * C + 516 * D + 128) >> 8)
-
-			*r = (298 * C + 409 * E) >> 8;
-			*g = (298 * C - 100 * D - 208 * E) >> 8;
-			*b = (298 * C + 516 * D) >> 8;
-			*a = 255;
-		}
-	}
+	color_yuv_i420_to_rgba(destination, source, tile_h, tile_w);
 }
 
 void TcpConnection::yuv_i420_to_rgb_half(
 	unsigned short* destination, unsigned char* source, int tile_h, int tile_w)
 {
+	color_yuv_i420_to_rgba_half(destination, source, tile_h, tile_w);
+}
 
-	unsigned char* src_y = source;
-	unsigned char* src_u = source + tile_w * tile_h;
-	unsigned char* src_v = source + tile_w * tile_h + tile_w * tile_h / 4;
-
-#pragma omp parallel for
-	for (int y = 0; y < tile_h; y++) {
-		for (int x = 0; x < tile_w; x++) {
-
-			int index_dst = x + y * tile_w;
-
-			// if (x >= tile_w) {
-			//    index_dst += tile_h * tile_w;
-			//}
-
-			// unsigned short* r = &destination[index_dst * 4 + 0];
-			// unsigned short* g = &destination[index_dst * 4 + 1];
-			// unsigned short* b = &destination[index_dst * 4 + 2];
-			// unsigned short* a = &destination[index_dst * 4 + 3];
-
-			// Y
-			int index_y = x + y * tile_w;
-			// dst_y[index_y] = ((66 * r + 129 * g + 25 * b) >> 8) + 16;
-			unsigned char Y = src_y[index_y];
-
-			// U
-			// if (x % 2 == 0 && y % 2 == 0) {
-			int index_u = (x / 2) + (y / 2) * (tile_w / 2);
-			// dst_u[index_u] = ((-38 * r + -74 * g + 112 * b) >> 8) + 128;
-			//}
-			unsigned char U = src_u[index_u];
-
-			// V
-			// if (x % 2 == 0 && y % 2 == 0) {
-			int index_v = (x / 2) + (y / 2) * (tile_w / 2);
-			// dst_v[index_v] = ((112 * r + -94 * g + -18 * b) >> 8) + 128;
-			//}
-			unsigned char V = src_v[index_v];
-
-			unsigned char C = Y - 16;
-			unsigned char D = U - 128;
-			unsigned char E = V - 128;
-
-			// R = clip((298 * C + 409 * E + 128) >> 8)
-			//    G = clip((298 * C - 100 * D - 208 * E + 128) >> 8)
-			//    B = clip((298 * C + 516 * D + 128) >> 8)
-
-			unsigned char rgba[4];
-			rgba[0] = (298 * C + 409 * E) >> 8;
-			rgba[1] = (298 * C - 100 * D - 208 * E) >> 8;
-			rgba[2] = (298 * C + 516 * D) >> 8;
-			rgba[3] = 255;
-
-			//*r = (1.164383 * C + 1.596027 * E) * 65535;
-			//*g = (1.164383 * C - (0.391762 * D) - (0.812968 * E)) * 65535;
-			//*b = (1.164383 * C + 2.017232 * D) * 65535;
-			//*a = 65535;
-
-			float scale = 1.0f / 255.0f;
-			unsigned short* h = &destination[index_dst * 4 + 0];
-			unsigned char* f = &rgba[0];
-
-			for (int i = 0; i < 4; i++) {
-				/* optimized float to half for pixels:
-				 * assumes no negative, no nan, no inf, and sets denormal to 0 */
-				union {
-					unsigned int i;
-					float f;
-				} in;
-				float fscale = f[i] * scale;
-				in.f = (fscale > 0.0f) ? ((fscale < 65504.0f) ? fscale : 65504.0f) : 0.0f;
-				int x = in.i;
-
-				int absolute = x & 0x7FFFFFFF;
-				int Z = absolute + 0xC8000000;
-				int result = (absolute < 0x38800000) ? 0 : Z;
-				int rshift = (result >> 13);
-
-				h[i] = (rshift & 0x7FFF);
-			}
+int TcpConnection::get_compressed_quality()
+{
+	if (g_compressed_quality == -1) {
+		g_compressed_quality = JPEG_QUALITY_DEFAULT;
+		const char* compressed_quality_env = getenv("GPUJPEG_QUALITY");
+		if (compressed_quality_env != NULL) {
+			g_compressed_quality = atoi(compressed_quality_env);
 		}
 	}
+
+	return g_compressed_quality;
 }
 
 #ifdef WITH_CLIENT_GPUJPEG
@@ -1076,14 +2177,7 @@ int TcpConnection::gpujpeg_encode(int width,
 	struct gpujpeg_parameters param;
 	gpujpeg_set_default_parameters(&param);
 
-	if (g_compressed_quality == -1) {
-		g_compressed_quality = 75;
-		const char* compressed_quality_env = getenv("GPUJPEG_QUALITY");
-		if (compressed_quality_env != NULL) {
-			g_compressed_quality = atoi(compressed_quality_env);
-		}
-		param.quality = g_compressed_quality;
-	}
+	param.quality = get_compressed_quality();
 
 	//param.verbose = 2;
 
@@ -1208,10 +2302,22 @@ void TcpConnection::send_gpujpeg(char* dmem, char* pixels, int width, int height
 	int frame_size = 0;
 	gpujpeg_encode(width, height, format, (uint8_t*)dmem, (uint8_t*)pixels, frame_size);
 	// double t1 = omp_get_wtime();
-	send_data_data((char*)&frame_size, sizeof(int));
-	send_data_data((char*)g_image_compressed, frame_size);
+	g_compressed_size = (size_t)frame_size;
+	TcpBuffer buffers[2] = { { (char*)&frame_size, sizeof(int) }, { (char*)g_image_compressed, (size_t)frame_size } };
+	send_data_gather(buffers, 2);
 	// double t2 = omp_get_wtime();
 	//printf("send_gpujpeg: %f, %f, fps: %f, %f\n", t1 - t0, t2 - t1, 1.0/(t1 - t0), 1.0/(t2 - t1));
+#else
+	g_cpu_jpeg.set_quality(get_compressed_quality());
+	if (!g_cpu_jpeg.encode(pixels, width, height, format)) {
+		g_connection_error = 1;
+		return;
+	}
+
+	int frame_size = (int)g_cpu_jpeg.get_size();
+	g_compressed_size = (size_t)frame_size;
+	TcpBuffer buffers[2] = { { (char*)&frame_size, sizeof(int) }, { g_cpu_jpeg.get_data(), (size_t)frame_size } };
+	send_data_gather(buffers, 2);
 #endif
 }
 
@@ -1221,11 +2327,29 @@ void TcpConnection::recv_gpujpeg(char* dmem, char* pixels, int width, int height
 	int frame_size = 0;
 	//double t0 = omp_get_wtime();
 	recv_data_data((char*)&frame_size, sizeof(int));
-	recv_data_data((char*)pixels, frame_size);
+	recv_data_striped((char*)pixels, frame_size);
+	g_compressed_size = (size_t)frame_size;
 	//double t1 = omp_get_wtime();
 	gpujpeg_decode(width, height, format, (uint8_t*)dmem, (uint8_t*)pixels, frame_size);
 	//double t2 = omp_get_wtime();
 	// printf("recv_gpujpeg: %f, %f\n", t1 - t0, t2 - t1);
+#else
+	int frame_size = 0;
+	recv_data_data((char*)&frame_size, sizeof(int));
+	if (is_error() || frame_size <= 0) {
+		g_connection_error = 1;
+		return;
+	}
+
+	recv_data_striped(g_cpu_jpeg.prepare_decode((size_t)frame_size), frame_size);
+	if (is_error())
+		return;
+
+	g_compressed_size = (size_t)frame_size;
+
+	if (!g_cpu_jpeg.decode(pixels, width, height, format)) {
+		g_connection_error = 1;
+	}
 #endif
 }
 
@@ -1239,9 +2363,27 @@ void TcpConnection::recv_decode(char* dmem, char* pixels, int width, int height,
 void TcpConnection::set_port_offset(int offset)
 {
 	init_port();
+
+	if (is_multiplexed()) {
+		if (offset < 0 || offset > TCP_FRAME_CHANNEL_MAX) {
+			printf("set_port_offset: channel %d out of range\n", offset);
+			return;
+		}
+		g_channel = offset;
+		return;
+	}
+
 	g_port_offset = offset;
 }
 
+int TcpConnection::get_port_offset()
+{
+	if (is_multiplexed())
+		return g_channel;
+
+	return g_port_offset > 0 ? g_port_offset : 0;
+}
+
 void TcpConnection::save_bmp(
 	int width,
 	int height,	
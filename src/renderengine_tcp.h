@@ -20,7 +20,13 @@
 #define __RENDERENGINE_TCP_H__
 
 #include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
 #include "renderengine_api.h"
+#include "renderengine_jpeg.h"
 
 #    ifdef _WIN32
 
@@ -49,6 +55,65 @@
 
 #define TCP_OPTIMIZATION
 #define MAX_CONNECTIONS 100
+#define MAX_STRIPES 16
+
+#define TCP_VIEWER_HELLO 0x42525657 // "BRVW", first message of a viewer
+#define TCP_VIEWER_PORT_OFFSET MAX_CONNECTIONS // viewers connect to the data port + this, past the ports of the timesteps
+#define TCP_VIEWER_ACCEPT_MS 200
+
+#define TCP_GATHER_MAX 8 // max. messages of one send_data_gather/recv_data_scatter
+
+#define TCP_FRAME_MAGIC 0x42524653 // "BRFS"
+#define TCP_FRAME_MAX_SIZE_DEFAULT (256ULL * 1024ULL * 1024ULL) // until set_max_message_size
+#define TCP_FRAME_DATA 0
+#define TCP_FRAME_ACK 1
+
+// the upper bits of TcpFrameHeader::type carry the channel (timestep) of a data message
+#define TCP_FRAME_CHANNEL_SHIFT 16
+#define TCP_FRAME_CHANNEL_MAX 0xFFFF
+#define TCP_FRAME_KIND(type) ((type) & ((1u << TCP_FRAME_CHANNEL_SHIFT) - 1))
+#define TCP_FRAME_CHANNEL(type) ((type) >> TCP_FRAME_CHANNEL_SHIFT)
+
+// Header of one message in the framed protocol. Every header carries the
+// cumulative acknowledgement of the messages received from the peer, so
+// standalone ACK frames are only needed when one direction is idle.
+typedef struct TcpFrameHeader {
+	unsigned int magic;
+	unsigned int type;
+	unsigned int seq;
+	unsigned int ack;
+	unsigned long long size;
+} TcpFrameHeader;
+
+// State of a partial read/write on one socket, the event loop advances
+// all transfers of one call until they are done.
+typedef struct TcpTransfer {
+	int id;
+	char* data;
+	size_t size;
+	size_t done;
+	bool send;
+} TcpTransfer;
+
+// One message of a gathered send or a scattered receive.
+typedef struct TcpBuffer {
+	char* data;
+	size_t size;
+} TcpBuffer;
+
+// A message read ahead while waiting for an ACK.
+typedef struct TcpFrameMessage {
+	unsigned int channel;
+	std::vector<char> data;
+} TcpFrameMessage;
+
+typedef struct TcpFrameState {
+	std::atomic<unsigned int> send_seq;   // last sent message
+	std::atomic<unsigned int> send_acked; // last message acknowledged by the peer
+	std::atomic<unsigned int> recv_seq;   // last received message
+	std::atomic<unsigned int> recv_acked; // last message acknowledged to the peer
+	std::deque<TcpFrameMessage> pending; // messages read ahead while waiting for ACK
+} TcpFrameState;
 
 
 class BRAAS_HPC_EXPORT_DLL TcpConnection {
@@ -61,7 +126,19 @@ protected:
 	int g_server_id_data[MAX_CONNECTIONS];
 	int g_client_id_data[MAX_CONNECTIONS];
 
-	int g_timeval_sec = 60;
+	// additional connections of the data socket, stripe 0 is g_client_id_data
+	int g_client_id_stripe[MAX_CONNECTIONS][MAX_STRIPES];
+	int g_stripes = 1;
+
+	int g_timeval_sec = 60; // a stalled transfer fails after this time in the event loop, 0 = never
+	bool g_event_loop = false;
+
+	// empty epoll sets of the event loop between its calls, one per thread in a call at once
+	std::mutex g_epoll_mutex;
+	std::vector<int> g_epoll_free;
+
+	int g_connect_timeout_sec = 10; // the client gives up connecting after this time, 0 = one blocking attempt
+	double g_connect_latency_ms = 0; // time the last successful connect took
 	int g_connection_error = 0;
 
 	sockaddr_in g_client_sockaddr_cam[MAX_CONNECTIONS];
@@ -71,16 +148,46 @@ protected:
 	sockaddr_in g_server_sockaddr_data[MAX_CONNECTIONS];
 
 	bool g_is_server = true;
+	char g_server_name[1024] = "";
+	int g_server_port = 0;
+
+	// listening socket of the viewers, only the thread of accept_viewer accepts on it
+	int g_server_id_viewer = -1;
+	sockaddr_in g_server_sockaddr_viewer;
+
+	bool g_framed = false;
+	int g_frame_window = 8; // max. unacknowledged messages, 0 = unlimited
+	size_t g_max_message_size = TCP_FRAME_MAX_SIZE_DEFAULT; // a larger header is corrupt
+	TcpFrameState g_frame_state[MAX_CONNECTIONS];
+
+	// With multiplexed timesteps set_port_offset selects the channel of the messages on the
+	// one framed connection instead of another port. The client receives its channel only,
+	// the server (and a viewer) follows the channel of the last message it received.
+	bool g_multiplexed = false;
+	bool g_follow_channel = false; // viewer, the server always follows
+	std::atomic<int> g_channel{ 0 };
+
+	// A sending and a receiving thread may use the framed connection at the same time:
+	// whole frames are written under g_frame_send_mutex, the socket is read under
+	// g_frame_recv_mutex and a sender waiting for ACKs read by another thread waits on g_frame_cv.
+	std::mutex g_frame_send_mutex;
+	std::mutex g_frame_recv_mutex;
+	std::mutex g_frame_state_mutex;
+	std::condition_variable g_frame_cv;
 
 	int frame = 0;
 
+	int g_compressed_quality = -1; //0-100
+	size_t g_compressed_size = 0; // bytes of the last sent or received compressed frame
+
 #ifdef WITH_CLIENT_GPUJPEG
 	gpujpeg_encoder* g_encoder = NULL;
 	uint8_t* g_image_compressed;
 
-	int g_compressed_quality = -1; //0-100
-
 	gpujpeg_decoder* g_decoder = NULL;
+#else
+	// same stream on the CPU when there is no GPUJPEG
+	CpuJpeg g_cpu_jpeg;
 #endif
 public:
 	TcpConnection();
@@ -105,10 +212,27 @@ public:
 	virtual void send_data_data(char* data, size_t size, bool ack = true);
 	virtual void recv_data_data(char* data, size_t size, bool ack = true);
 
+	// large messages are split over g_stripes parallel connections
+	virtual void send_data_striped(char* data, size_t size);
+	virtual void recv_data_striped(char* data, size_t size);
+
+	// Several messages in one call, e.g. the pixels and the data state of a frame. With the
+	// framed protocol all headers and payloads are submitted by one sendmsg and the receiver
+	// reads each payload together with the next header, otherwise they go one by one.
+	// channel: timestep of the messages with multiplexed timesteps, -1 = the current one.
+	virtual void send_data_gather(TcpBuffer* messages, int count, int channel = -1);
+	virtual void recv_data_scatter(TcpBuffer* messages, int count);
+
+	// Like recv_data_scatter, but each message is resized to the size on the wire (up to the
+	// maximum message size), e.g. for a frame sent before a resize. Without the framed protocol
+	// or with striped messages the sizes are not on the wire and the current sizes are received.
+	virtual void recv_data_scatter_sized(std::vector<char>* messages, int count);
+
 	virtual void send_gpujpeg(char* dmem, char* pixels, int width, int height, int format);
 	virtual void recv_gpujpeg(char* dmem, char* pixels, int width, int height, int format);
 	virtual void recv_decode(char* dmem, char* pixels, int width, int height, int frame_size);
 
+	// RGBA8 <-> I420 and half float, see renderengine_color.h
 	virtual void rgb_to_yuv_i420(
 		unsigned char* destination, unsigned char* source, int tile_h, int tile_w);
 
@@ -122,6 +246,51 @@ public:
 		unsigned short* destination, unsigned char* source, int tile_h, int tile_w);
 
 	virtual void set_port_offset(int offset);
+	virtual int get_port_offset();
+
+	// timesteps as channels of the framed connection, see g_multiplexed
+	virtual void set_multiplexed(bool enabled) { g_multiplexed = enabled; }
+	virtual bool is_multiplexed() { return g_multiplexed && g_framed; }
+	virtual int get_channel() { return g_channel; }
+
+	virtual void set_stripes(int stripes);
+	virtual int get_stripes() { return g_stripes; }
+
+	virtual void set_framed(bool enabled);
+	virtual bool is_framed() { return g_framed; }
+
+	// the largest message accepted from the peer, e.g. a frame at the largest resolution
+	virtual void set_max_message_size(size_t size) { g_max_message_size = size; }
+	virtual size_t get_max_message_size() { return g_max_message_size; }
+
+	// true if one thread may send while another one receives
+	virtual bool is_full_duplex() { return g_framed; }
+
+	// Linux only: drive the sockets with non-blocking calls and epoll instead of blocking read/write
+	virtual void set_event_loop(bool enabled);
+	virtual bool is_event_loop() { return g_event_loop; }
+
+	virtual void set_timeout(int sec) { g_timeval_sec = sec; }
+	virtual int get_timeout() { return g_timeval_sec; }
+
+	virtual void set_connect_timeout(int sec) { g_connect_timeout_sec = sec; }
+	virtual int get_connect_timeout() { return g_connect_timeout_sec; }
+	virtual double get_connect_latency() { return g_connect_latency_ms; }
+
+	// quality of the next compressed frame (0-100), GPUJPEG_QUALITY or 75
+	int get_compressed_quality();
+	void set_compressed_quality(int quality) { g_compressed_quality = quality; }
+	size_t get_compressed_size() { return g_compressed_size; }
+
+	// viewers: watch-only clients of a running server, they have their own port (see get_viewer_port),
+	// so the accepts of the client's reconnects and stripes never pick up a viewer
+	virtual void init_sockets_viewer(const char* server, int port);
+	virtual bool listen_viewers();
+	virtual int accept_viewer(int timeout_ms);
+	virtual void attach_viewer(int client_id, TcpConnection* main);
+
+	// wakes up a thread blocked in recv_data_data/recv_data_striped, the connection has to be closed afterwards
+	virtual void interrupt_recv();
 
 	virtual void save_bmp(
 		int width,
@@ -137,6 +306,7 @@ protected:
 	bool init_wsa();
 	void init_port();
 	void close_wsa();
+	bool server_listen(int port, int& server_id, sockaddr_in& server_sock);
 	bool server_create(int port,
 		int& server_id,
 		int& client_id,
@@ -145,11 +315,50 @@ protected:
 		bool only_accept);
 
 	bool client_create(const char* server_name, int port, int& client_id, sockaddr_in& client_sock);
+	int get_viewer_port(int port);
+	int connect_address(addrinfo* address, int timeout_ms);
+	bool set_nonblocking(int id, bool enabled);
 	void close_tcp(int id);
+	void close_tcp_graceful(int id);
 
 	void send_data(char* data, size_t size);
 	void recv_data(char* data, size_t size);
 
+	void init_sockets_stripes(const char* server, int port);
+	int get_stripe_count(size_t size);
+
+	bool send_raw(int id, char* data, size_t size);
+	bool recv_raw(int id, char* data, size_t size);
+
+	bool send_raw_gather(int id, TcpBuffer* buffers, int count);
+	bool recv_raw_scatter(int id, TcpBuffer* buffers, int count);
+	bool can_gather(TcpBuffer* messages, int count);
+
+	bool transfer(TcpTransfer* transfers, int count);
+	bool transfer_event_loop(TcpTransfer* transfers, int count);
+	int acquire_epoll();
+	void release_epoll(int epoll_id);
+	void close_epoll();
+
+	void send_message(char* data, size_t size, bool ack, TcpTransfer* extra, int extra_count);
+	void recv_message(char* data, size_t size, bool ack, TcpTransfer* extra, int extra_count);
+
+	void reset_frame_state(int offset);
+	bool recv_frame_header(int id, TcpFrameState& state, TcpFrameHeader& header);
+	bool check_frame_header(TcpFrameState& state, TcpFrameHeader& header);
+	bool accept_frame_channel(unsigned int message_channel, int& channel);
+	bool recv_frame_next(int id, TcpFrameState& state, TcpFrameHeader& header, int& channel, bool have_header = false);
+	bool skip_frame_payload(int id, size_t size);
+	int pop_pending_frame(TcpFrameState& state, char* data, size_t size, int& channel);
+	bool wait_frame_window(int id, TcpFrameState& state, int count);
+	bool read_ahead_frame(int id, TcpFrameState& state);
+	bool send_frame_ack(int id, TcpFrameState& state);
+	void send_frame_data(char* data, size_t size, TcpTransfer* extra = NULL, int extra_count = 0);
+	void recv_frame_data(char* data, size_t size, TcpTransfer* extra = NULL, int extra_count = 0);
+	void send_frame_gather(TcpBuffer* messages, int count, int channel);
+	void recv_frame_scatter(TcpBuffer* messages, int count);
+	void recv_frame_scatter_sized(std::vector<char>* messages, int count);
+
 #ifdef WITH_CLIENT_GPUJPEG
 	int gpujpeg_encode(int width,
 		int height,
@@ -0,0 +1,235 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_tiles.h"
+
+#include <stdio.h>
+#include <string.h>
+
+DirtyTiles::DirtyTiles()
+{
+	memset(&m_header, 0, sizeof(DirtyTilesHeader));
+}
+
+void DirtyTiles::set_tile_size(int tile_size)
+{
+	if (tile_size < TILES_SIZE_MIN) {
+		tile_size = TILES_SIZE_MIN;
+	}
+
+	if (tile_size != m_tile_size) {
+		m_tile_size = tile_size;
+		m_valid = false;
+	}
+}
+
+size_t DirtyTiles::get_tile_bytes(const DirtyTilesHeader& header, int tile)
+{
+	int tiles_x = get_tiles_x(header);
+	int x = (tile % tiles_x) * header.tile_size;
+	int y = (tile / tiles_x) * header.tile_size;
+	int w = (x + header.tile_size <= header.width) ? header.tile_size : header.width - x;
+	int h = (y + header.tile_size <= header.height) ? header.tile_size : header.height - y;
+
+	return (size_t)w * h * header.pixel_size;
+}
+
+void DirtyTiles::copy_tile(const DirtyTilesHeader& header, int tile, char* pixels, char* packed, bool to_packed)
+{
+	int tiles_x = get_tiles_x(header);
+	int x = (tile % tiles_x) * header.tile_size;
+	int y = (tile / tiles_x) * header.tile_size;
+	int w = (x + header.tile_size <= header.width) ? header.tile_size : header.width - x;
+	int h = (y + header.tile_size <= header.height) ? header.tile_size : header.height - y;
+
+	size_t row_bytes = (size_t)w * header.pixel_size;
+	size_t stride = (size_t)header.width * header.pixel_size;
+	char* row = pixels + (size_t)y * stride + (size_t)x * header.pixel_size;
+
+	for (int r = 0; r < h; r++) {
+		if (to_packed) {
+			memcpy(packed, row, row_bytes);
+		}
+		else {
+			memcpy(row, packed, row_bytes);
+		}
+		packed += row_bytes;
+		row += stride;
+	}
+}
+
+unsigned long long DirtyTiles::hash_tile(const DirtyTilesHeader& header, int tile, const char* pixels)
+{
+	int tiles_x = get_tiles_x(header);
+	int x = (tile % tiles_x) * header.tile_size;
+	int y = (tile / tiles_x) * header.tile_size;
+	int w = (x + header.tile_size <= header.width) ? header.tile_size : header.width - x;
+	int h = (y + header.tile_size <= header.height) ? header.tile_size : header.height - y;
+
+	size_t row_bytes = (size_t)w * header.pixel_size;
+	size_t stride = (size_t)header.width * header.pixel_size;
+	const char* row = pixels + (size_t)y * stride + (size_t)x * header.pixel_size;
+
+	// 64-bit FNV-1a over 8-byte words, the rows of a tile are not aligned
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (int r = 0; r < h; r++) {
+		size_t i = 0;
+		for (; i + 8 <= row_bytes; i += 8) {
+			unsigned long long word;
+			memcpy(&word, row + i, 8);
+			hash = (hash ^ word) * 0x100000001b3ULL;
+		}
+		for (; i < row_bytes; i++) {
+			hash = (hash ^ (unsigned char)row[i]) * 0x100000001b3ULL;
+		}
+		row += stride;
+	}
+
+	return hash ^ (hash >> 29);
+}
+
+bool DirtyTiles::compute_offsets(const DirtyTilesHeader& header)
+{
+	int tiles = get_tiles_x(header) * get_tiles_y(header);
+	const unsigned char* bitmap = (const unsigned char*)m_data.data();
+
+	// the changed tiles follow the bitmap in order
+	m_offsets.resize(tiles);
+	size_t offset = get_bitmap_size(tiles);
+	int changed = 0;
+	for (int t = 0; t < tiles; t++) {
+		m_offsets[t] = offset;
+		if (bitmap[t / 8] & (1 << (t % 8))) {
+			offset += get_tile_bytes(header, t);
+			changed++;
+		}
+	}
+
+	return offset == header.size && changed == header.changed;
+}
+
+bool DirtyTiles::encode(const char* pixels, int width, int height, int pixel_size)
+{
+	if (width < 1 || height < 1)
+		return false;
+
+	DirtyTilesHeader& header = m_header;
+	if (header.width != width || header.height != height || header.pixel_size != pixel_size ||
+		header.tile_size != m_tile_size) {
+		m_valid = false;
+	}
+
+	header.width = width;
+	header.height = height;
+	header.pixel_size = pixel_size;
+	header.tile_size = m_tile_size;
+	header.key = m_valid ? 0 : 1;
+
+	int tiles = get_tiles_x(header) * get_tiles_y(header);
+	m_new_hashes.resize(tiles);
+
+#pragma omp parallel for
+	for (int t = 0; t < tiles; t++) {
+		m_new_hashes[t] = hash_tile(header, t, pixels);
+	}
+
+	size_t bitmap_size = get_bitmap_size(tiles);
+	size_t size = bitmap_size;
+	int changed = 0;
+
+	if (m_data.size() < bitmap_size) {
+		m_data.resize(bitmap_size);
+	}
+	memset(m_data.data(), 0, bitmap_size);
+
+	for (int t = 0; t < tiles; t++) {
+		if (header.key || m_new_hashes[t] != m_hashes[t]) {
+			m_data[t / 8] |= (char)(1 << (t % 8));
+			size += get_tile_bytes(header, t);
+			changed++;
+		}
+	}
+
+	header.changed = changed;
+	header.size = size;
+
+	if (m_data.size() < size) {
+		m_data.resize(size);
+	}
+
+	compute_offsets(header);
+
+	const unsigned char* bitmap = (const unsigned char*)m_data.data();
+
+#pragma omp parallel for
+	for (int t = 0; t < tiles; t++) {
+		if (bitmap[t / 8] & (1 << (t % 8))) {
+			copy_tile(header, t, (char*)pixels, m_data.data() + m_offsets[t], true);
+		}
+	}
+
+	m_hashes.swap(m_new_hashes);
+	m_valid = true;
+
+	m_sent = changed;
+	m_total = tiles;
+
+	return true;
+}
+
+char* DirtyTiles::prepare_decode(const DirtyTilesHeader& header, int width, int height, int pixel_size)
+{
+	if (header.width != width || header.height != height || header.pixel_size != pixel_size ||
+		header.tile_size < TILES_SIZE_MIN) {
+		printf("DirtyTiles::prepare_decode: tiles of %dx%d (%d bytes) do not fit the frame %dx%d (%d bytes)\n",
+			header.width, header.height, header.pixel_size, width, height, pixel_size);
+		return NULL;
+	}
+
+	m_header = header;
+	if (m_data.size() < header.size) {
+		m_data.resize((size_t)header.size);
+	}
+
+	return m_data.data();
+}
+
+bool DirtyTiles::decode(char* pixels)
+{
+	const DirtyTilesHeader& header = m_header;
+	int tiles = get_tiles_x(header) * get_tiles_y(header);
+
+	if (header.size < get_bitmap_size(tiles) || !compute_offsets(header)) {
+		printf("DirtyTiles::decode: the bitmap does not match the tiles\n");
+		return false;
+	}
+
+	const unsigned char* bitmap = (const unsigned char*)m_data.data();
+
+#pragma omp parallel for
+	for (int t = 0; t < tiles; t++) {
+		if (bitmap[t / 8] & (1 << (t % 8))) {
+			copy_tile(header, t, pixels, m_data.data() + m_offsets[t], false);
+		}
+	}
+
+	m_sent = header.changed;
+	m_total = tiles;
+
+	return true;
+}
@@ -0,0 +1,95 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_TILES_H__
+#define __RENDERENGINE_TILES_H__
+
+#include <stdlib.h>
+#include <vector>
+#include "renderengine_api.h"
+
+#define TILES_SIZE_DEFAULT 64
+#define TILES_SIZE_MIN 8
+
+// Sent in front of the changed tiles: a bitmap with one bit per tile (row by row)
+// followed by the pixels of the changed tiles, each tile packed row by row.
+typedef struct DirtyTilesHeader {
+	int width;
+	int height;
+	int pixel_size; // bytes per pixel
+	int tile_size;
+	int changed;    // number of changed tiles
+	int key;        // all tiles are sent
+	unsigned long long size; // bitmap + tiles
+} DirtyTilesHeader;
+
+// Finds the tiles that changed since the previous frame by their hashes, so a static
+// view only sends the regions that are still being rendered.
+class BRAAS_HPC_EXPORT_DLL DirtyTiles {
+protected:
+	int m_tile_size = TILES_SIZE_DEFAULT;
+
+	// hashes of the previous frame, invalid after reset or a change of the frame size
+	std::vector<unsigned long long> m_hashes;
+	std::vector<unsigned long long> m_new_hashes;
+	std::vector<size_t> m_offsets;
+	bool m_valid = false;
+
+	DirtyTilesHeader m_header;
+	std::vector<char> m_data;
+
+	int m_sent = 0;
+	int m_total = 0;
+
+public:
+	DirtyTiles();
+
+	void set_tile_size(int tile_size);
+	int get_tile_size() { return m_tile_size; }
+
+	// the next frame is sent whole
+	void reset() { m_valid = false; }
+
+	// the changed tiles of pixels, the result is get_header() and get_data()
+	bool encode(const char* pixels, int width, int height, int pixel_size);
+
+	DirtyTilesHeader& get_header() { return m_header; }
+	char* get_data() { return m_data.data(); }
+	size_t get_size() { return (size_t)m_header.size; }
+
+	// buffer for the data announced by header, NULL if it does not fit the frame
+	char* prepare_decode(const DirtyTilesHeader& header, int width, int height, int pixel_size);
+
+	// copies the received tiles into the previous frame
+	bool decode(char* pixels);
+
+	// tiles sent/total of the last frame
+	int get_sent_tiles() { return m_sent; }
+	int get_total_tiles() { return m_total; }
+
+protected:
+	int get_tiles_x(const DirtyTilesHeader& header) { return (header.width + header.tile_size - 1) / header.tile_size; }
+	int get_tiles_y(const DirtyTilesHeader& header) { return (header.height + header.tile_size - 1) / header.tile_size; }
+	size_t get_bitmap_size(int tiles) { return ((size_t)tiles + 7) / 8; }
+	size_t get_tile_bytes(const DirtyTilesHeader& header, int tile);
+	bool compute_offsets(const DirtyTilesHeader& header);
+	void copy_tile(const DirtyTilesHeader& header, int tile, char* pixels, char* packed, bool to_packed);
+	unsigned long long hash_tile(const DirtyTilesHeader& header, int tile, const char* pixels);
+};
+
+#endif
@@ -0,0 +1,154 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_tonemap.h"
+#include "renderengine_color.h"
+
+#include <math.h>
+
+#define TONEMAP_TABLE_SIZE 65536
+
+// 4x4 Bayer matrix, the offsets of a pixel in 1/16 of a step
+static const unsigned char g_tonemap_bayer[4][4] = {
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 } };
+
+static float tonemap_srgb(float x)
+{
+	return x <= 0.0031308f ? x * 12.92f : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+}
+
+static float tonemap_filmic(float x)
+{
+	// Narkowicz fit of the ACES reference rendering transform
+	return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+}
+
+void ToneMapper::set_curve(int curve)
+{
+	if (curve < TONEMAP_LINEAR || curve > TONEMAP_FILMIC)
+		curve = TONEMAP_SRGB;
+
+	if (curve != m_curve) {
+		m_curve = curve;
+		m_valid = false;
+	}
+}
+
+void ToneMapper::set_exposure(float exposure)
+{
+	if (exposure != m_exposure) {
+		m_exposure = exposure;
+		m_valid = false;
+	}
+}
+
+void ToneMapper::set_gamma(float gamma)
+{
+	if (gamma <= 0.0f)
+		gamma = 2.2f;
+
+	if (gamma != m_gamma) {
+		m_gamma = gamma;
+		m_valid = false;
+	}
+}
+
+void ToneMapper::build_tables()
+{
+	std::vector<unsigned short> halfs(TONEMAP_TABLE_SIZE);
+	for (int i = 0; i < TONEMAP_TABLE_SIZE; i++) {
+		halfs[i] = (unsigned short)i;
+	}
+
+	std::vector<float> values(TONEMAP_TABLE_SIZE);
+	color_half_to_float(values.data(), halfs.data(), TONEMAP_TABLE_SIZE);
+
+	m_color.resize(TONEMAP_TABLE_SIZE);
+	m_alpha.resize(TONEMAP_TABLE_SIZE);
+
+	float scale = powf(2.0f, m_exposure);
+
+	for (int i = 0; i < TONEMAP_TABLE_SIZE; i++) {
+		float v = values[i];
+
+		// negative and nan are black
+		float a = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;
+		float x = v > 0.0f ? v * scale : 0.0f;
+
+		switch (m_curve) {
+		case TONEMAP_SRGB:
+			x = tonemap_srgb(x < 1.0f ? x : 1.0f);
+			break;
+		case TONEMAP_GAMMA:
+			x = powf(x < 1.0f ? x : 1.0f, 1.0f / m_gamma);
+			break;
+		case TONEMAP_FILMIC:
+			// the curve is 1 long before, the limit keeps inf out
+			x = tonemap_filmic(x < 1.0e4f ? x : 1.0e4f);
+			x = tonemap_srgb(x < 1.0f ? x : 1.0f);
+			break;
+		default:
+			break;
+		}
+
+		x = x < 1.0f ? x : 1.0f;
+		m_color[i] = (unsigned short)(x * 255.0f * 256.0f + 0.5f);
+		m_alpha[i] = (unsigned short)(a * 255.0f * 256.0f + 0.5f);
+	}
+
+	m_valid = true;
+}
+
+void ToneMapper::apply(unsigned char* destination, const float* source, int height, int width)
+{
+	if (!m_valid)
+		build_tables();
+
+	const unsigned short* color = m_color.data();
+	const unsigned short* alpha = m_alpha.data();
+	int count = width * 4;
+
+#pragma omp parallel
+	{
+		std::vector<unsigned short> row(count);
+
+#pragma omp for
+		for (int y = 0; y < height; y++) {
+			color_float_to_half(row.data(), source + (size_t)y * count, (size_t)count);
+
+			// without dithering every value is rounded
+			unsigned int offsets[4];
+			for (int i = 0; i < 4; i++) {
+				offsets[i] = m_dither ? g_tonemap_bayer[y & 3][i] * 16 + 8 : 128;
+			}
+
+			unsigned char* dst = destination + (size_t)y * count;
+			for (int x = 0; x < width; x++) {
+				const unsigned short* h = row.data() + x * 4;
+				unsigned int offset = offsets[x & 3];
+				dst[x * 4 + 0] = (unsigned char)((color[h[0]] + offset) >> 8);
+				dst[x * 4 + 1] = (unsigned char)((color[h[1]] + offset) >> 8);
+				dst[x * 4 + 2] = (unsigned char)((color[h[2]] + offset) >> 8);
+				dst[x * 4 + 3] = (unsigned char)((alpha[h[3]] + 128) >> 8);
+			}
+		}
+	}
+}
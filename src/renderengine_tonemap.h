@@ -0,0 +1,65 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_TONEMAP_H__
+#define __RENDERENGINE_TONEMAP_H__
+
+#include <vector>
+#include "renderengine_api.h"
+
+#define TONEMAP_LINEAR 0 // clamped to [0, 1]
+#define TONEMAP_SRGB 1
+#define TONEMAP_GAMMA 2  // x^(1 / gamma)
+#define TONEMAP_FILMIC 3 // ACES fit, then sRGB
+
+// Display transform of linear float RGBA to RGBA8: exposure, the curve of the color
+// channels and optional ordered dithering, alpha is only clamped. Every value is
+// converted to half and looked up in a table over all halfs (the curve is rebuilt when
+// a parameter changes), the rows are converted on parallel threads.
+class BRAAS_HPC_EXPORT_DLL ToneMapper {
+protected:
+	int m_curve = TONEMAP_SRGB;
+	float m_exposure = 0.0f; // stops
+	float m_gamma = 2.2f;
+	bool m_dither = true;
+
+	// display values in 1/256 of an 8 bit step, indexed by the half of the input
+	std::vector<unsigned short> m_color;
+	std::vector<unsigned short> m_alpha;
+	bool m_valid = false;
+
+public:
+	void set_curve(int curve);
+	int get_curve() { return m_curve; }
+
+	void set_exposure(float exposure);
+	float get_exposure() { return m_exposure; }
+
+	void set_gamma(float gamma);
+	float get_gamma() { return m_gamma; }
+
+	void set_dither(bool dither) { m_dither = dither; }
+	bool get_dither() { return m_dither; }
+
+	void apply(unsigned char* destination, const float* source, int height, int width);
+
+protected:
+	void build_tables();
+};
+
+#endif
@@ -0,0 +1,357 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#include "renderengine_video.h"
+#include "renderengine_color.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WITH_CLIENT_OPENH264
+#  include <wels/codec_api.h>
+#endif
+
+VideoCodec::VideoCodec()
+{
+	memset(&m_header, 0, sizeof(VideoHeader));
+}
+
+VideoCodec::~VideoCodec()
+{
+	reset();
+}
+
+bool VideoCodec::is_supported()
+{
+#ifdef WITH_CLIENT_OPENH264
+	return true;
+#else
+	return false;
+#endif
+}
+
+void VideoCodec::reset()
+{
+	free_encoder();
+	free_decoder();
+	m_force_key = true;
+}
+
+void VideoCodec::set_bitrate(int bitrate)
+{
+	m_bitrate = bitrate > 0 ? bitrate : VIDEO_BITRATE_DEFAULT;
+
+#ifdef WITH_CLIENT_OPENH264
+	if (m_encoder != NULL) {
+		SBitrateInfo info;
+		memset(&info, 0, sizeof(SBitrateInfo));
+		info.iLayer = SPATIAL_LAYER_ALL;
+		info.iBitrate = m_bitrate * 1000;
+		((ISVCEncoder*)m_encoder)->SetOption(ENCODER_OPTION_BITRATE, &info);
+	}
+#endif
+}
+
+const unsigned char* VideoCodec::pad(const unsigned char* pixels, int width, int height, int even_width, int even_height)
+{
+	if (width == even_width && height == even_height)
+		return pixels;
+
+	m_rgba.resize((size_t)even_width * even_height * 4);
+	for (int y = 0; y < even_height; y++) {
+		const unsigned char* src = pixels + (size_t)(y < height ? y : height - 1) * width * 4;
+		unsigned char* dst = m_rgba.data() + (size_t)y * even_width * 4;
+		memcpy(dst, src, (size_t)width * 4);
+		if (even_width > width) {
+			memcpy(dst + (size_t)width * 4, src + (size_t)(width - 1) * 4, 4);
+		}
+	}
+
+	return m_rgba.data();
+}
+
+#ifdef WITH_CLIENT_OPENH264
+
+bool VideoCodec::init_encoder(int width, int height)
+{
+	free_encoder();
+
+	ISVCEncoder* encoder = NULL;
+	if (WelsCreateSVCEncoder(&encoder) != 0 || encoder == NULL) {
+		printf("VideoCodec: WelsCreateSVCEncoder failed\n");
+		return false;
+	}
+
+	SEncParamExt param;
+	encoder->GetDefaultParams(&param);
+	param.iUsageType = CAMERA_VIDEO_REAL_TIME;
+	param.fMaxFrameRate = m_frame_rate;
+	param.iPicWidth = width;
+	param.iPicHeight = height;
+	param.iTargetBitrate = m_bitrate * 1000;
+	param.iRCMode = RC_BITRATE_MODE;
+	param.bEnableFrameSkip = false; // every frame is sent
+	param.uiIntraPeriod = 0;        // key frames only when needed
+	param.iEntropyCodingModeFlag = 0;
+	param.iSpatialLayerNum = 1;
+	param.iTemporalLayerNum = 1;
+	param.iMultipleThreadIdc = 0;   // a slice per core
+	param.sSpatialLayers[0].iVideoWidth = width;
+	param.sSpatialLayers[0].iVideoHeight = height;
+	param.sSpatialLayers[0].fFrameRate = m_frame_rate;
+	param.sSpatialLayers[0].iSpatialBitrate = param.iTargetBitrate;
+	param.sSpatialLayers[0].sSliceArgument.uiSliceMode = SM_FIXEDSLCNUM_SLICE;
+	param.sSpatialLayers[0].sSliceArgument.uiSliceNum = 0;
+
+	if (encoder->InitializeExt(&param) != 0) {
+		printf("VideoCodec: encoder initialization failed for %d x %d\n", width, height);
+		WelsDestroySVCEncoder(encoder);
+		return false;
+	}
+
+	int format = videoFormatI420;
+	encoder->SetOption(ENCODER_OPTION_DATAFORMAT, &format);
+
+	m_encoder = encoder;
+	m_width = width;
+	m_height = height;
+	m_force_key = true;
+
+	return true;
+}
+
+void VideoCodec::free_encoder()
+{
+	if (m_encoder != NULL) {
+		ISVCEncoder* encoder = (ISVCEncoder*)m_encoder;
+		encoder->Uninitialize();
+		WelsDestroySVCEncoder(encoder);
+		m_encoder = NULL;
+	}
+	m_width = 0;
+	m_height = 0;
+}
+
+bool VideoCodec::init_decoder()
+{
+	ISVCDecoder* decoder = NULL;
+	if (WelsCreateDecoder(&decoder) != 0 || decoder == NULL) {
+		printf("VideoCodec: WelsCreateDecoder failed\n");
+		return false;
+	}
+
+	SDecodingParam param;
+	memset(&param, 0, sizeof(SDecodingParam));
+	param.sVideoProperty.eVideoBsType = VIDEO_BITSTREAM_AVC;
+	param.eEcActiveIdc = ERROR_CON_DISABLE; // a broken frame is an error, not concealed
+
+	if (decoder->Initialize(&param) != 0) {
+		WelsDestroyDecoder(decoder);
+		return false;
+	}
+
+	m_decoder = decoder;
+	return true;
+}
+
+void VideoCodec::free_decoder()
+{
+	if (m_decoder != NULL) {
+		ISVCDecoder* decoder = (ISVCDecoder*)m_decoder;
+		decoder->Uninitialize();
+		WelsDestroyDecoder(decoder);
+		m_decoder = NULL;
+	}
+}
+
+bool VideoCodec::encode(const unsigned char* pixels, int width, int height)
+{
+	if (width < 1 || height < 1)
+		return false;
+
+	int even_width = (width + 1) & ~1;
+	int even_height = (height + 1) & ~1;
+
+	if (m_encoder == NULL || even_width != m_width || even_height != m_height) {
+		if (!init_encoder(even_width, even_height))
+			return false;
+	}
+
+	size_t plane = (size_t)even_width * even_height;
+	m_yuv.resize(plane * 3 / 2);
+	color_rgba_to_yuv_i420(m_yuv.data(), pad(pixels, width, height, even_width, even_height), even_height, even_width);
+
+	SSourcePicture picture;
+	memset(&picture, 0, sizeof(SSourcePicture));
+	picture.iPicWidth = even_width;
+	picture.iPicHeight = even_height;
+	picture.iColorFormat = videoFormatI420;
+	picture.iStride[0] = even_width;
+	picture.iStride[1] = even_width / 2;
+	picture.iStride[2] = even_width / 2;
+	picture.pData[0] = m_yuv.data();
+	picture.pData[1] = m_yuv.data() + plane;
+	picture.pData[2] = m_yuv.data() + plane + plane / 4;
+	picture.uiTimeStamp = m_timestamp;
+	m_timestamp += (long long)(1000.0f / m_frame_rate);
+
+	ISVCEncoder* encoder = (ISVCEncoder*)m_encoder;
+	if (m_force_key) {
+		encoder->ForceIntraFrame(true);
+		m_force_key = false;
+	}
+
+	SFrameBSInfo info;
+	memset(&info, 0, sizeof(SFrameBSInfo));
+	if (encoder->EncodeFrame(&picture, &info) != cmResultSuccess) {
+		printf("VideoCodec: EncodeFrame failed\n");
+		return false;
+	}
+
+	// the NAL units of all layers are consecutive
+	m_data.clear();
+	if (info.eFrameType != videoFrameTypeSkip) {
+		for (int l = 0; l < info.iLayerNum; l++) {
+			const SLayerBSInfo& layer = info.sLayerInfo[l];
+			size_t size = 0;
+			for (int n = 0; n < layer.iNalCount; n++) {
+				size += (size_t)layer.pNalLengthInByte[n];
+			}
+			m_data.insert(m_data.end(), layer.pBsBuf, layer.pBsBuf + size);
+		}
+	}
+
+	if (m_data.empty()) {
+		printf("VideoCodec: the encoder skipped a frame\n");
+		return false;
+	}
+
+	m_header.width = width;
+	m_header.height = height;
+	m_header.key = info.eFrameType == videoFrameTypeIDR ? 1 : 0;
+	m_header.reserved = 0;
+	m_header.size = m_data.size();
+
+	return true;
+}
+
+char* VideoCodec::prepare_decode(const VideoHeader& header)
+{
+	if (header.width < 1 || header.height < 1 || header.size == 0)
+		return NULL;
+
+	m_header = header;
+	m_data.resize((size_t)header.size);
+
+	return (char*)m_data.data();
+}
+
+bool VideoCodec::decode(unsigned char* pixels, int width, int height)
+{
+	if (m_header.width != width || m_header.height != height)
+		return false;
+
+	// a new stream starts with a key frame
+	if (m_header.key) {
+		free_decoder();
+	}
+
+	if (m_decoder == NULL && !init_decoder())
+		return false;
+
+	unsigned char* planes[3] = { NULL, NULL, NULL };
+	SBufferInfo info;
+	memset(&info, 0, sizeof(SBufferInfo));
+
+	DECODING_STATE state = ((ISVCDecoder*)m_decoder)->DecodeFrameNoDelay(
+		m_data.data(), (int)m_data.size(), planes, &info);
+
+	if (state != dsErrorFree || info.iBufferStatus != 1) {
+		printf("VideoCodec: DecodeFrameNoDelay failed (%d)\n", (int)state);
+		return false;
+	}
+
+	int even_width = info.UsrData.sSystemBuffer.iWidth;
+	int even_height = info.UsrData.sSystemBuffer.iHeight;
+	if (even_width != ((width + 1) & ~1) || even_height != ((height + 1) & ~1))
+		return false;
+
+	// the decoder planes have strides, the converters take packed planes
+	size_t plane = (size_t)even_width * even_height;
+	m_yuv.resize(plane * 3 / 2);
+
+	int stride_y = info.UsrData.sSystemBuffer.iStride[0];
+	int stride_uv = info.UsrData.sSystemBuffer.iStride[1];
+	for (int y = 0; y < even_height; y++) {
+		memcpy(m_yuv.data() + (size_t)y * even_width, planes[0] + (size_t)y * stride_y, even_width);
+	}
+	for (int y = 0; y < even_height / 2; y++) {
+		memcpy(m_yuv.data() + plane + (size_t)y * (even_width / 2), planes[1] + (size_t)y * stride_uv, even_width / 2);
+		memcpy(m_yuv.data() + plane + plane / 4 + (size_t)y * (even_width / 2), planes[2] + (size_t)y * stride_uv, even_width / 2);
+	}
+
+	if (even_width == width && even_height == height) {
+		color_yuv_i420_to_rgba(pixels, m_yuv.data(), height, width);
+		return true;
+	}
+
+	m_rgba.resize(plane * 4);
+	color_yuv_i420_to_rgba(m_rgba.data(), m_yuv.data(), even_height, even_width);
+	for (int y = 0; y < height; y++) {
+		memcpy(pixels + (size_t)y * width * 4, m_rgba.data() + (size_t)y * even_width * 4, (size_t)width * 4);
+	}
+
+	return true;
+}
+
+#else
+
+bool VideoCodec::init_encoder(int, int)
+{
+	return false;
+}
+
+void VideoCodec::free_encoder()
+{
+}
+
+bool VideoCodec::init_decoder()
+{
+	return false;
+}
+
+void VideoCodec::free_decoder()
+{
+}
+
+bool VideoCodec::encode(const unsigned char*, int, int)
+{
+	return false;
+}
+
+char* VideoCodec::prepare_decode(const VideoHeader&)
+{
+	return NULL;
+}
+
+bool VideoCodec::decode(unsigned char*, int, int)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,96 @@
+// #####################################################################################################################
+// # Copyright(C) 2011-2025 IT4Innovations National Supercomputing Center, VSB - Technical University of Ostrava
+// #
+// # This program is free software : you can redistribute it and/or modify
+// # it under the terms of the GNU General Public License as published by
+// # the Free Software Foundation, either version 3 of the License, or
+// # (at your option) any later version.
+// #
+// # This program is distributed in the hope that it will be useful,
+// # but WITHOUT ANY WARRANTY; without even the implied warranty of
+// # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// # GNU General Public License for more details.
+// #
+// # You should have received a copy of the GNU General Public License
+// # along with this program.  If not, see <https://www.gnu.org/licenses/>.
+// #
+// #####################################################################################################################
+
+#ifndef __RENDERENGINE_VIDEO_H__
+#define __RENDERENGINE_VIDEO_H__
+
+#include <stdlib.h>
+#include <vector>
+#include "renderengine_api.h"
+
+#define VIDEO_BITRATE_DEFAULT 8000 // kbit/s
+#define VIDEO_FRAME_RATE_DEFAULT 30.0f
+
+// Sent in front of the NAL units of a frame.
+typedef struct VideoHeader {
+	int width;
+	int height;
+	int key;      // an IDR frame, decoding can start here
+	int reserved;
+	unsigned long long size; // bytes of the NAL units
+} VideoHeader;
+
+// H.264 stream of RGBA8 frames with OpenH264 (constrained baseline: no B-frames, every
+// frame is output as soon as it is encoded). The frames are converted to/from I420 by
+// the color module, odd sizes are encoded with the last column/row repeated. A key
+// frame starts the stream and follows a change of the frame size and force_key().
+class BRAAS_HPC_EXPORT_DLL VideoCodec {
+protected:
+	int m_bitrate = VIDEO_BITRATE_DEFAULT;
+	float m_frame_rate = VIDEO_FRAME_RATE_DEFAULT;
+
+	void* m_encoder = NULL;
+	void* m_decoder = NULL;
+	int m_width = 0;  // of the encoder, even
+	int m_height = 0;
+	bool m_force_key = true;
+	long long m_timestamp = 0; // ms
+
+	VideoHeader m_header;
+	std::vector<unsigned char> m_data;
+	std::vector<unsigned char> m_yuv;  // I420 planes of the even size
+	std::vector<unsigned char> m_rgba; // frame of an odd size padded to the even size
+
+public:
+	VideoCodec();
+	~VideoCodec();
+
+	static bool is_supported();
+
+	// kbit/s, applied to the running encoder
+	void set_bitrate(int bitrate);
+	int get_bitrate() { return m_bitrate; }
+
+	// the next frame is a key frame
+	void force_key() { m_force_key = true; }
+
+	// closes the encoder and the decoder, the next frame starts a new stream
+	void reset();
+
+	// the result is get_header() and get_data()
+	bool encode(const unsigned char* pixels, int width, int height);
+
+	VideoHeader& get_header() { return m_header; }
+	char* get_data() { return (char*)m_data.data(); }
+	size_t get_size() { return (size_t)m_header.size; }
+
+	// buffer for the NAL units announced by header, NULL if the header is invalid
+	char* prepare_decode(const VideoHeader& header);
+	bool decode(unsigned char* pixels, int width, int height);
+
+protected:
+	bool init_encoder(int width, int height);
+	void free_encoder();
+	bool init_decoder();
+	void free_decoder();
+
+	// pixels or the padded copy in m_rgba
+	const unsigned char* pad(const unsigned char* pixels, int width, int height, int even_width, int even_height);
+};
+
+#endif